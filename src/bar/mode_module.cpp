@@ -0,0 +1,45 @@
+#include "mode_module.hpp"
+#include <sway_ipc/sway_ipc.hpp>
+#include <format>
+
+namespace
+{
+constexpr sway::event_type mode_events[] = {sway::event_type::mode};
+} // namespace
+
+namespace bar
+{
+std::span<const sway::event_type> mode_module::events() const
+{
+    return mode_events;
+}
+
+std::expected<void, sway::error_desc> mode_module::refresh(sway::ipc& ipc)
+{
+    return ipc.get_binding_state().transform([this](std::string_view mode)
+    {
+        _mode = mode;
+    });
+}
+
+void mode_module::on_event(const event& event)
+{
+    if (const sway::mode_event* mode = std::get_if<sway::mode_event>(&event))
+    {
+        _mode = mode->change;
+    }
+}
+
+waybar::block mode_module::render()
+{
+    if (_mode == "default")
+    {
+        return waybar::block{.css_class = "default"};
+    }
+    _tooltip.clear();
+    std::format_to(std::back_inserter(_tooltip), "mode: {}", _mode);
+    // inside a special unicode character,
+    // that will be rendered by waybar as an arrow
+    return waybar::block{.text = "", .tooltip = _tooltip, .css_class = _mode};
+}
+} // namespace bar
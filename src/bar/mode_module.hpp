@@ -0,0 +1,23 @@
+#pragma once
+#include "module.hpp"
+#include <string>
+
+namespace bar
+{
+// arrow after sway/mode, dark when mode is not default. Also rendered by mode_watcher
+class mode_module : public module
+{
+public:
+    std::string_view name() const override { return "mode"; }
+    std::span<const sway::event_type> events() const override;
+
+    std::expected<void, sway::error_desc> refresh(sway::ipc& ipc) override;
+    void on_event(const event& event) override;
+
+    waybar::block render() override;
+
+private:
+    std::string _mode = "default";
+    std::string _tooltip;
+};
+} // namespace bar
@@ -0,0 +1,44 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <sway_ipc/events/event_type.hpp>
+#include <sway_ipc/events/events.hpp>
+#include <waybar_output.hpp>
+#include <expected>
+#include <span>
+#include <string_view>
+#include <variant>
+
+namespace sway
+{
+class ipc;
+}
+
+namespace bar
+{
+// event decoded once by daemon, and given to every module subscribed to it.
+// Strings in it are valid only during on_event
+using event = std::variant<sway::workspace_event, sway::output_event, sway::mode_event,
+    sway::window_event, sway::shutdown_event, sway::tick_event>;
+
+// part of the bar, rendered into text of one waybar custom module
+class module
+{
+public:
+    virtual ~module() = default;
+
+    // used as name of module output, and to choose modules in command line
+    virtual std::string_view name() const = 0;
+    // daemon subscribes once to events of all modules
+    virtual std::span<const sway::event_type> events() const = 0;
+
+    // called on start, and when events could be missed, like after reconnect
+    virtual std::expected<void, sway::error_desc> refresh(sway::ipc& ipc) = 0;
+    virtual void on_event(const event& event) = 0;
+    // called once after burst of events, requests should be made here, and not in on_event
+    virtual std::expected<void, sway::error_desc> settle(sway::ipc&) { return {}; }
+
+    // state of module for waybar. Views should live until the next event.
+    // Output is written only when serialised block differs from the last written one
+    virtual waybar::block render() = 0;
+};
+} // namespace bar
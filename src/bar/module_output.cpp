@@ -0,0 +1,122 @@
+#include "module_output.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <utility>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+std::expected<void, sway::error_desc> make_fifo(const std::string& path, mode_t mode)
+{
+    if (::mkfifo(path.c_str(), mode) == -1 && errno != EEXIST)
+    {
+        return std::unexpected(sway::error_desc("Creation of fifo failed"));
+    }
+    return {};
+}
+} // namespace
+
+namespace bar
+{
+module_output::~module_output()
+{
+    disconnect();
+}
+
+module_output::module_output(module_output&& other)
+    : _path(std::move(other._path))
+    , _fd(std::exchange(other._fd, -1))
+    , _behind(std::exchange(other._behind, false))
+    , _output(std::move(other._output))
+{
+}
+
+std::string module_output::fifo_directory()
+{
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    return std::format("{}/sway_bar_daemon", runtime_dir != nullptr ? runtime_dir : "/tmp");
+}
+
+std::expected<module_output, sway::error_desc> module_output::open_fifo(std::string_view name)
+{
+    const std::string directory = fifo_directory();
+    if (::mkdir(directory.c_str(), 0700) == -1 && errno != EEXIST)
+    {
+        return std::unexpected(sway::error_desc("Creation of directory failed"));
+    }
+
+    std::string path = std::format("{}/{}", directory, name);
+    return make_fifo(path, 0600).and_then([&path]() -> std::expected<module_output, sway::error_desc>
+    {
+        module_output output;
+        output._path = std::move(path);
+        output._behind = true;
+        std::expected<void, sway::error_desc> connect_result = output.reconnect();
+        if (!connect_result.has_value())
+        {
+            return std::unexpected(std::move(connect_result.error()));
+        }
+        return output;
+    });
+}
+
+std::expected<void, sway::error_desc> module_output::write(const waybar::block& block)
+{
+    if (_path.empty())
+    {
+        return _output.write(block);
+    }
+    if (_output.keep(block))
+    {
+        _behind = true;
+    }
+    return reconnect();
+}
+
+std::expected<void, sway::error_desc> module_output::reconnect()
+{
+    if (!_behind)
+    {
+        return {};
+    }
+    if (_fd == -1)
+    {
+        // not O_RDWR: daemon would be reader itself, and lines would pile up in pipe without real one
+        const int fd = ::open(_path.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd == -1)
+        {
+            // no reader yet
+            return errno == ENXIO ? std::expected<void, sway::error_desc>()
+                                  : std::unexpected(sway::error_desc("Opening of fifo failed"));
+        }
+        _fd = fd;
+        _output.set_fd(fd);
+    }
+
+    std::expected<void, sway::error_desc> write_result = _output.rewrite();
+    if (write_result.has_value())
+    {
+        _behind = false;
+    }
+    // EAGAIN: reader does not keep up, and pipe is full. EPIPE: reader is gone, fd is closed
+    // by disconnect, when event loop reports it
+    else if (write_result.error().error_code == EAGAIN || write_result.error().error_code == EPIPE)
+    {
+        return {};
+    }
+    return write_result;
+}
+
+void module_output::disconnect()
+{
+    if (_fd != -1)
+    {
+        ::close(std::exchange(_fd, -1));
+        _behind = true;
+    }
+}
+} // namespace bar
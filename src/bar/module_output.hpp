@@ -0,0 +1,54 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <waybar_output.hpp>
+#include <expected>
+#include <string>
+#include <string_view>
+
+namespace bar
+{
+// where lines of one module go. Either stdout of daemon, when it is started by waybar
+// as exec of the only module, or a fifo, read by `cat` in exec of waybar module.
+// Fifo is open only for writing, and only while it has reader. When reader closes it, daemon closes
+// its end too, so lines left in pipe are dropped. Restarted waybar waits in open of fifo until daemon
+// reconnects, and gets the last line again, which could be written long ago
+class module_output
+{
+public:
+    // output to stdout
+    module_output() = default;
+    ~module_output();
+
+    module_output(const module_output&) = delete;
+    module_output& operator=(const module_output&) = delete;
+    module_output(module_output&& other);
+    module_output& operator=(module_output&& other) = delete;
+
+    // creates fifo at $XDG_RUNTIME_DIR/sway_bar_daemon/<name>, if it does not exist
+    static std::expected<module_output, sway::error_desc> open_fifo(std::string_view name);
+    // directory of fifos, same for daemon and readers
+    static std::string fifo_directory();
+
+    // writes block as json line, if it is different from the last written one.
+    // Line which fifo can not take now is kept, and written by reconnect
+    std::expected<void, sway::error_desc> write(const waybar::block& block);
+    // opens fifo, if it has reader now, and writes the last line, if reader has not got it yet
+    std::expected<void, sway::error_desc> reconnect();
+    // reader closed fifo. fd should be removed from event loop before
+    void disconnect();
+
+    // write end of fifo while it is open, -1 otherwise and for stdout. Epoll reports EPOLLERR
+    // for it, when the last reader closes fifo
+    int fifo_fd() const { return _fd; }
+    // fifo has no reader, or reader has not got the last line
+    bool behind() const { return _behind; }
+
+private:
+    // empty for stdout
+    std::string _path;
+    // -1 for stdout, which is not closed
+    int _fd = -1;
+    bool _behind = false;
+    waybar::output _output;
+};
+} // namespace bar
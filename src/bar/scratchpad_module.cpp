@@ -0,0 +1,51 @@
+#include "scratchpad_module.hpp"
+#include <sway_ipc/sway_ipc.hpp>
+#include <format>
+
+namespace
+{
+constexpr sway::event_type scratchpad_events[] = {sway::event_type::window};
+} // namespace
+
+namespace bar
+{
+std::span<const sway::event_type> scratchpad_module::events() const
+{
+    return scratchpad_events;
+}
+
+std::expected<void, sway::error_desc> scratchpad_module::refresh(sway::ipc& ipc)
+{
+    return _tracker.rebuild(ipc);
+}
+
+void scratchpad_module::on_event(const event& event)
+{
+    if (const sway::window_event* window = std::get_if<sway::window_event>(&event))
+    {
+        _tracker.apply(*window);
+    }
+}
+
+std::expected<void, sway::error_desc> scratchpad_module::settle(sway::ipc& ipc)
+{
+    return _tracker.sync(ipc);
+}
+
+waybar::block scratchpad_module::render()
+{
+    if (_tracker.empty())
+    {
+        return waybar::block{.css_class = "empty"};
+    }
+    _tooltip.clear();
+    std::format_to(std::back_inserter(_tooltip), "{} in scratchpad", _tracker.size());
+    for (const sway::scratchpad_tracker::window& window : _tracker.hidden())
+    {
+        std::format_to(std::back_inserter(_tooltip), "\n{}: {}", window.app, window.title);
+    }
+    // inside a special unicode character,
+    // that will be rendered by waybar as an arrow
+    return waybar::block{.text = "", .tooltip = _tooltip, .css_class = "hidden"};
+}
+} // namespace bar
@@ -0,0 +1,27 @@
+#pragma once
+#include "module.hpp"
+#include <sway_ipc/scratchpad_tracker.hpp>
+#include <string>
+
+namespace bar
+{
+// arrow after sway/scratchpad, shown when scratchpad has windows. Also rendered by scratchpad_watcher
+class scratchpad_module : public module
+{
+public:
+    std::string_view name() const override { return "scratchpad"; }
+    std::span<const sway::event_type> events() const override;
+
+    std::expected<void, sway::error_desc> refresh(sway::ipc& ipc) override;
+    void on_event(const event& event) override;
+    // tree is fetched only if some event of burst contradicted tracked scratchpad
+    std::expected<void, sway::error_desc> settle(sway::ipc& ipc) override;
+
+    // tooltip lists hidden windows, like tooltip of sway/scratchpad
+    waybar::block render() override;
+
+private:
+    sway::scratchpad_tracker _tracker;
+    std::string _tooltip;
+};
+} // namespace bar
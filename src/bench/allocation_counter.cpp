@@ -0,0 +1,102 @@
+#include "allocation_counter.hpp"
+#include <sway_ipc/sized_buffer.hpp>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+// allocations made by current thread, counted by replaced operator new
+thread_local size_t allocations = 0;
+} // namespace
+
+namespace sway::bench
+{
+size_t allocated()
+{
+    return allocations + sized_buffer::thread_reallocations();
+}
+} // namespace sway::bench
+
+// every form of new and delete is replaced, so all of them go through malloc and free
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    ++allocations;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new(size_t size)
+{
+    if (void* ptr = operator new(size, std::nothrow))
+    {
+        return ptr;
+    }
+    std::abort();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+// aligned forms are used by std::pmr::new_delete_resource, which decode uses without arena
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    ++allocations;
+    const size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants size to be multiple of alignment
+    if (void* ptr = std::aligned_alloc(align, (size + align - 1) / align * align))
+    {
+        return ptr;
+    }
+    std::abort();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    std::free(ptr);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <cstddef>
+
+namespace sway::bench
+{
+// allocations made by calling thread since its start: calls of replaced operator new, and growth of
+// receive buffers, which take memory with malloc and mmap directly. Executable which links
+// allocation_counter.cpp gets its operator new replaced
+size_t allocated();
+} // namespace sway::bench
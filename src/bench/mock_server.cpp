@@ -0,0 +1,432 @@
+#include "mock_server.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr sway::event_type all_events[] = {
+    sway::event_type::workspace,
+    sway::event_type::output,
+    sway::event_type::mode,
+    sway::event_type::window,
+    sway::event_type::barconfig_update,
+    sway::event_type::binding,
+    sway::event_type::shutdown,
+    sway::event_type::tick,
+    sway::event_type::bar_state_update,
+    sway::event_type::input,
+};
+
+uint32_t event_bit(sway::event_type event_type)
+{
+    return 1u << (static_cast<uint32_t>(event_type) & 0x1f);
+}
+
+std::string_view payload_type_name(sway::payload_type payload_type)
+{
+    switch (payload_type)
+    {
+        case sway::payload_type::run_command: return "run_command";
+        case sway::payload_type::get_workspaces: return "get_workspaces";
+        case sway::payload_type::subscribe: return "subscribe";
+        case sway::payload_type::get_outputs: return "get_outputs";
+        case sway::payload_type::get_tree: return "get_tree";
+        case sway::payload_type::get_marks: return "get_marks";
+        case sway::payload_type::get_bar_config: return "get_bar_config";
+        case sway::payload_type::get_version: return "get_version";
+        case sway::payload_type::get_binding_modes: return "get_binding_modes";
+        case sway::payload_type::get_config: return "get_config";
+        case sway::payload_type::send_tick: return "send_tick";
+        case sway::payload_type::sync: return "sync";
+        case sway::payload_type::get_binding_state: return "get_binding_state";
+        case sway::payload_type::get_inputs: return "get_inputs";
+        case sway::payload_type::get_seats: return "get_seats";
+    }
+    return "";
+}
+
+std::string make_frame(uint32_t type, std::string_view payload)
+{
+    sway::message_header header;
+    header.length = static_cast<int>(payload.size());
+    header.payload_type = static_cast<sway::payload_type>(type);
+
+    std::string frame(sway::header_size + payload.size(), '\0');
+    std::memcpy(frame.data(), header.magic, sway::header_size);
+    std::memcpy(frame.data() + sway::header_size, payload.data(), payload.size());
+    return frame;
+}
+
+bool write_all(int fd, std::string_view data)
+{
+    while (!data.empty())
+    {
+        const ssize_t written = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (written == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (written <= 0)
+        {
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    return true;
+}
+
+bool read_all(int fd, char* data, size_t size)
+{
+    while (size != 0)
+    {
+        const ssize_t got = ::read(fd, data, size);
+        if (got == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (got <= 0)
+        {
+            return false;
+        }
+        data += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+} // namespace
+
+namespace sway::bench
+{
+std::string_view event_payload_name(event_type event_type)
+{
+    switch (event_type)
+    {
+        case event_type::workspace: return "workspace_event";
+        case event_type::output: return "output_event";
+        case event_type::mode: return "mode_event";
+        case event_type::window: return "window_event";
+        case event_type::barconfig_update: return "barconfig_update_event";
+        case event_type::binding: return "binding_event";
+        case event_type::shutdown: return "shutdown_event";
+        case event_type::tick: return "tick_event";
+        case event_type::bar_state_update: return "bar_state_update_event";
+        case event_type::input: return "input_event";
+    }
+    return "";
+}
+
+mock_server::mock_server(std::string socket_path)
+    : _socket_path(std::move(socket_path))
+{
+}
+
+mock_server::~mock_server()
+{
+    stop();
+}
+
+std::expected<void, error_desc> mock_server::load_payloads(const std::filesystem::path& directory)
+{
+    for (uint32_t type = 0; type <= static_cast<uint32_t>(payload_type::get_seats); ++type)
+    {
+        const std::string_view name = payload_type_name(static_cast<payload_type>(type));
+        if (name.empty())
+        {
+            continue;
+        }
+
+        std::ifstream file(directory / std::format("{}.json", name));
+        if (!file.is_open())
+        {
+            continue;
+        }
+        std::stringstream content;
+        content << file.rdbuf();
+        _replies[static_cast<payload_type>(type)] = std::move(content).str();
+    }
+
+    if (_replies.empty())
+    {
+        errno = ENOENT;
+        return std::unexpected(error_desc("No recorded payloads found"));
+    }
+    return {};
+}
+
+void mock_server::set_reply(payload_type payload_type, std::string payload)
+{
+    _replies[payload_type] = std::move(payload);
+}
+
+std::expected<void, error_desc> mock_server::start()
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (_socket_path.size() >= sizeof(address.sun_path))
+    {
+        return std::unexpected(error_desc(error_desc::invalid_error_code::path_to_socket_too_long,
+            error_desc::operation::check_socket_path,
+            static_cast<int64_t>(_socket_path.size()), static_cast<int64_t>(sizeof(address.sun_path))));
+    }
+    std::memcpy(address.sun_path, _socket_path.data(), _socket_path.size());
+    ::unlink(_socket_path.c_str());
+
+    _listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (_listen_fd == -1)
+    {
+        return std::unexpected(error_desc(error_desc::operation::create_socket));
+    }
+    if (::bind(_listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1 ||
+        ::listen(_listen_fd, 16) == -1 || ::pipe2(_stop_pipe, O_CLOEXEC) == -1)
+    {
+        error_desc error(error_desc::operation::listen_socket);
+        ::close(_listen_fd);
+        _listen_fd = -1;
+        return std::unexpected(std::move(error));
+    }
+
+    _accept_thread = std::thread([this]()
+    {
+        accept_clients();
+    });
+    return {};
+}
+
+void mock_server::stop()
+{
+    if (_listen_fd == -1)
+    {
+        return;
+    }
+
+    ::write(_stop_pipe[1], "", 1);
+    _accept_thread.join();
+    {
+        std::lock_guard lock(_clients_mutex);
+        for (std::unique_ptr<client>& client : _clients)
+        {
+            // wakes client thread blocked in read
+            ::shutdown(client->fd, SHUT_RDWR);
+        }
+    }
+    for (std::unique_ptr<client>& client : _clients)
+    {
+        client->thread.join();
+        ::close(client->fd);
+    }
+    _clients.clear();
+
+    ::close(_listen_fd);
+    ::close(_stop_pipe[0]);
+    ::close(_stop_pipe[1]);
+    _listen_fd = -1;
+    ::unlink(_socket_path.c_str());
+}
+
+size_t mock_server::send_storm(const storm& storm)
+{
+    // frames are made before sending, so only writing is measured by whoever waits for them
+    std::vector<std::string> frames;
+    for (const std::string& payload : storm.payloads)
+    {
+        frames.push_back(make_frame(static_cast<uint32_t>(storm.event_type), payload));
+    }
+    if (frames.empty())
+    {
+        return 0;
+    }
+
+    std::vector<client*> receivers;
+    {
+        std::lock_guard lock(_clients_mutex);
+        for (std::unique_ptr<client>& client : _clients)
+        {
+            if (client->subscribed_events & event_bit(storm.event_type))
+            {
+                receivers.push_back(client.get());
+            }
+        }
+    }
+
+    const size_t burst = storm.burst == 0 ? storm.count : storm.burst;
+    for (size_t sent = 0; sent < storm.count;)
+    {
+        // burst is joined into one write, the way sway flushes events queued during one command
+        std::string burst_data;
+        for (size_t i = 0; i < burst && sent < storm.count; ++i, ++sent)
+        {
+            burst_data += frames[sent % frames.size()];
+        }
+        for (client* receiver : receivers)
+        {
+            std::lock_guard lock(receiver->write_mutex);
+            write_all(receiver->fd, burst_data);
+        }
+        if (storm.pause.count() != 0 && sent < storm.count)
+        {
+            std::this_thread::sleep_for(storm.pause);
+        }
+    }
+    return receivers.size();
+}
+
+size_t mock_server::subscribers(event_type event_type) const
+{
+    std::lock_guard lock(_clients_mutex);
+    size_t count = 0;
+    for (const std::unique_ptr<client>& client : _clients)
+    {
+        count += (client->subscribed_events & event_bit(event_type)) != 0;
+    }
+    return count;
+}
+
+void mock_server::accept_clients()
+{
+    pollfd poll_fds[2] = {{_listen_fd, POLLIN, 0}, {_stop_pipe[0], POLLIN, 0}};
+    while (true)
+    {
+        if (::poll(poll_fds, 2, -1) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        if (poll_fds[1].revents != 0)
+        {
+            return;
+        }
+
+        const int client_fd = ::accept4(_listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client_fd == -1)
+        {
+            continue;
+        }
+
+        std::lock_guard lock(_clients_mutex);
+        std::unique_ptr<client>& added = _clients.emplace_back(std::make_unique<client>());
+        added->fd = client_fd;
+        added->thread = std::thread([this, client = added.get()]()
+        {
+            serve_client(*client);
+        });
+    }
+}
+
+void mock_server::serve_client(client& client)
+{
+    std::string payload;
+    while (true)
+    {
+        char header[header_size];
+        if (!read_all(client.fd, header, header_size) || std::memcmp(header, "i3-ipc", 6) != 0)
+        {
+            break;
+        }
+
+        int length;
+        uint32_t type;
+        std::memcpy(&length, header + 6, sizeof(length));
+        std::memcpy(&type, header + 6 + sizeof(length), sizeof(type));
+        payload.resize(static_cast<size_t>(std::max(length, 0)));
+        if (!read_all(client.fd, payload.data(), payload.size()))
+        {
+            break;
+        }
+
+        const std::string reply = reply_for(static_cast<payload_type>(type), payload, client);
+        std::lock_guard lock(client.write_mutex);
+        if (!write_all(client.fd, make_frame(type, reply)))
+        {
+            break;
+        }
+
+        if (static_cast<payload_type>(type) == payload_type::subscribe &&
+            (client.subscribed_events & event_bit(event_type::tick)))
+        {
+            // sway sends first tick right after subscription
+            write_all(client.fd, make_frame(static_cast<uint32_t>(event_type::tick), R"({"first":true,"payload":""})"));
+        }
+    }
+
+    // client is gone, it should not be counted by subscribers any more
+    client.subscribed_events = 0;
+}
+
+std::string mock_server::reply_for(payload_type payload_type, std::string_view payload, client& client)
+{
+    switch (payload_type)
+    {
+        case payload_type::run_command:
+        {
+            // one result per part separated by comma or semicolon, as sway does. Every command succeeds,
+            // except criteria after comma: sway reads criteria only at the start of semicolon separated
+            // command, and takes them for unknown command otherwise
+            std::string reply = "[";
+            size_t start = 0;
+            while (start <= payload.size())
+            {
+                const size_t end = std::min(payload.find_first_of(",;", start), payload.size());
+                const std::string_view part = payload.substr(start, end - start);
+                const size_t first = part.find_first_not_of(' ');
+                const bool misplaced = start != 0 && payload[start - 1] == ',' &&
+                    first != std::string_view::npos && part[first] == '[';
+                reply += reply.size() == 1 ? "" : ",";
+                reply += misplaced ?
+                    std::format(R"({{"success":false,"parse_error":true,"error":"Unknown/invalid command '{}'"}})",
+                        part.substr(first, part.find(']', first) + 1 - first)) :
+                    std::string(R"({"success":true})");
+                start = end + 1;
+            }
+            return reply + "]";
+        }
+        case payload_type::subscribe:
+        {
+            uint32_t events = 0;
+            for (event_type event : all_events)
+            {
+                if (payload.find(std::format("\"{}\"", event_type_to_string(event))) != std::string_view::npos)
+                {
+                    events |= event_bit(event);
+                }
+            }
+            client.subscribed_events |= events;
+            return R"({"success":true})";
+        }
+        case payload_type::send_tick:
+        {
+            std::string event = std::format(R"({{"first":false,"payload":"{}"}})", payload);
+            std::lock_guard lock(_clients_mutex);
+            for (std::unique_ptr<mock_server::client>& receiver : _clients)
+            {
+                // lock of sender is taken after reply is made, so its events can be written here
+                if (receiver->subscribed_events & event_bit(event_type::tick))
+                {
+                    std::lock_guard write_lock(receiver->write_mutex);
+                    write_all(receiver->fd, make_frame(static_cast<uint32_t>(event_type::tick), event));
+                }
+            }
+            return R"({"success":true})";
+        }
+        case payload_type::sync:
+            // as sway, which does not implement it
+            return R"({"success":false})";
+        default:
+        {
+            auto it = _replies.find(payload_type);
+            return it == _replies.end() ? std::string("{}") : it->second;
+        }
+    }
+}
+} // namespace sway::bench
@@ -0,0 +1,85 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <sway_ipc/events/event_type.hpp>
+#include <sway_ipc/message.hpp>
+#include <atomic>
+#include <chrono>
+#include <expected>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace sway::bench
+{
+// fake sway, which speaks i3-ipc over unix socket. Replies to queries with recorded
+// payloads, and sends events only when asked, so tests and benchmarks do not need
+// running compositor. Point SWAYSOCK at socket_path to use it with watchers
+class mock_server
+{
+public:
+    struct storm
+    {
+        event_type event_type;
+        // event payloads, sent one after another in a loop
+        std::vector<std::string> payloads;
+        size_t count = 0;
+        // events are written in bursts of this size, with pause between bursts.
+        // 0 sends everything as one burst
+        size_t burst = 0;
+        std::chrono::microseconds pause{0};
+    };
+
+    explicit mock_server(std::string socket_path);
+    ~mock_server();
+
+    mock_server(const mock_server&) = delete;
+    mock_server& operator=(const mock_server&) = delete;
+
+    // loads <request name>.json (like get_tree.json) from directory as replies to that request.
+    // Requests without recorded payload get an empty object
+    std::expected<void, error_desc> load_payloads(const std::filesystem::path& directory);
+    void set_reply(payload_type payload_type, std::string payload);
+
+    // creates socket, and starts accepting clients in background
+    std::expected<void, error_desc> start();
+    void stop();
+
+    // sends events to every client subscribed to storm.event_type. Blocks until everything
+    // is written, so clients should read it from other thread. Returns number of clients
+    size_t send_storm(const storm& storm);
+    size_t subscribers(event_type event_type) const;
+
+    const std::string& socket_path() const { return _socket_path; }
+
+private:
+    struct client
+    {
+        int fd;
+        std::thread thread;
+        // replies and events are written from different threads
+        std::mutex write_mutex;
+        std::atomic<uint32_t> subscribed_events{0};
+    };
+
+    void accept_clients();
+    void serve_client(client& client);
+    std::string reply_for(payload_type payload_type, std::string_view payload, client& client);
+
+    std::string _socket_path;
+    int _listen_fd = -1;
+    // written to wake accept thread on stop
+    int _stop_pipe[2] = {-1, -1};
+    std::thread _accept_thread;
+    std::map<payload_type, std::string> _replies;
+    mutable std::mutex _clients_mutex;
+    std::vector<std::unique_ptr<client>> _clients;
+};
+
+// event payload name as in mock payload directory, like window_event for window
+std::string_view event_payload_name(event_type event_type);
+} // namespace sway::bench
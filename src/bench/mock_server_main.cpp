@@ -0,0 +1,79 @@
+#include "mock_server.hpp"
+#include "print_error.hpp"
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <print>
+#include <sstream>
+#include <string>
+
+// standalone fake sway, to run watchers against it:
+//   sway_mock_server <socket path> [payload directory]
+//   SWAYSOCK=<socket path> scratchpad_watcher
+// Events are sent by lines on stdin: storm <event type> <count> [burst] [pause in us],
+// with payload from <event type>_event.json of payload directory
+
+namespace
+{
+std::optional<sway::event_type> event_type_from_string(std::string_view name)
+{
+    for (uint32_t type = static_cast<uint32_t>(sway::event_type::workspace);
+        type <= static_cast<uint32_t>(sway::event_type::input); ++type)
+    {
+        if (sway::event_type_to_string(static_cast<sway::event_type>(type)) == name)
+        {
+            return static_cast<sway::event_type>(type);
+        }
+    }
+    return std::nullopt;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::println(stderr, "usage: {} <socket path> [payload directory]", argv[0]);
+        return 1;
+    }
+
+    const std::filesystem::path payloads = argc > 2 ? argv[2] : SWAY_IPC_BENCH_PAYLOADS;
+    sway::bench::mock_server server(argv[1]);
+    std::expected<void, sway::error_desc> result = server.load_payloads(payloads).and_then([&server]()
+    {
+        return server.start();
+    });
+    if (!result.has_value())
+    {
+        print_error(result.error());
+        return 1;
+    }
+
+    std::string line;
+    while (std::getline(std::cin, line))
+    {
+        std::istringstream words(line);
+        std::string command;
+        std::string event_name;
+        sway::bench::mock_server::storm storm;
+        size_t pause = 0;
+        words >> command >> event_name >> storm.count >> storm.burst >> pause;
+        storm.pause = std::chrono::microseconds(pause);
+
+        std::optional<sway::event_type> event_type = event_type_from_string(event_name);
+        if (command != "storm" || !event_type.has_value())
+        {
+            std::println(stderr, "unknown command: {}", line);
+            continue;
+        }
+        storm.event_type = event_type.value();
+
+        std::ifstream file(payloads / std::format("{}.json", sway::bench::event_payload_name(storm.event_type)));
+        std::stringstream content;
+        content << file.rdbuf();
+        storm.payloads.push_back(std::move(content).str());
+
+        std::println("sent {} events to {} clients", storm.count, server.send_storm(storm));
+    }
+}
@@ -0,0 +1,236 @@
+#include "allocation_counter.hpp"
+#include "mock_server.hpp"
+#include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/events/events.hpp>
+#include <sway_ipc/replies.hpp>
+#include "print_error.hpp"
+#include <cstdlib>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <print>
+#include <semaphore>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <poll.h>
+#include <unistd.h>
+
+// test of sway::ipc against mock_server, run by ctest. Reply and event paths are repeated after warm up,
+// and every allocation made meanwhile, growth of receive buffers included, fails the test
+
+namespace
+{
+constexpr size_t warm_up_rounds = 100;
+constexpr size_t rounds = 1000;
+// events of one round, small enough for socket to take them without reader
+constexpr size_t events_per_round = 16;
+
+// allocations made by rounds of op after warm up, or nullopt if op failed
+std::optional<size_t> steady_allocations(const std::function<bool()>& op)
+{
+    for (size_t i = 0; i < warm_up_rounds; ++i)
+    {
+        if (!op())
+        {
+            return std::nullopt;
+        }
+    }
+    const size_t before = sway::bench::allocated();
+    for (size_t i = 0; i < rounds; ++i)
+    {
+        if (!op())
+        {
+            return std::nullopt;
+        }
+    }
+    return sway::bench::allocated() - before;
+}
+
+// counts events, and decodes window events in event arena, as real handler would
+struct event_counter
+{
+    sway::ipc& ipc;
+    size_t handled = 0;
+    bool failed = false;
+
+    bool operator()(sway::event_tag<sway::event_type::mode>, sway::ipc::event_payload& event)
+    {
+        std::string_view change;
+        failed = failed || event.json.find_field("change").get_string().get(change) != simdjson::SUCCESS;
+        ++handled;
+        return false;
+    }
+
+    bool operator()(sway::event_tag<sway::event_type::window>, sway::ipc::event_payload& event)
+    {
+        failed = failed || !sway::decode_with<sway::window_event>(ipc.event_arena())(std::move(event.json));
+        ++handled;
+        return false;
+    }
+
+    bool on_error(const sway::error_desc& error)
+    {
+        print_error(error);
+        failed = true;
+        return true;
+    }
+};
+
+std::string read_payload(const std::filesystem::path& path)
+{
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+// storms are sent from other thread, so allocations of mock server are not counted
+class steady_state_test
+{
+public:
+    explicit steady_state_test(sway::bench::mock_server& server)
+        : _server(server)
+        , _sender([this]() { send_storms(); })
+    {
+    }
+
+    ~steady_state_test()
+    {
+        _storm = nullptr;
+        _send.release();
+        _sender.join();
+    }
+
+    steady_state_test(const steady_state_test&) = delete;
+    steady_state_test& operator=(const steady_state_test&) = delete;
+
+    // reports case which allocated, or failed
+    void check(std::string_view name, const std::function<bool()>& op)
+    {
+        const std::optional<size_t> allocations = steady_allocations(op);
+        if (!allocations.has_value())
+        {
+            std::println(stderr, "[Test] [Error] {} failed", name);
+            _failed = true;
+        }
+        else if (allocations.value() != 0)
+        {
+            std::println(stderr, "[Test] [Error] {} allocated {} times in {} rounds", name, allocations.value(),
+                rounds);
+            _failed = true;
+        }
+        else
+        {
+            std::println("[Test] {} ok", name);
+        }
+    }
+
+    // one storm of events, dispatched until every event of it is handled
+    bool dispatch_storm(sway::ipc& ipc, event_counter& counter, const sway::bench::mock_server::storm& storm)
+    {
+        counter.handled = 0;
+        _storm = &storm;
+        _send.release();
+        while (counter.handled != storm.count && !counter.failed)
+        {
+            pollfd poll_fd{ipc.event_fd(), POLLIN, 0};
+            if (::poll(&poll_fd, 1, 1000) <= 0 || !ipc.dispatch().has_value())
+            {
+                return false;
+            }
+        }
+        return !counter.failed;
+    }
+
+    bool failed() const { return _failed; }
+
+private:
+    // null storm stops the thread
+    void send_storms()
+    {
+        while (true)
+        {
+            _send.acquire();
+            if (_storm == nullptr)
+            {
+                return;
+            }
+            _server.send_storm(*_storm);
+        }
+    }
+
+    sway::bench::mock_server& _server;
+    bool _failed = false;
+    // given to sender thread by release of _send
+    const sway::bench::mock_server::storm* _storm = nullptr;
+    std::binary_semaphore _send{0};
+    std::thread _sender;
+};
+} // namespace
+
+int main()
+{
+    const std::filesystem::path payloads = SWAY_IPC_BENCH_PAYLOADS;
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    sway::bench::mock_server server(std::format("{}/sway-ipc-test.{}.sock",
+        runtime_dir != nullptr ? runtime_dir : "/tmp", getpid()));
+    std::expected<void, sway::error_desc> result = server.load_payloads(payloads).and_then([&server]()
+    {
+        return server.start();
+    });
+    if (!result.has_value())
+    {
+        print_error(result.error());
+        return 1;
+    }
+
+    simdjson::ondemand::parser parser;
+    sway::ipc ipc(parser);
+    result = ipc.connect(server.socket_path());
+    if (!result.has_value())
+    {
+        print_error(result.error());
+        return 1;
+    }
+
+    steady_state_test test(server);
+    test.check("reply/get_version", [&]() { return ipc.get_version().has_value(); });
+    test.check("reply/get_workspaces", [&]() { return ipc.get_workspaces().has_value(); });
+    test.check("reply/get_outputs", [&]() { return ipc.get_outputs().has_value(); });
+    test.check("reply/get_tree", [&]() { return ipc.get_tree().has_value(); });
+    test.check("reply/get_tree_decoded", [&]()
+    {
+        return ipc.get_tree().and_then(sway::decode_with<sway::node>(ipc.reply_arena())).has_value();
+    });
+    test.check("reply/run_command", [&]() { return ipc.run_commands("nop").has_value(); });
+
+    simdjson::ondemand::parser event_parser;
+    sway::ipc events(event_parser);
+    result = events.connect(server.socket_path());
+    if (!result.has_value())
+    {
+        print_error(result.error());
+        return 1;
+    }
+    event_counter counter{events};
+    sway::ipc::subscribe_result subscribe_result = events.subscribe_nonblocking(counter);
+    if (subscribe_result.error.has_value() || !subscribe_result.subscription_successful)
+    {
+        std::println(stderr, "[Test] [Error] subscription failed");
+        return 1;
+    }
+
+    const sway::bench::mock_server::storm mode_storm{sway::event_type::mode,
+        {read_payload(payloads / "mode_event.json")}, events_per_round};
+    const sway::bench::mock_server::storm window_storm{sway::event_type::window,
+        {read_payload(payloads / "window_event.json")}, events_per_round};
+    test.check("event/mode", [&]() { return test.dispatch_storm(events, counter, mode_storm); });
+    test.check("event/window_decoded", [&]() { return test.dispatch_storm(events, counter, window_storm); });
+
+    return test.failed() ? 1 : 0;
+}
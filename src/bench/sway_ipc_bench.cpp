@@ -0,0 +1,983 @@
+#include "allocation_counter.hpp"
+#include "mock_server.hpp"
+#include "placement/placement_handler.hpp"
+#include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/async_ipc.hpp>
+#include <sway_ipc/event_loop.hpp>
+#include <sway_ipc/events/events.hpp>
+#include <sway_ipc/query.hpp>
+#include <sway_ipc/replies.hpp>
+#include <sway_ipc/task.hpp>
+#include "print_error.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+
+// benchmarks of sway::ipc against mock_server. Build with -DSWAY_IPC_BUILD_BENCH=ON, and run
+// sway_ipc_bench [--filter <part of name>] [--iterations <count>] [--payloads <directory>]
+// Exit code is 1 if reply or event path allocated after warm up
+
+namespace
+{
+struct options
+{
+    std::string_view filter;
+    size_t iterations = 10000;
+    std::filesystem::path payloads = SWAY_IPC_BENCH_PAYLOADS;
+};
+
+struct bench_result
+{
+    size_t iterations;
+    std::chrono::nanoseconds time;
+    size_t allocations;
+    // benchmark specific counter, like events per second
+    std::string extra;
+};
+
+void print_header()
+{
+    std::println("{:<32} {:>14} {:>12} {:>12}  {}", "Benchmark", "Time", "Iterations", "allocs/op", "");
+    std::println("{:-<84}", "");
+}
+
+void print_result(std::string_view name, const bench_result& result)
+{
+    const double ns_per_op = static_cast<double>(result.time.count()) / static_cast<double>(result.iterations);
+    const double allocations_per_op = static_cast<double>(result.allocations) / static_cast<double>(result.iterations);
+    std::println("{:<32} {:>11.0f} ns {:>12} {:>12.2f}  {}", name, ns_per_op, result.iterations, allocations_per_op, result.extra);
+}
+
+// calls op iterations times, after tenth of that as warm up
+bench_result measure(size_t iterations, const std::function<bool()>& op)
+{
+    for (size_t i = 0; i < iterations / 10; ++i)
+    {
+        op();
+    }
+
+    const size_t allocations_before = sway::bench::allocated();
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        if (!op())
+        {
+            std::println(stderr, "[Bench] [Error] operation failed on iteration {}", i);
+            break;
+        }
+    }
+    const auto time = std::chrono::steady_clock::now() - start;
+    return bench_result{iterations, std::chrono::duration_cast<std::chrono::nanoseconds>(time),
+        sway::bench::allocated() - allocations_before, {}};
+}
+
+bench_result bench_request(sway::ipc& ipc, size_t iterations, sway::ipc::request_result (sway::ipc::*request)())
+{
+    return measure(iterations, [&]()
+    {
+        return (ipc.*request)().has_value();
+    });
+}
+
+// tree decoded into typed structs, either in arena of ipc, or in heap
+bench_result bench_decoded_tree(sway::ipc& ipc, size_t iterations, bool in_arena)
+{
+    return measure(iterations, [&]()
+    {
+        std::expected<sway::node, sway::error_desc> tree = in_arena ?
+            ipc.get_tree().and_then(sway::decode_with<sway::node>(ipc.reply_arena())) :
+            ipc.get_tree().and_then(sway::decode<sway::node>);
+        return tree.has_value();
+    });
+}
+
+// outputs decoded with each request, or served by reply cache of subscribed ipc
+bench_result bench_outputs(sway::bench::mock_server& server, size_t iterations, bool cached)
+{
+    simdjson::ondemand::parser parser;
+    sway::ipc ipc(parser);
+    std::vector<sway::event_type> events = {sway::event_type::workspace, sway::event_type::output};
+    if (!ipc.connect(server.socket_path()).has_value() ||
+        !ipc.subscribe_nonblocking(events, [](sway::ipc::event_result) { return false; }).subscription_successful)
+    {
+        return bench_result{1, {}, 0, "subscription failed"};
+    }
+
+    return measure(iterations, [&]()
+    {
+        if (cached)
+        {
+            return ipc.cached_outputs().has_value();
+        }
+        return ipc.get_outputs().and_then(sway::decode_with<std::pmr::vector<sway::output>>(ipc.reply_arena()))
+            .has_value();
+    });
+}
+
+// criteria compiled once, and matched against fresh tree every iteration
+bench_result bench_query(sway::ipc& ipc, size_t iterations, std::string_view criteria, size_t limit)
+{
+    std::expected<sway::query, sway::error_desc> query = sway::query::compile(criteria);
+    if (!query.has_value())
+    {
+        print_error(query.error());
+        return bench_result{1, {}, 0, "criteria failed to compile"};
+    }
+
+    size_t matches = 0;
+    bench_result result = measure(iterations, [&]()
+    {
+        sway::ipc::request_result tree = ipc.get_tree();
+        if (!tree.has_value())
+        {
+            return false;
+        }
+        std::expected<std::pmr::vector<sway::query_match>, sway::error_desc> found =
+            query->find(tree.value(), limit, ipc.reply_arena());
+        matches = found.has_value() ? found->size() : 0;
+        return found.has_value();
+    });
+    result.extra = std::format("{} matches of {}", matches, criteria);
+    return result;
+}
+
+bench_result bench_run_command(sway::ipc& ipc, size_t iterations)
+{
+    return measure(iterations, [&]()
+    {
+        return ipc.run_commands("nop").has_value();
+    });
+}
+
+bench_result bench_batch(sway::ipc& ipc, size_t iterations, size_t batch_size)
+{
+    sway::ipc::batch batch;
+    bench_result result = measure(iterations / batch_size, [&]()
+    {
+        batch.clear();
+        for (size_t i = 0; i < batch_size; ++i)
+        {
+            batch.add(sway::payload_type::get_workspaces);
+        }
+        return ipc.send_batch(batch).has_value();
+    });
+    result.extra = std::format("{} requests per batch", batch_size);
+    return result;
+}
+
+// command followed by event_barrier, as client which waits for events its command caused would do.
+// Separate connection subscribes to ticks, the one of other benchmarks is not subscribed
+bench_result bench_barrier(sway::bench::mock_server& server, size_t iterations)
+{
+    simdjson::ondemand::parser parser;
+    sway::ipc ipc(parser);
+    if (!ipc.connect(server.socket_path()).has_value())
+    {
+        return bench_result{1, {}, 0, "connection failed"};
+    }
+
+    size_t ticks = 0;
+    std::vector<sway::event_type> events = {sway::event_type::tick};
+    sway::ipc::subscribe_result subscribe_result = ipc.subscribe_nonblocking(events,
+        [&ticks](sway::ipc::event_result event)
+        {
+            ++ticks;
+            return !event.has_value();
+        });
+    if (subscribe_result.error.has_value() || !subscribe_result.subscription_successful)
+    {
+        return bench_result{1, {}, 0, "subscription failed"};
+    }
+
+    bench_result result = measure(iterations, [&]()
+    {
+        std::expected<bool, sway::error_desc> barrier_result = ipc.run_commands("nop").and_then([&ipc](auto&&)
+        {
+            return ipc.event_barrier(std::chrono::seconds(1));
+        });
+        return barrier_result.has_value() && barrier_result.value();
+    });
+    result.extra = std::format("{} ticks", ticks);
+    return result;
+}
+
+std::expected<std::vector<placement::rule>, sway::error_desc> placement_rules(
+    std::span<const std::string_view> apps)
+{
+    std::vector<placement::rule> rules;
+    for (std::string_view app : apps)
+    {
+        std::expected<sway::query, sway::error_desc> criteria =
+            sway::query::compile(std::format("[app_id=\"{}\"]", app));
+        if (!criteria.has_value())
+        {
+            return std::unexpected(criteria.error());
+        }
+        // comma separated actions, which apply to the same window
+        rules.push_back(placement::rule{std::move(criteria.value()), "move container to workspace 2, focus"});
+    }
+    return rules;
+}
+
+// placement daemon handling two new windows of one burst, moves of both are sent as one message.
+// Mock refuses criteria which sway would not read, so joining them wrong fails the operation
+bench_result bench_placement_burst(sway::bench::mock_server& server, size_t iterations)
+{
+    simdjson::ondemand::parser parser;
+    sway::ipc ipc(parser);
+    if (!ipc.connect(server.socket_path()).has_value())
+    {
+        return bench_result{1, {}, 0, "connection failed"};
+    }
+    constexpr std::string_view apps[] = {"bench_a", "bench_b"};
+    std::expected<std::vector<placement::rule>, sway::error_desc> rules = placement_rules(apps);
+    if (!rules.has_value())
+    {
+        return bench_result{1, {}, 0, "rules failed"};
+    }
+
+    placement::placement_handler handler{ipc, rules.value()};
+    sway::ipc::subscribe_result subscribe_result = ipc.subscribe_nonblocking(handler,
+        sway::coalesce_options{sway::coalesce_options::mode::batch, std::chrono::milliseconds(0)});
+    if (subscribe_result.error.has_value() || !subscribe_result.subscription_successful)
+    {
+        return bench_result{1, {}, 0, "subscription failed"};
+    }
+
+    auto window_event = [](std::string_view change, int64_t id, std::string_view app)
+    {
+        return std::format(R"({{"change":"{}","container":{{"id":{},"type":"con","name":"{}","app_id":"{}",)"
+            R"("pid":1,"nodes":[],"floating_nodes":[]}}}})", change, id, app, app);
+    };
+    const sway::bench::mock_server::storm mapped{sway::event_type::window,
+        {window_event("new", 1001, apps[0]), window_event("new", 1002, apps[1])}, 2};
+    const sway::bench::mock_server::storm closed{sway::event_type::window,
+        {window_event("close", 1001, apps[0]), window_event("close", 1002, apps[1])}, 2};
+    // dispatches until handler has that many windows placed
+    auto wait_applied = [&ipc, &handler](size_t count)
+    {
+        while (handler.applied.size() != count && !handler.error.has_value())
+        {
+            pollfd poll_fd{ipc.event_fd(), POLLIN, 0};
+            if (::poll(&poll_fd, 1, 1000) <= 0 || !ipc.dispatch().has_value())
+            {
+                return false;
+            }
+        }
+        return !handler.error.has_value();
+    };
+
+    bench_result result = measure(iterations, [&]()
+    {
+        server.send_storm(mapped);
+        const bool placed = wait_applied(2);
+        server.send_storm(closed);
+        return placed && wait_applied(0) && handler.failed == 0;
+    });
+    result.extra = std::format("{} commands refused", handler.failed);
+    return result;
+}
+
+// startup pass of placement daemon: every window of get_tree matched by rules is moved by one message
+bench_result bench_placement_existing(sway::ipc& ipc, size_t iterations)
+{
+    constexpr std::string_view apps[] = {"foot", "firefox"};
+    std::expected<std::vector<placement::rule>, sway::error_desc> rules = placement_rules(apps);
+    if (!rules.has_value())
+    {
+        return bench_result{1, {}, 0, "rules failed"};
+    }
+
+    placement::placement_handler handler{ipc, rules.value()};
+    bench_result result = measure(iterations, [&]()
+    {
+        handler.applied.clear();
+        return placement::place_existing(handler).has_value() && handler.failed == 0;
+    });
+    result.extra = std::format("{} windows per pass, {} commands refused", handler.applied.size(), handler.failed);
+    return result;
+}
+
+// sent after storm, subscription ends when it is handled. Its change differs from every
+// event of storm, so it is not collapsed with them
+constexpr std::string_view last_event = R"({"change":"bench_last_event"})";
+
+enum class event_handling
+{
+    // std::function callback, which reads change straight from json
+    raw,
+    // same, but window event is decoded into sway::window_event in event arena of ipc
+    decoded,
+    // typed handler of mode events instead of std::function
+    typed
+};
+
+// forwards mode events from typed subscription to callback of bench
+template <typename F>
+struct mode_handler
+{
+    F& callback;
+
+    bool operator()(sway::event_tag<sway::event_type::mode>, sway::ipc::event_payload& event)
+    {
+        return callback(std::move(event));
+    }
+
+    bool on_error(const sway::error_desc& error)
+    {
+        return callback(std::unexpected(error));
+    }
+};
+
+// subscribes from other thread, and measures time from start of storm until last event is handled
+bench_result bench_events(sway::bench::mock_server& server, size_t count, sway::event_type event_type,
+    std::string payload, sway::coalesce_options coalesce = {}, event_handling handling = event_handling::raw,
+    std::span<const sway::event_filter> filters = {})
+{
+    // subscriber of previous benchmark could be not noticed as disconnected yet
+    while (server.subscribers(event_type) != 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::atomic<bool> failed = false;
+    size_t callbacks = 0;
+    size_t longest_burst = 0;
+    size_t allocations_at_first = 0;
+    size_t allocations_at_last = 0;
+
+    std::thread subscriber([&]()
+    {
+        simdjson::ondemand::parser parser;
+        sway::ipc ipc(parser);
+        if (!ipc.connect(server.socket_path()).has_value())
+        {
+            failed = true;
+            return;
+        }
+
+        auto callback = [&](sway::ipc::event_result event)
+        {
+            if (callbacks++ == 0)
+            {
+                allocations_at_first = sway::bench::allocated();
+            }
+            if (!event.has_value())
+            {
+                failed = true;
+                return true;
+            }
+            longest_burst = std::max(longest_burst, event->remaining_in_burst + 1);
+
+            // touches event, as real handler would
+            std::string_view change;
+            if (handling == event_handling::decoded)
+            {
+                std::expected<sway::window_event, sway::error_desc> window =
+                    sway::decode_with<sway::window_event>(ipc.event_arena())(std::move(event->json));
+                if (!window.has_value())
+                {
+                    failed = true;
+                    return true;
+                }
+                change = window->change;
+            }
+            else if (event->json.find_field("change").get_string().get(change) != simdjson::error_code::SUCCESS)
+            {
+                failed = true;
+                return true;
+            }
+            allocations_at_last = sway::bench::allocated();
+            return change == "bench_last_event";
+        };
+
+        std::vector<sway::event_type> events = {event_type};
+        mode_handler<decltype(callback)> handler{callback};
+        sway::ipc::subscribe_result result = handling == event_handling::typed ?
+            ipc.subscribe(handler, coalesce) :
+            ipc.subscribe(events, callback, coalesce, filters);
+        failed = failed || result.error.has_value() || !result.subscription_successful;
+    });
+
+    while (server.subscribers(event_type) == 0 && !failed)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    server.send_storm(sway::bench::mock_server::storm{event_type, {std::move(payload)}, count, 64});
+    server.send_storm(sway::bench::mock_server::storm{event_type, {std::string(last_event)}, 1});
+    subscriber.join();
+    const auto time = std::chrono::steady_clock::now() - start;
+
+    if (failed)
+    {
+        std::println(stderr, "[Bench] [Error] subscription failed");
+    }
+    const double seconds = std::chrono::duration<double>(time).count();
+    // first event is excluded from allocations, it warms up buffers
+    return bench_result{count, std::chrono::duration_cast<std::chrono::nanoseconds>(time),
+        allocations_at_last - allocations_at_first,
+        std::format("{:.0f} events/s, {} callbacks, longest burst {}", static_cast<double>(count) / seconds,
+            callbacks - 1, longest_burst)};
+}
+
+// threaded subscription of window events of two containers with two workers, and function slower than storm.
+// Routed by type, all of them go to one worker, routed by container, each worker gets one container
+bench_result bench_threaded_workers(sway::bench::mock_server& server, size_t count, std::string payload,
+    enum sway::fanout_options::routing routing)
+{
+    while (server.subscribers(sway::event_type::window) != 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::string other_payload = payload;
+    const size_t id = other_payload.find("\"id\": 6");
+    if (id != std::string::npos)
+    {
+        other_payload.replace(id, 7, "\"id\": 7");
+    }
+
+    std::atomic<bool> failed = false;
+    // nothing is dropped, so the last handled event ends subscription, whichever worker has it
+    std::atomic<size_t> handled = 0;
+    std::atomic<size_t> busy_workers = 0;
+    uint64_t delivered = 0;
+    std::thread subscriber([&]()
+    {
+        simdjson::ondemand::parser parser;
+        sway::ipc ipc(parser);
+        if (!ipc.connect(server.socket_path()).has_value())
+        {
+            failed = true;
+            return;
+        }
+
+        auto callback = [&](sway::ipc::event_result event)
+        {
+            thread_local bool counted = false;
+            if (!counted)
+            {
+                counted = true;
+                ++busy_workers;
+            }
+            if (!event.has_value())
+            {
+                failed = true;
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+            return ++handled == count;
+        };
+
+        std::vector<sway::event_type> events = {sway::event_type::window};
+        sway::ipc::subscribe_result result = ipc.subscribe_threaded(events, callback,
+            sway::fanout_options{.queue_capacity = 16, .workers = 2, .routing = routing});
+        failed = failed || result.error.has_value() || !result.subscription_successful;
+        delivered = ipc.fanout_statistics().delivered.load();
+    });
+
+    while (server.subscribers(sway::event_type::window) == 0 && !failed)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    server.send_storm(sway::bench::mock_server::storm{sway::event_type::window,
+        {std::move(payload), std::move(other_payload)}, count, 64});
+    subscriber.join();
+    const auto time = std::chrono::steady_clock::now() - start;
+
+    if (failed || delivered != count)
+    {
+        std::println(stderr, "[Bench] [Error] threaded subscription failed");
+    }
+    return bench_result{count, std::chrono::duration_cast<std::chrono::nanoseconds>(time), 0,
+        std::format("{} delivered, {} of 2 workers busy", delivered, busy_workers.load())};
+}
+
+// threaded subscription with function slower than storm, so reader finds queue full and applies
+// overflow policy. Storm alternates events of two windows, which coalesce should never merge
+bench_result bench_threaded(sway::bench::mock_server& server, size_t count, std::string payload,
+    enum sway::fanout_options::overflow overflow)
+{
+    while (server.subscribers(sway::event_type::window) != 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // the same event of other container
+    std::string other_payload = payload;
+    const size_t id = other_payload.find("\"id\": 6");
+    if (id != std::string::npos)
+    {
+        other_payload.replace(id, 7, "\"id\": 7");
+    }
+
+    std::atomic<bool> failed = false;
+    uint64_t read = 0;
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    uint64_t coalesced = 0;
+    std::thread subscriber([&]()
+    {
+        simdjson::ondemand::parser parser;
+        sway::ipc ipc(parser);
+        if (!ipc.connect(server.socket_path()).has_value())
+        {
+            failed = true;
+            return;
+        }
+
+        auto callback = [&failed](sway::ipc::event_result event)
+        {
+            std::string_view change;
+            if (!event.has_value() ||
+                event->json.find_field("change").get_string().get(change) != simdjson::error_code::SUCCESS)
+            {
+                failed = true;
+                return true;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(20));
+            return change == "bench_last_event";
+        };
+
+        std::vector<sway::event_type> events = {sway::event_type::window};
+        sway::ipc::subscribe_result result = ipc.subscribe_threaded(events, callback,
+            sway::fanout_options{.queue_capacity = 16, .overflow = overflow});
+        failed = failed || result.error.has_value() || !result.subscription_successful;
+
+        const sway::fanout_stats& stats = ipc.fanout_statistics();
+        read = stats.read.load();
+        delivered = stats.delivered.load();
+        dropped = stats.dropped.load();
+        coalesced = stats.coalesced.load();
+    });
+
+    while (server.subscribers(sway::event_type::window) == 0 && !failed)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    server.send_storm(sway::bench::mock_server::storm{sway::event_type::window,
+        {std::move(payload), std::move(other_payload)}, count, 64});
+    server.send_storm(sway::bench::mock_server::storm{sway::event_type::window, {std::string(last_event)}, 1});
+    subscriber.join();
+    const auto time = std::chrono::steady_clock::now() - start;
+
+    // the last event is never dropped, and every event is either delivered, dropped or merged
+    if (failed || delivered + dropped + coalesced != read)
+    {
+        std::println(stderr, "[Bench] [Error] threaded subscription failed");
+    }
+    return bench_result{count, std::chrono::duration_cast<std::chrono::nanoseconds>(time), 0,
+        std::format("{} read, {} delivered, {} dropped, {} coalesced", read, delivered, dropped, coalesced)};
+}
+
+struct async_requests
+{
+    sway::async_ipc& ipc;
+    sway::event_loop& loop;
+    // requests not sent yet
+    size_t remaining;
+    // coroutines not finished yet, the last one stops loop
+    size_t running;
+    bool failed = false;
+};
+
+// one of coroutines, which send requests at once. Each awaits its reply before sending the next one
+sway::task<> request_versions(async_requests& state)
+{
+    while (state.remaining != 0 && !state.failed)
+    {
+        --state.remaining;
+        sway::async_ipc::request_result reply = co_await state.ipc.get_version();
+        // touches reply before the next one replaces it, as real consumer would
+        std::string_view human_readable;
+        state.failed = !reply.has_value() ||
+            reply->find_field("human_readable").get_string().get(human_readable) != simdjson::error_code::SUCCESS;
+    }
+    if (--state.running == 0)
+    {
+        state.loop.stop();
+    }
+}
+
+// get_version awaited from depth coroutines at once, so depth requests are pipelined over one connection
+bench_result bench_async_requests(sway::bench::mock_server& server, size_t iterations, size_t depth)
+{
+    sway::event_loop loop;
+    sway::async_ipc ipc(loop);
+    if (!ipc.connect(server.socket_path()).has_value())
+    {
+        return bench_result{1, {}, 0, "connection failed"};
+    }
+
+    auto run = [&ipc, &loop, depth](size_t count)
+    {
+        async_requests state{ipc, loop, count, depth};
+        for (size_t i = 0; i < depth; ++i)
+        {
+            sway::spawn(request_versions(state));
+        }
+        // every coroutine could be done already, if there was nothing to send
+        return (state.running == 0 || loop.run().has_value()) && !state.failed;
+    };
+
+    run(iterations / 10);
+    const size_t allocations_before = sway::bench::allocated();
+    const auto start = std::chrono::steady_clock::now();
+    const bool succeeded = run(iterations);
+    const auto time = std::chrono::steady_clock::now() - start;
+    if (!succeeded)
+    {
+        std::println(stderr, "[Bench] [Error] pipelined requests failed");
+    }
+    return bench_result{iterations, std::chrono::duration_cast<std::chrono::nanoseconds>(time),
+        sway::bench::allocated() - allocations_before, std::format("{} requests in flight", depth)};
+}
+
+struct async_events
+{
+    sway::async_ipc& ipc;
+    sway::event_loop& loop;
+    sway::event_type event_type;
+    size_t received = 0;
+    size_t allocations_at_first = 0;
+    size_t allocations_at_last = 0;
+    bool failed = false;
+};
+
+// awaits events one by one, until the last event of storm
+sway::task<> await_events(async_events& state)
+{
+    std::vector<sway::event_type> events = {state.event_type};
+    std::expected<void, sway::error_desc> subscribe_result = co_await state.ipc.subscribe(std::move(events));
+    while (subscribe_result.has_value())
+    {
+        sway::async_ipc::event_result event = co_await state.ipc.next_event();
+        if (state.received++ == 0)
+        {
+            state.allocations_at_first = sway::bench::allocated();
+        }
+        std::string_view change;
+        if (!event.has_value() ||
+            event->json.find_field("change").get_string().get(change) != simdjson::error_code::SUCCESS)
+        {
+            break;
+        }
+        state.allocations_at_last = sway::bench::allocated();
+        if (change == "bench_last_event")
+        {
+            state.loop.stop();
+            co_return;
+        }
+    }
+    state.failed = true;
+    state.loop.stop();
+}
+
+// the same storm as bench_events, awaited from coroutine of async_ipc
+bench_result bench_async_events(sway::bench::mock_server& server, size_t count, sway::event_type event_type,
+    std::string payload)
+{
+    while (server.subscribers(event_type) != 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::atomic<bool> failed = false;
+    size_t received = 0;
+    size_t allocations_at_first = 0;
+    size_t allocations_at_last = 0;
+    std::thread subscriber([&]()
+    {
+        sway::event_loop loop;
+        sway::async_ipc ipc(loop);
+        async_events state{ipc, loop, event_type};
+        if (!ipc.connect(server.socket_path()).has_value())
+        {
+            failed = true;
+            return;
+        }
+        // subscription could fail before the first await
+        sway::spawn(await_events(state));
+        if (!state.failed)
+        {
+            failed = !loop.run().has_value();
+        }
+        failed = failed || state.failed;
+        received = state.received;
+        allocations_at_first = state.allocations_at_first;
+        allocations_at_last = state.allocations_at_last;
+    });
+
+    while (server.subscribers(event_type) == 0 && !failed)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    server.send_storm(sway::bench::mock_server::storm{event_type, {std::move(payload)}, count, 64});
+    server.send_storm(sway::bench::mock_server::storm{event_type, {std::string(last_event)}, 1});
+    subscriber.join();
+    const auto time = std::chrono::steady_clock::now() - start;
+
+    if (failed)
+    {
+        std::println(stderr, "[Bench] [Error] subscription failed");
+    }
+    const double seconds = std::chrono::duration<double>(time).count();
+    return bench_result{count, std::chrono::duration_cast<std::chrono::nanoseconds>(time),
+        allocations_at_last - allocations_at_first,
+        std::format("{:.0f} events/s, {} awaited", static_cast<double>(count) / seconds, received - 1)};
+}
+
+std::string read_payload(const std::filesystem::path& path)
+{
+    std::string content;
+    FILE* file = std::fopen(path.c_str(), "r");
+    if (file == nullptr)
+    {
+        return content;
+    }
+    char chunk[4096];
+    size_t read;
+    while ((read = std::fread(chunk, 1, sizeof(chunk), file)) != 0)
+    {
+        content.append(chunk, read);
+    }
+    std::fclose(file);
+    return content;
+}
+
+bool selected(const options& options, std::string_view name)
+{
+    return options.filter.empty() || name.find(options.filter) != std::string_view::npos;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--filter")
+        {
+            options.filter = argv[i + 1];
+        }
+        else if (arg == "--iterations")
+        {
+            options.iterations = std::strtoull(argv[i + 1], nullptr, 10);
+        }
+        else if (arg == "--payloads")
+        {
+            options.payloads = argv[i + 1];
+        }
+    }
+
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    sway::bench::mock_server server(std::format("{}/sway-ipc-bench.{}.sock",
+        runtime_dir != nullptr ? runtime_dir : "/tmp", getpid()));
+    std::expected<void, sway::error_desc> result = server.load_payloads(options.payloads).and_then([&server]()
+    {
+        return server.start();
+    });
+    if (!result.has_value())
+    {
+        print_error(result.error());
+        return 1;
+    }
+
+    simdjson::ondemand::parser parser;
+    sway::ipc ipc(parser);
+    result = ipc.connect(server.socket_path());
+    if (!result.has_value())
+    {
+        print_error(result.error());
+        return 1;
+    }
+
+    const size_t iterations = options.iterations;
+    print_header();
+
+    // reply and event paths should not allocate after warm up, only decoding into heap does.
+    // Allocation there, or growth of receive buffer, makes exit code nonzero
+    bool steady_allocations = false;
+    auto print_allocation_free = [&steady_allocations](std::string_view name, const bench_result& result)
+    {
+        print_result(name, result);
+        if (result.allocations != 0)
+        {
+            std::println(stderr, "[Bench] [Error] {} allocated {} times in steady state", name, result.allocations);
+            steady_allocations = true;
+        }
+    };
+
+    struct request_bench
+    {
+        std::string_view name;
+        sway::ipc::request_result (sway::ipc::*request)();
+    };
+    const request_bench request_benches[] = {
+        {"request/get_version", &sway::ipc::get_version},
+        {"request/get_workspaces", &sway::ipc::get_workspaces},
+        {"request/get_outputs", &sway::ipc::get_outputs},
+        {"request/get_tree", &sway::ipc::get_tree},
+    };
+    for (const request_bench& bench : request_benches)
+    {
+        if (selected(options, bench.name))
+        {
+            print_allocation_free(bench.name, bench_request(ipc, iterations, bench.request));
+        }
+    }
+
+    if (selected(options, "request/get_tree_decoded"))
+    {
+        print_allocation_free("request/get_tree_decoded", bench_decoded_tree(ipc, iterations, true));
+    }
+    if (selected(options, "request/get_tree_decoded_heap"))
+    {
+        print_result("request/get_tree_decoded_heap", bench_decoded_tree(ipc, iterations, false));
+    }
+    if (selected(options, "request/get_outputs_decoded"))
+    {
+        print_allocation_free("request/get_outputs_decoded", bench_outputs(server, iterations, false));
+    }
+    if (selected(options, "request/get_outputs_cached"))
+    {
+        print_allocation_free("request/get_outputs_cached", bench_outputs(server, iterations, true));
+    }
+    // first match is near the start of the tree, so the pass stops early
+    if (selected(options, "query/app_id_first"))
+    {
+        print_allocation_free("query/app_id_first", bench_query(ipc, iterations, "[app_id=\"foot\"]", 1));
+    }
+    // the only match is the last window, so the whole tree is passed
+    if (selected(options, "query/class"))
+    {
+        print_allocation_free("query/class",
+            bench_query(ipc, iterations, "[class=\"spotify\"]", sway::query::no_limit));
+    }
+    // other workspaces are skipped
+    if (selected(options, "query/workspace"))
+    {
+        print_allocation_free("query/workspace",
+            bench_query(ipc, iterations, "[workspace=\"^9\" tiling]", sway::query::no_limit));
+    }
+    if (selected(options, "request/run_command"))
+    {
+        print_allocation_free("request/run_command", bench_run_command(ipc, iterations));
+    }
+    if (selected(options, "request/batch_8"))
+    {
+        print_allocation_free("request/batch_8", bench_batch(ipc, iterations, 8));
+    }
+    if (selected(options, "request/barrier"))
+    {
+        print_allocation_free("request/barrier", bench_barrier(server, iterations));
+    }
+    if (selected(options, "placement/existing"))
+    {
+        print_result("placement/existing", bench_placement_existing(ipc, iterations));
+    }
+    if (selected(options, "placement/burst_2"))
+    {
+        print_result("placement/burst_2", bench_placement_burst(server, iterations));
+    }
+    if (selected(options, "async/get_version_1"))
+    {
+        print_result("async/get_version_1", bench_async_requests(server, iterations, 1));
+    }
+    if (selected(options, "async/get_version_16"))
+    {
+        print_result("async/get_version_16", bench_async_requests(server, iterations, 16));
+    }
+
+    const std::string mode_event = read_payload(options.payloads / "mode_event.json");
+    const std::string window_event = read_payload(options.payloads / "window_event.json");
+    const size_t event_count = iterations * 10;
+    if (selected(options, "events/mode"))
+    {
+        print_allocation_free("events/mode", bench_events(server, event_count, sway::event_type::mode, mode_event));
+    }
+    if (selected(options, "events/mode_typed"))
+    {
+        print_allocation_free("events/mode_typed", bench_events(server, event_count, sway::event_type::mode, mode_event,
+            {}, event_handling::typed));
+    }
+    if (selected(options, "events/window"))
+    {
+        print_allocation_free("events/window",
+            bench_events(server, event_count, sway::event_type::window, window_event));
+    }
+    // bursts end on their bound of events, as below. With quiet window 0 burst takes whatever socket holds,
+    // and receive buffer grows whenever it happens to hold more than ever before
+    if (selected(options, "events/window_collapsed"))
+    {
+        print_allocation_free("events/window_collapsed", bench_events(server, event_count, sway::event_type::window,
+            window_event, sway::coalesce_options{sway::coalesce_options::mode::collapse, std::chrono::milliseconds(50),
+                std::chrono::milliseconds(1000), 64}));
+    }
+    // storm is longer than quiet window, so bursts end on their bound of events
+    if (selected(options, "events/window_bounded"))
+    {
+        print_allocation_free("events/window_bounded", bench_events(server, event_count, sway::event_type::window,
+            window_event, sway::coalesce_options{sway::coalesce_options::mode::batch, std::chrono::milliseconds(50),
+                std::chrono::milliseconds(1000), 64}));
+    }
+    // storm is rejected on raw bytes, only the last event is parsed
+    if (selected(options, "events/window_filtered"))
+    {
+        static constexpr std::string_view last_change[] = {"bench_last_event"};
+        static constexpr sway::event_filter filters[] = {{sway::event_type::window, last_change}};
+        print_allocation_free("events/window_filtered", bench_events(server, event_count, sway::event_type::window,
+            window_event, {}, event_handling::raw, filters));
+    }
+    if (selected(options, "events/threaded_drop_oldest"))
+    {
+        print_result("events/threaded_drop_oldest", bench_threaded(server, event_count, window_event,
+            sway::fanout_options::overflow::drop_oldest));
+    }
+    if (selected(options, "events/threaded_coalesce"))
+    {
+        print_result("events/threaded_coalesce", bench_threaded(server, event_count, window_event,
+            sway::fanout_options::overflow::coalesce));
+    }
+    if (selected(options, "events/threaded_by_type_2"))
+    {
+        print_result("events/threaded_by_type_2", bench_threaded_workers(server, iterations, window_event,
+            sway::fanout_options::routing::event_type));
+    }
+    if (selected(options, "events/threaded_by_container_2"))
+    {
+        print_result("events/threaded_by_container_2", bench_threaded_workers(server, iterations, window_event,
+            sway::fanout_options::routing::container));
+    }
+    if (selected(options, "async/events_mode"))
+    {
+        print_result("async/events_mode", bench_async_events(server, event_count, sway::event_type::mode, mode_event));
+    }
+    if (selected(options, "events/window_decoded"))
+    {
+        print_allocation_free("events/window_decoded", bench_events(server, event_count, sway::event_type::window,
+            window_event, {}, event_handling::decoded));
+    }
+    return steady_allocations ? 1 : 0;
+}
@@ -0,0 +1,2 @@
+#! /bin/bash
+LD_LIBRARY_PATH=$HOME/.local/lib `dirname $0`/sway_bar_daemon "$@"
@@ -0,0 +1,9 @@
+#! /bin/bash
+# lines of one module of sway_bar_daemon, for exec of waybar custom module.
+# open blocks until daemon opens fifo, and cat ends when daemon exits, so restarted daemon is picked up.
+# Daemon reopens fifo for new reader within half a second, and writes the last line to it again
+fifo=${XDG_RUNTIME_DIR:-/tmp}/sway_bar_daemon/$1
+while true; do
+    while [ ! -p "$fifo" ]; do sleep 0.5; done
+    cat "$fifo"
+done
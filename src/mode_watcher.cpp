@@ -1,96 +1,130 @@
-#include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/async_ipc.hpp>
+#include <sway_ipc/event_loop.hpp>
+#include <sway_ipc/replies.hpp>
+#include <sway_ipc/task.hpp>
+#include "bar/mode_module.hpp"
 #include "print_error.hpp"
 #include "sway_ipc/events/event_type.hpp"
+#include "sway_ipc/events/events.hpp"
+#include "waybar_output.hpp"
+#include <optional>
 #include <print>
+#include <vector>
+
+// single coroutine on event loop: subscribes to mode events, asks sway for current mode, so bar shows it
+// before the first change, and then awaits events one by one
 
 namespace
 {
-void mode_callback(simdjson::ondemand::document json)
+struct mode_state
+{
+    sway::async_ipc& ipc;
+    sway::event_loop& loop;
+    // the same module as in sway_bar_daemon, watcher only feeds it and writes what it renders
+    bar::mode_module module;
+    // repeated mode events do not reach waybar, output writes only changes
+    waybar::output output;
+    // error of connection, loop is stopped when it is set
+    std::optional<sway::error_desc> error;
+};
+
+void write_mode(mode_state& state, std::string_view mode)
+{
+    state.module.on_event(bar::event(sway::mode_event{.change = mode}));
+    std::expected<void, sway::error_desc> write_result = state.output.write(state.module.render());
+    if (!write_result.has_value())
+    {
+        print_error(write_result.error());
+    }
+}
+
+void mode_callback(mode_state& state, simdjson::ondemand::document json)
 {
-    simdjson::simdjson_result<std::string_view> change = json.find_field("change").get_string();
-    if (change.error() != simdjson::error_code::SUCCESS)
+    std::expected<sway::mode_event, sway::error_desc> mode = sway::decode<sway::mode_event>(std::move(json));
+    if (!mode.has_value())
     {
-        std::println(stderr, "[ModeTracker] [Error] parsing error when parsing mode event: error code {}",
-            static_cast<int>(change.error()));
+        std::println(stderr, "[ModeTracker] [Error] parsing error when parsing mode event: {}",
+            mode.error().describe());
         return;
     }
-    else if (change.value_unsafe() == "default")
+    write_mode(state, mode->change);
+}
+
+sway::task<> watch_modes(mode_state& state)
+{
+    auto fail = [&state](sway::error_desc error)
+    {
+        state.error = std::move(error);
+        state.loop.stop();
+    };
+
+    // not subscribing to shutdown, because expecting that waybar subscribed to it instead
+    std::vector<sway::event_type> events = {sway::event_type::mode};
+    std::expected<void, sway::error_desc> subscribe_result = co_await state.ipc.subscribe(std::move(events));
+    if (!subscribe_result.has_value())
     {
-        std::println("");
-        std::fflush(stdout);
+        fail(std::move(subscribe_result.error()));
+        co_return;
     }
-    else
+
+    // asked after subscription, so change made in between is not missed. Reply is decoded before
+    // the next await, since document is valid only until the next reply
+    std::expected<sway::binding_state, sway::error_desc> binding_state =
+        (co_await state.ipc.get_binding_state()).and_then(sway::decode<sway::binding_state>);
+    if (!binding_state.has_value())
     {
-        // inside a special unicode character,
-        // that will be rendered by waybar as an arrow
-        std::println("");
-        std::fflush(stdout);
+        fail(std::move(binding_state.error()));
+        co_return;
     }
-}
+    write_mode(state, binding_state->name);
 
-bool event_callback(sway::ipc::event_result event_result)
-{
-    if (!event_result.has_value())
+    while (true)
     {
-        const sway::error_desc& error = event_result.error();
-        if (error.error_source == sway::error_desc::error_source::posix ||
-            error.error_source == sway::error_desc::error_source::invalid)
+        sway::async_ipc::event_result event = co_await state.ipc.next_event();
+        if (!event.has_value())
         {
-            return true;
+            const sway::error_desc& error = event.error();
+            if (error.error_source == sway::error_desc::error_source::posix ||
+                error.error_source == sway::error_desc::error_source::invalid)
+            {
+                fail(error);
+                co_return;
+            }
+            std::println(stderr, "[ModeTracker] [Error] {}", error.describe());
+            continue;
         }
-        else
-        {
-            std::println(stderr, "[ModeTracker] [Error] {}, error code: {}",
-                error.error_description, error.error_code);
-            return false;
-        }
-    }
-    switch (event_result->event_type)
-    {
-        case sway::event_type::mode:
-            mode_callback(std::move(event_result->json));
-            return false;
-        case sway::event_type::shutdown:
-            return true;
-        default:
-            return false;
+        mode_callback(state, std::move(event->json));
     }
 }
 } // namespace
 
 int main()
 {
-    simdjson::ondemand::parser parser;
-    sway::ipc ipc(parser, false);
-    auto connect_result = ipc.connect();
+    sway::event_loop loop;
+    sway::async_ipc ipc(loop);
+    std::expected<void, sway::error_desc> connect_result = ipc.connect();
     if (!connect_result.has_value())
     {
         print_error(connect_result.error());
         return connect_result.error().error_code;
     }
 
-    // not subscribing to shutdown, because expecting that waybar subscribed to it instead
-    std::vector<sway::event_type> events = {sway::event_type::mode};
-
-    sway::ipc::subscribe_result subscribe_result = ipc.subscribe(events, event_callback, true);
-
-    if (!subscribe_result.subscription_successful)
+    mode_state state{ipc, loop};
+    sway::spawn(watch_modes(state));
+    // subscription could fail before the first await, and loop would never be stopped
+    std::expected<void, sway::error_desc> run_result;
+    if (!state.error.has_value())
     {
-        std::println(stderr, "[ModeTracker] [Error] sway returned success false in subscription response");
-        return -10;
+        run_result = loop.run();
     }
-
-    if (subscribe_result.error.has_value())
+    if (!run_result.has_value())
     {
-        print_error(subscribe_result.error.value());
-        return subscribe_result.error->error_code;
+        print_error(run_result.error());
+        return run_result.error().error_code;
     }
-
-    auto disconnect_result = ipc.disconnect();
-    if (!disconnect_result.has_value())
+    else if (state.error.has_value())
     {
-        print_error(disconnect_result.error());
-        return disconnect_result.error().error_code;
+        print_error(state.error.value());
+        return state.error->error_code;
     }
 }
-
@@ -0,0 +1,159 @@
+#include "placement_handler.hpp"
+#include <algorithm>
+#include <format>
+#include <print>
+
+namespace placement
+{
+void placement_handler::place(const sway::query_match& match, size_t rule_index)
+{
+    rule& placed = rules[rule_index];
+    if (commands.empty())
+    {
+        first_handled = std::chrono::steady_clock::now();
+    }
+    commands.push_back(std::format("[con_id={}] {}", match.id, placed.command));
+    applied.emplace_back(match.id, rule_index);
+    placed.used = true;
+}
+
+bool placement_handler::flush()
+{
+    if (commands.empty())
+    {
+        return true;
+    }
+
+    // sway reads criteria only at the start of command separated by semicolon. After comma it would
+    // be taken as the next action of the previous window
+    payload.clear();
+    for (const std::string& command : commands)
+    {
+        if (!payload.empty())
+        {
+            payload += ';';
+        }
+        payload += command;
+    }
+
+    std::expected<std::pmr::vector<std::expected<void, sway::ipc::run_error>>, sway::error_desc> run_result =
+        ipc.run_commands(std::string_view(payload));
+    const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - first_handled);
+    if (!run_result.has_value())
+    {
+        error = std::move(run_result.error());
+        return false;
+    }
+
+    // sway answers each comma separated part, actions of rule included, so failures are matched
+    // to commands only by count
+    const size_t failures = static_cast<size_t>(std::ranges::count_if(run_result.value(),
+        [](const std::expected<void, sway::ipc::run_error>& result) { return !result.has_value(); }));
+    failed += failures;
+    if (failures != 0 || verbose)
+    {
+        for (const std::string& command : commands)
+        {
+            std::println(stderr, "[Placement] {} {} in {}", failures != 0 ? "[Error] one of" : "placed", command,
+                latency);
+        }
+        for (const std::expected<void, sway::ipc::run_error>& result : run_result.value())
+        {
+            if (!result.has_value())
+            {
+                std::println(stderr, "[Placement] [Error] {}", result.error().error);
+            }
+        }
+    }
+    commands.clear();
+    return true;
+}
+
+bool placement_handler::operator()(sway::event_tag<sway::event_type::window>, sway::ipc::event_payload& event)
+{
+    std::string_view change;
+    int64_t id = 0;
+    simdjson::error_code json_error = event.json.find_field("change").get_string().get(change);
+    if (json_error == simdjson::error_code::SUCCESS)
+    {
+        json_error = event.json.find_field("container").find_field("id").get_int64().get(id);
+    }
+    if (json_error != simdjson::error_code::SUCCESS)
+    {
+        error = sway::error_desc(json_error, sway::error_desc::operation::decode_json);
+        return true;
+    }
+
+    if (change == "close")
+    {
+        std::erase_if(applied, [id](const std::pair<int64_t, size_t>& entry) { return entry.first == id; });
+    }
+    else
+    {
+        for (size_t i = 0; i < rules.size(); ++i)
+        {
+            if ((rules[i].once && rules[i].used) ||
+                std::ranges::find(applied, std::pair<int64_t, size_t>(id, i)) != applied.end())
+            {
+                continue;
+            }
+            std::expected<std::optional<sway::query_match>, sway::error_desc> match =
+                rules[i].criteria.match_window_event(event.json);
+            if (!match.has_value())
+            {
+                error = std::move(match.error());
+                return true;
+            }
+            else if (match->has_value())
+            {
+                place(match->value(), i);
+            }
+        }
+    }
+
+    return event.remaining_in_burst == 0 && !flush();
+}
+
+bool placement_handler::operator()(sway::event_tag<sway::event_type::shutdown>, sway::ipc::event_payload&)
+{
+    shutdown = true;
+    return true;
+}
+
+bool placement_handler::on_error(const sway::error_desc& subscription_error)
+{
+    error = subscription_error;
+    return true;
+}
+
+std::expected<void, sway::error_desc> place_existing(placement_handler& handler)
+{
+    sway::ipc::request_result tree = handler.ipc.get_tree();
+    if (!tree.has_value())
+    {
+        return std::unexpected(std::move(tree.error()));
+    }
+
+    for (size_t i = 0; i < handler.rules.size(); ++i)
+    {
+        // one pass of each rule over the same reply
+        tree->rewind();
+        std::expected<std::pmr::vector<sway::query_match>, sway::error_desc> matches = handler.rules[i].criteria.find(
+            tree.value(), handler.rules[i].once ? 1 : sway::query::no_limit, handler.ipc.reply_arena());
+        if (!matches.has_value())
+        {
+            return std::unexpected(std::move(matches.error()));
+        }
+        for (const sway::query_match& match : matches.value())
+        {
+            handler.place(match, i);
+        }
+    }
+    if (!handler.flush())
+    {
+        return std::unexpected(handler.error.value());
+    }
+    return {};
+}
+} // namespace placement
@@ -0,0 +1,55 @@
+#pragma once
+#include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/query.hpp>
+#include <chrono>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace placement
+{
+struct rule
+{
+    sway::query criteria;
+    std::string command;
+    bool once = false;
+    bool used = false;
+};
+
+// typed subscription handler of sway_placement_daemon. Matches window events against rules, and sends
+// moves for all windows of one burst as one message after its last event
+struct placement_handler
+{
+    sway::ipc& ipc;
+    std::vector<rule>& rules;
+    bool verbose = false;
+    // container and index of rule applied to it, forgotten when container closes
+    std::vector<std::pair<int64_t, size_t>> applied;
+    // commands of current burst, sent together after its last event
+    std::vector<std::string> commands;
+    // commands joined into one message, reused between bursts
+    std::string payload;
+    std::chrono::steady_clock::time_point first_handled;
+    // commands sway refused since start
+    size_t failed = 0;
+    std::optional<sway::error_desc> error;
+    bool shutdown = false;
+
+    static constexpr std::string_view placed_changes[] = {"new", "title", "close"};
+    static constexpr sway::event_filter event_filters[] = {{sway::event_type::window, placed_changes}};
+
+    void place(const sway::query_match& match, size_t rule_index);
+    // returns false if connection failed, error is saved in that case
+    bool flush();
+
+    bool operator()(sway::event_tag<sway::event_type::window>, sway::ipc::event_payload& event);
+    bool operator()(sway::event_tag<sway::event_type::shutdown>, sway::ipc::event_payload& event);
+    bool on_error(const sway::error_desc& subscription_error);
+};
+
+// windows mapped before subscription was open. Daemon is started by exec together with applications,
+// and nothing makes it subscribe before they map
+std::expected<void, sway::error_desc> place_existing(placement_handler& handler);
+} // namespace placement
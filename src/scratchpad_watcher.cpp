@@ -1,156 +1,91 @@
 #include <sway_ipc/sway_ipc.hpp>
+#include "bar/scratchpad_module.hpp"
 #include "print_error.hpp"
 #include "sway_ipc/events/event_type.hpp"
+#include "sway_ipc/events/events.hpp"
+#include "waybar_output.hpp"
+#include <optional>
 #include <print>
 
 namespace
 {
-template <typename F>
-simdjson::simdjson_result<simdjson::ondemand::value> find_if(simdjson::simdjson_result<simdjson::ondemand::array> array, F func)
+struct scratchpad_state
 {
-    if (array.error() != simdjson::error_code::SUCCESS)
+    sway::ipc& ipc;
+    // the same module as in sway_bar_daemon, watcher only feeds it and writes what it renders
+    bar::scratchpad_module module;
+    // writes only when json changed
+    waybar::output output;
+    // tree is fetched again by the next update: nothing is tracked yet, events could be missed,
+    // or event of burst could not be decoded
+    bool stale = true;
+    // error from query made inside callback, subscription is dropped when it is set
+    std::optional<sway::error_desc> error;
+};
+
+// returns false if query or write failed, error is saved in state in that case
+bool update_scratchpad_state(scratchpad_state& state)
+{
+    // get_tree is sent only if some event contradicted tracked scratchpad
+    std::expected<void, sway::error_desc> update_result = state.stale ?
+        state.module.refresh(state.ipc) : state.module.settle(state.ipc);
+    state.stale = false;
+    if (update_result.has_value())
     {
-        return array.error();
+        update_result = state.output.write(state.module.render());
     }
-    else
+    if (!update_result.has_value())
     {
-        return find_if(array.value_unsafe(), std::move(func));
+        state.error = std::move(update_result.error());
+        return false;
     }
+    return true;
 }
 
-template <typename F>
-simdjson::simdjson_result<simdjson::ondemand::value> find_if(simdjson::ondemand::array array, F func)
+// handler of typed subscription, which is made to window events only
+struct scratchpad_handler
 {
-    const simdjson::simdjson_result<simdjson::ondemand::array_iterator> begin_result = array.begin();
-    const simdjson::simdjson_result<simdjson::ondemand::array_iterator> end_result = array.end();
+    scratchpad_state& state;
 
-    const simdjson::error_code error = begin_result.error() != simdjson::error_code::SUCCESS ? begin_result.error() : end_result.error();
-    if (error != simdjson::error_code::SUCCESS)
-    {
-        return simdjson::simdjson_result<simdjson::ondemand::value>(error);
-    }
+    // changes which tracker acts on. New window is never in scratchpad, and hidden window gets focus
+    // before anything else can happen to it on workspace, so the rest is not even parsed
+    static constexpr std::string_view tracked_changes[] = {"move", "close", "focus", "title"};
+    static constexpr sway::event_filter event_filters[] = {{sway::event_type::window, tracked_changes}};
 
-    simdjson::ondemand::array_iterator it = begin_result.value_unsafe();
-    const simdjson::ondemand::array_iterator end = end_result.value_unsafe();
-
-    for (; it != end; ++it)
+    bool operator()(sway::event_tag<sway::event_type::window>, sway::ipc::event_payload& event)
     {
-        simdjson::simdjson_result<simdjson::ondemand::value> val = *it;
-        if (val.error() != simdjson::error_code::SUCCESS)
+        // subscription has its own connection, so it is not interrupted by get_tree.
+        // Events of a burst are applied one by one, and tracker is synced once, after the last one
+        std::expected<sway::window_event, sway::error_desc> window =
+            sway::decode_with<sway::window_event>(state.ipc.event_arena())(std::move(event.json));
+        if (window.has_value())
         {
-            continue;
+            state.module.on_event(bar::event(std::move(window.value())));
         }
-        if (func(val.value_unsafe()))
+        else
         {
-            return val;
+            std::println(stderr, "[ModeTracker] [Error] parsing error when parsing window event: {}",
+                window.error().describe());
+            state.stale = true;
         }
-    }
-    
-    return simdjson::error_code::NO_SUCH_FIELD;
-}
-
-std::expected<bool, sway::error_desc> is_scratchpad_empty(sway::ipc& ipc)
-{
-    sway::ipc::request_result get_tree_result = ipc.get_tree();
-    if (!get_tree_result.has_value())
-    {
-        return std::unexpected(std::move(get_tree_result.error()));
-    }
-
-    simdjson::simdjson_result<simdjson::ondemand::value> i3_root = find_if(get_tree_result->find_field("nodes").get_array(),
-        [](simdjson::ondemand::value val) -> bool
+        if (event.remaining_in_burst == 0)
         {
-            simdjson::simdjson_result<std::string_view> name_result = val.find_field("name").get_string();
-            return name_result.error() == simdjson::error_code::SUCCESS || name_result.value_unsafe() == "__i3";
-        });
-
-    simdjson::simdjson_result<simdjson::ondemand::value> i3_scratch = find_if(i3_root.find_field("nodes").get_array(),
-        [](simdjson::ondemand::value val) -> bool
-        {
-            simdjson::simdjson_result<std::string_view> name_result = val.find_field("name").get_string();
-            return name_result.error() == simdjson::error_code::SUCCESS || name_result.value_unsafe() == "__i3_scratch";
-        });
-        
-    simdjson::simdjson_result<simdjson::ondemand::value> floating_node = find_if(i3_scratch.find_field("floating_nodes").get_array(),
-        [](simdjson::ondemand::value)
-        {
-            return true;
-        });
-        
-    switch (floating_node.error())
-    {
-        case simdjson::error_code::NO_SUCH_FIELD:
-            return true;
-        case simdjson::error_code::SUCCESS:
-            return false;
-        default:
-            return std::unexpected(sway::error_desc(floating_node.error(), std::format("Simdjson error "
-                "while parsing json in get_tree: error_code {}", static_cast<int>(floating_node.error()))));
-    }
-}
-
-bool window_event_callback(simdjson::ondemand::document json)
-{
-    simdjson::simdjson_result<std::string_view> change = json.find_field("change").get_string();
-    if (change.error() != simdjson::error_code::SUCCESS)
-    {
-        std::println(stderr, "[ModeTracker] [Error] parsing error when parsing mode event: error code {}",
-            static_cast<int>(change.error()));
-        return false;
-    }
-    else if (change.value_unsafe() == "move")
-    {
-        return true;
-    }
-    else
-    {
+            return !update_scratchpad_state(state);
+        }
         return false;
     }
-}
 
-bool event_callback(sway::ipc::event_result event_result)
-{
-    if (!event_result.has_value())
+    bool on_error(const sway::error_desc& error)
     {
-        const sway::error_desc& error = event_result.error();
         if (error.error_source == sway::error_desc::error_source::posix ||
             error.error_source == sway::error_desc::error_source::invalid)
         {
             return true;
         }
-        else
-        {
-            std::println(stderr, "[ModeTracker] [Error] {}, error code: {}",
-                error.error_description, error.error_code);
-            return false;
-        }
-    }
-    switch (event_result->event_type)
-    {
-        case sway::event_type::window:
-            return window_event_callback(std::move(event_result->json));
-        case sway::event_type::shutdown:
-            return true;
-        default:
-            return false;
-    }
-}
-
-void put_stdout(bool scratchpad_empty)
-{
-    if (scratchpad_empty)
-    {
-        std::println("");
-        std::fflush(stdout);
-    }
-    else
-    {
-        // inside a special unicode character,
-        // that will be rendered by waybar as an arrow
-        std::println("");
-        std::fflush(stdout);
+        std::println(stderr, "[ModeTracker] [Error] {}", error.describe());
+        return false;
     }
-}
+};
 } // namespace
 
 int main()
@@ -165,21 +100,19 @@ int main()
     }
 
     // not subscribing to shutdown, because expecting that waybar subscribed to it instead
-    std::expected<bool, sway::error_desc> scratchpad_empty_result = is_scratchpad_empty(ipc);
-    if (!scratchpad_empty_result.has_value())
+    scratchpad_state state{ipc};
+    if (!update_scratchpad_state(state))
     {
-        print_error(scratchpad_empty_result.error());
-        return scratchpad_empty_result.error().error_code;
+        print_error(state.error.value());
+        return state.error->error_code;
     }
 
-    bool scratchpad_empty = scratchpad_empty_result.value();
-    put_stdout(scratchpad_empty);
-
-    std::vector<sway::event_type> events = {sway::event_type::window};
-
+    scratchpad_handler handler{state};
     while (true)
     {
-        sway::ipc::subscribe_result subscribe_result = ipc.subscribe(events, event_callback);
+        sway::ipc::subscribe_result subscribe_result = ipc.subscribe(handler,
+            // not collapse, every event is needed to track scratchpad
+            sway::coalesce_options{sway::coalesce_options::mode::batch, std::chrono::milliseconds(10)});
 
         if (subscribe_result.error.has_value())
         {
@@ -192,19 +125,18 @@ int main()
             // arbitrary error code 
             return -10;
         }
-
-        // mode just changed, check if scratchpad state changed too
-        scratchpad_empty_result = is_scratchpad_empty(ipc);
-        if (!scratchpad_empty_result.has_value())
+        else if (state.error.has_value())
         {
-            print_error(scratchpad_empty_result.error());
-            return scratchpad_empty_result.error().error_code;
+            print_error(state.error.value());
+            return state.error->error_code;
         }
 
-        if (scratchpad_empty_result.value() != scratchpad_empty)
+        // subscription was dropped because of connection error, events could be missed until resubscribe
+        state.stale = true;
+        if (!update_scratchpad_state(state))
         {
-            scratchpad_empty = scratchpad_empty_result.value();
-            put_stdout(scratchpad_empty);
+            print_error(state.error.value());
+            return state.error->error_code;
         }
     }
 
@@ -215,4 +147,3 @@ int main()
         return disconnect_result.error().error_code;
     }
 }
-
@@ -0,0 +1,508 @@
+#include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/event_loop.hpp>
+#include <sway_ipc/state_publisher.hpp>
+#include "bar/mode_module.hpp"
+#include "bar/module.hpp"
+#include "bar/module_output.hpp"
+#include "bar/scratchpad_module.hpp"
+#include "print_error.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <memory>
+#include <optional>
+#include <print>
+#include <variant>
+
+// one process for all custom waybar modules. Subscribes once to union of events of all modules,
+// parses every event once, and writes line to output of module only if its json changed.
+// Usage: sway_bar_daemon [--publish] [--stdout <module>] [module...]
+// Modules listed without --stdout write to fifos in bar::module_output::fifo_directory().
+// Without modules all modules are started with fifos.
+// With --publish daemon also keeps sway state in shared memory, see sway_ipc/shared_state.hpp
+
+namespace
+{
+std::unique_ptr<bar::module> make_module(std::string_view name)
+{
+    if (name == "mode")
+    {
+        return std::make_unique<bar::mode_module>();
+    }
+    else if (name == "scratchpad")
+    {
+        return std::make_unique<bar::scratchpad_module>();
+    }
+    return nullptr;
+}
+
+constexpr std::string_view all_modules[] = {"mode", "scratchpad"};
+
+// buffers grown by a big tree are shrunk, if there were no events for that long
+constexpr std::chrono::minutes shrink_interval(1);
+// fifo without reader is opened again that often. Reader of restarted waybar waits for it in open
+constexpr std::chrono::milliseconds reconnect_interval(500);
+
+constexpr sway::event_type publisher_events[] = {sway::event_type::workspace, sway::event_type::output,
+    sway::event_type::mode, sway::event_type::window};
+
+struct bar_module
+{
+    std::unique_ptr<bar::module> module;
+    bar::module_output output;
+    // got event in current burst, and should be settled after it
+    bool touched = false;
+    // fifo fd is in event loop, waiting for its reader to close it
+    bool watched = false;
+};
+
+struct daemon_state
+{
+    sway::ipc& ipc;
+    sway::event_loop& loop;
+    std::vector<bar_module>& modules;
+    // null without --publish
+    sway::state_publisher* publisher;
+    bool shutdown = false;
+    // no events since the last shrink timer
+    bool idle = true;
+    // runs while some output has not got its last line
+    std::optional<int> reconnect_timer;
+    // error from module or output, subscription is dropped when it is set
+    std::optional<sway::error_desc> error;
+    // error of subscription connection, daemon refreshes modules and subscribes again
+    std::optional<sway::error_desc> connection_error;
+};
+
+std::expected<void, sway::error_desc> write_outputs(std::vector<bar_module>& modules)
+{
+    for (bar_module& module : modules)
+    {
+        std::expected<void, sway::error_desc> write_result = module.output.write(module.module->render());
+        if (!write_result.has_value())
+        {
+            return write_result;
+        }
+    }
+    return {};
+}
+
+std::expected<void, sway::error_desc> refresh_modules(sway::ipc& ipc, std::vector<bar_module>& modules,
+    sway::state_publisher* publisher)
+{
+    if (publisher != nullptr)
+    {
+        std::expected<void, sway::error_desc> refresh_result = publisher->refresh(ipc);
+        if (!refresh_result.has_value())
+        {
+            return refresh_result;
+        }
+    }
+    for (bar_module& module : modules)
+    {
+        std::expected<void, sway::error_desc> refresh_result = module.module->refresh(ipc);
+        if (!refresh_result.has_value())
+        {
+            return refresh_result;
+        }
+        module.touched = false;
+    }
+    return write_outputs(modules);
+}
+
+template<typename T>
+std::optional<bar::event> decode_as(sway::ipc& ipc, sway::event_type event_type, simdjson::ondemand::document json)
+{
+    // event lives only until callback returns, as its arena
+    std::expected<T, sway::error_desc> event = sway::decode_with<T>(ipc.event_arena())(std::move(json));
+    if (!event.has_value())
+    {
+        std::println(stderr, "[BarDaemon] [Error] parsing error when parsing {} event: {}",
+            sway::event_type_to_string(event_type), event.error().describe());
+        return std::nullopt;
+    }
+    return bar::event(std::move(event.value()));
+}
+
+std::optional<bar::event> decode_event(sway::ipc& ipc, sway::event_type event_type,
+    simdjson::ondemand::document json)
+{
+    switch (event_type)
+    {
+        case sway::event_type::workspace:
+            return decode_as<sway::workspace_event>(ipc, event_type, std::move(json));
+        case sway::event_type::output:
+            return decode_as<sway::output_event>(ipc, event_type, std::move(json));
+        case sway::event_type::mode:
+            return decode_as<sway::mode_event>(ipc, event_type, std::move(json));
+        case sway::event_type::window:
+            return decode_as<sway::window_event>(ipc, event_type, std::move(json));
+        case sway::event_type::tick:
+            return decode_as<sway::tick_event>(ipc, event_type, std::move(json));
+        default:
+            return std::nullopt;
+    }
+}
+
+// watches fifos which got reader for its hangup, and keeps reconnect timer running
+// while some output has not got its last line
+std::expected<void, sway::error_desc> sync_outputs(daemon_state& state)
+{
+    bool behind = false;
+    for (bar_module& module : state.modules)
+    {
+        behind = behind || module.output.behind();
+        const int fd = module.output.fifo_fd();
+        if (fd == -1 || module.watched)
+        {
+            continue;
+        }
+        // no events asked, epoll reports EPOLLERR anyway, when the last reader closes fifo
+        std::expected<void, sway::error_desc> add_result = state.loop.add_fd(fd, [&state, &module, fd](uint32_t)
+        {
+            std::expected<void, sway::error_desc> remove_result = state.loop.remove_fd(fd);
+            module.output.disconnect();
+            module.watched = false;
+            if (remove_result.has_value())
+            {
+                remove_result = sync_outputs(state);
+            }
+            if (!remove_result.has_value())
+            {
+                state.error = std::move(remove_result.error());
+                state.loop.stop();
+            }
+        }, 0);
+        if (!add_result.has_value())
+        {
+            return add_result;
+        }
+        module.watched = true;
+    }
+
+    if (behind && !state.reconnect_timer.has_value())
+    {
+        std::expected<int, sway::error_desc> timer_result = state.loop.add_timer(reconnect_interval, [&state]()
+        {
+            std::expected<void, sway::error_desc> reconnect_result;
+            for (bar_module& module : state.modules)
+            {
+                reconnect_result = module.output.reconnect();
+                if (!reconnect_result.has_value())
+                {
+                    break;
+                }
+            }
+            if (reconnect_result.has_value())
+            {
+                reconnect_result = sync_outputs(state);
+            }
+            if (!reconnect_result.has_value())
+            {
+                state.error = std::move(reconnect_result.error());
+                state.loop.stop();
+            }
+        });
+        if (!timer_result.has_value())
+        {
+            return std::unexpected(std::move(timer_result.error()));
+        }
+        state.reconnect_timer = timer_result.value();
+    }
+    else if (!behind && state.reconnect_timer.has_value())
+    {
+        std::expected<void, sway::error_desc> remove_result = state.loop.remove_timer(state.reconnect_timer.value());
+        state.reconnect_timer.reset();
+        return remove_result;
+    }
+    return {};
+}
+
+// settles modules which got events, and writes outputs. Returns false on error, which is saved in state
+bool settle_modules(daemon_state& state)
+{
+    if (state.publisher != nullptr)
+    {
+        std::expected<void, sway::error_desc> settle_result = state.publisher->settle(state.ipc);
+        if (!settle_result.has_value())
+        {
+            state.error = std::move(settle_result.error());
+            return false;
+        }
+    }
+    for (bar_module& module : state.modules)
+    {
+        if (!module.touched)
+        {
+            continue;
+        }
+        module.touched = false;
+        std::expected<void, sway::error_desc> settle_result = module.module->settle(state.ipc);
+        if (!settle_result.has_value())
+        {
+            state.error = std::move(settle_result.error());
+            return false;
+        }
+    }
+
+    std::expected<void, sway::error_desc> write_result = write_outputs(state.modules).and_then([&state]()
+    {
+        return sync_outputs(state);
+    });
+    if (!write_result.has_value())
+    {
+        state.error = std::move(write_result.error());
+        return false;
+    }
+    return true;
+}
+
+bool event_callback(daemon_state& state, sway::ipc::event_result event_result)
+{
+    if (!event_result.has_value())
+    {
+        const sway::error_desc& error = event_result.error();
+        if (error.error_source == sway::error_desc::error_source::posix ||
+            error.error_source == sway::error_desc::error_source::invalid)
+        {
+            state.connection_error = error;
+            state.loop.stop();
+            return true;
+        }
+        else
+        {
+            std::println(stderr, "[BarDaemon] [Error] {}", error.describe());
+            return false;
+        }
+    }
+
+    if (event_result->event_type == sway::event_type::shutdown)
+    {
+        state.shutdown = true;
+        state.loop.stop();
+        return true;
+    }
+
+    state.idle = false;
+    const sway::event_type event_type = event_result->event_type;
+    const size_t remaining_in_burst = event_result->remaining_in_burst;
+    std::optional<bar::event> event = decode_event(state.ipc, event_type, std::move(event_result->json));
+    if (event.has_value())
+    {
+        for (bar_module& module : state.modules)
+        {
+            if (std::ranges::find(module.module->events(), event_type) != module.module->events().end())
+            {
+                module.module->on_event(event.value());
+                module.touched = true;
+            }
+        }
+        if (state.publisher != nullptr)
+        {
+            std::visit([&state](const auto& event)
+            {
+                if constexpr (requires { state.publisher->apply(event); })
+                {
+                    state.publisher->apply(event);
+                }
+            }, event.value());
+        }
+    }
+
+    // requests of modules are made once per burst, after its last event
+    if (remaining_in_burst == 0 && !settle_modules(state))
+    {
+        state.loop.stop();
+        return true;
+    }
+    return false;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    // waybar could close reading end of stdout at any time, write should fail instead of killing daemon
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::vector<bar_module> modules;
+    std::optional<sway::state_publisher> publisher;
+    auto add_module = [&modules](std::string_view name, bool to_stdout) -> bool
+    {
+        std::unique_ptr<bar::module> module = make_module(name);
+        if (module == nullptr)
+        {
+            std::println(stderr, "[BarDaemon] [Error] unknown module {}", name);
+            return false;
+        }
+        if (to_stdout)
+        {
+            modules.push_back(bar_module{std::move(module), bar::module_output()});
+            return true;
+        }
+        std::expected<bar::module_output, sway::error_desc> output = bar::module_output::open_fifo(name);
+        if (!output.has_value())
+        {
+            print_error(output.error());
+            return false;
+        }
+        modules.push_back(bar_module{std::move(module), std::move(output.value())});
+        return true;
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--publish")
+        {
+            std::expected<sway::state_publisher, sway::error_desc> opened = sway::state_publisher::open();
+            if (!opened.has_value())
+            {
+                print_error(opened.error());
+                return -1;
+            }
+            publisher.emplace(std::move(opened.value()));
+            continue;
+        }
+        const bool to_stdout = arg == "--stdout";
+        if (to_stdout && ++i == argc)
+        {
+            std::println(stderr, "[BarDaemon] [Error] --stdout requires module name");
+            return -1;
+        }
+        if (!add_module(argv[i], to_stdout))
+        {
+            return -1;
+        }
+    }
+    if (modules.empty())
+    {
+        for (std::string_view name : all_modules)
+        {
+            if (!add_module(name, false))
+            {
+                return -1;
+            }
+        }
+    }
+
+    // shutdown is needed to exit, because daemon is not started by waybar
+    std::vector<sway::event_type> events = {sway::event_type::shutdown};
+    for (const bar_module& module : modules)
+    {
+        std::ranges::copy(module.module->events(), std::back_inserter(events));
+    }
+    if (publisher.has_value())
+    {
+        std::ranges::copy(publisher_events, std::back_inserter(events));
+    }
+    std::ranges::sort(events);
+    events.erase(std::ranges::unique(events).begin(), events.end());
+
+    simdjson::ondemand::parser parser;
+    sway::ipc ipc(parser, false);
+    auto connect_result = ipc.connect();
+    if (!connect_result.has_value())
+    {
+        print_error(connect_result.error());
+        return connect_result.error().error_code;
+    }
+
+    sway::state_publisher* const publisher_ptr = publisher.has_value() ? &publisher.value() : nullptr;
+    std::expected<void, sway::error_desc> refresh_result = refresh_modules(ipc, modules, publisher_ptr);
+    if (!refresh_result.has_value())
+    {
+        print_error(refresh_result.error());
+        return refresh_result.error().error_code;
+    }
+
+    sway::event_loop loop;
+    daemon_state state{ipc, loop, modules, publisher_ptr};
+    std::expected<int, sway::error_desc> timer_result = loop.add_timer(shrink_interval, [&state]()
+    {
+        if (state.idle)
+        {
+            state.ipc.shrink_buffers();
+        }
+        state.idle = true;
+    });
+    if (!timer_result.has_value())
+    {
+        print_error(timer_result.error());
+        return timer_result.error().error_code;
+    }
+    while (true)
+    {
+        // outputs were written by refresh, without loop
+        std::expected<void, sway::error_desc> sync_result = sync_outputs(state);
+        if (!sync_result.has_value())
+        {
+            print_error(sync_result.error());
+            return sync_result.error().error_code;
+        }
+
+        sway::ipc::subscribe_result subscribe_result = ipc.subscribe_nonblocking(events,
+            [&state](sway::ipc::event_result event_result)
+            {
+                return event_callback(state, std::move(event_result));
+            },
+            // not collapse, every event is needed by modules which patch cached state
+            sway::coalesce_options{sway::coalesce_options::mode::batch, std::chrono::milliseconds(10)});
+
+        if (subscribe_result.error.has_value())
+        {
+            print_error(subscribe_result.error.value());
+            return subscribe_result.error->error_code;
+        }
+        else if (!subscribe_result.subscription_successful)
+        {
+            std::println(stderr, "[BarDaemon] [Error] sway returned success false in subscription response");
+            // arbitrary error code
+            return -10;
+        }
+
+        std::expected<void, sway::error_desc> add_result = loop.add_ipc(ipc, [&state](sway::error_desc error)
+        {
+            state.connection_error = std::move(error);
+            state.loop.stop();
+        });
+        if (!add_result.has_value())
+        {
+            print_error(add_result.error());
+            return add_result.error().error_code;
+        }
+
+        // subscription could be dropped already, by events dispatched inside add_ipc
+        if (ipc.subscribed())
+        {
+            std::expected<void, sway::error_desc> run_result = loop.run();
+            if (!run_result.has_value())
+            {
+                print_error(run_result.error());
+                return run_result.error().error_code;
+            }
+        }
+
+        if (state.shutdown)
+        {
+            return 0;
+        }
+        else if (state.error.has_value())
+        {
+            print_error(state.error.value());
+            return state.error->error_code;
+        }
+
+        // events could be missed until resubscribe
+        if (state.connection_error.has_value())
+        {
+            print_error(state.connection_error.value());
+            state.connection_error.reset();
+        }
+        refresh_result = refresh_modules(ipc, modules, publisher_ptr);
+        if (!refresh_result.has_value())
+        {
+            print_error(refresh_result.error());
+            return refresh_result.error().error_code;
+        }
+    }
+}
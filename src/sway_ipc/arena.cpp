@@ -0,0 +1,57 @@
+#include <sway_ipc/arena.hpp>
+#include <algorithm>
+
+namespace sway
+{
+void arena::reset()
+{
+    _used = 0;
+    if (_blocks.size() <= 1)
+    {
+        return;
+    }
+    const size_t size = capacity();
+    _blocks.clear();
+    add_block(size);
+}
+
+size_t arena::capacity() const
+{
+    size_t size = 0;
+    for (const block& block : _blocks)
+    {
+        size += block.size;
+    }
+    return size;
+}
+
+void* arena::do_allocate(size_t bytes, size_t alignment)
+{
+    if (!_blocks.empty())
+    {
+        block& last = _blocks.back();
+        void* pointer = last.data.get() + _used;
+        size_t space = last.size - _used;
+        if (std::align(alignment, bytes, pointer, space) != nullptr)
+        {
+            _used = static_cast<std::byte*>(pointer) - last.data.get() + bytes;
+            return pointer;
+        }
+    }
+
+    // blocks grow geometrically, so big message takes few of them, and reset merges them anyway
+    const size_t previous = _blocks.empty() ? _initial_size / 2 : _blocks.back().size;
+    add_block(std::max(previous * 2, bytes + alignment));
+    void* pointer = _blocks.back().data.get();
+    size_t space = _blocks.back().size;
+    std::align(alignment, bytes, pointer, space);
+    _used = static_cast<std::byte*>(pointer) - _blocks.back().data.get() + bytes;
+    return pointer;
+}
+
+void arena::add_block(size_t size)
+{
+    _blocks.push_back(block{std::make_unique_for_overwrite<std::byte[]>(size), size});
+    _used = 0;
+}
+} // namespace sway
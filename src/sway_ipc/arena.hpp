@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace sway
+{
+// monotonic memory for objects which live as long as one message (decoded replies and events,
+// results of run_commands). Allocation is a pointer bump, deallocation does nothing, and
+// everything is freed at once by reset. Unlike std::pmr::monotonic_buffer_resource, memory is
+// kept after reset, so after the biggest message was seen once, messages do not touch the heap
+class arena : public std::pmr::memory_resource
+{
+public:
+    explicit arena(size_t initial_size = 4096) : _initial_size(initial_size) {}
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    // everything allocated before is invalid after reset. If message did not fit into one block,
+    // blocks are replaced by one, big enough for all of them
+    void reset();
+    // bytes in all blocks
+    size_t capacity() const;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    struct block
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    void add_block(size_t size);
+
+    size_t _initial_size;
+    // only the last block is allocated from, others are full
+    std::vector<block> _blocks;
+    size_t _used = 0;
+};
+} // namespace sway
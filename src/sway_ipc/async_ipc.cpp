@@ -0,0 +1,510 @@
+#include <sway_ipc/async_ipc.hpp>
+#include <sway_ipc/socket.hpp>
+#include <cstring>
+#include <format>
+#include <print>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace
+{
+std::expected<void, sway::error_desc> set_nonblocking(int fd)
+{
+    const int flags = ::fcntl(fd, F_GETFL);
+    if (flags == -1 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        return std::unexpected(sway::error_desc(sway::error_desc::operation::make_nonblocking));
+    }
+    return {};
+}
+
+void append_message(std::string& out, sway::payload_type payload_type, std::string_view payload)
+{
+    sway::message_header header;
+    header.length = payload.size();
+    header.payload_type = payload_type;
+    // header on the wire starts from magic
+    out.append(header.magic, sway::header_size);
+    out.append(payload);
+}
+
+std::string subscribe_payload(const std::vector<sway::event_type>& events)
+{
+    std::string payload = "[";
+    for (sway::event_type event : events)
+    {
+        if (payload.size() > 1)
+        {
+            payload += ',';
+        }
+        std::format_to(std::back_inserter(payload), "\"{}\"", sway::event_type_to_string(event));
+    }
+    payload += ']';
+    return payload;
+}
+} // namespace
+
+namespace sway
+{
+async_ipc::request_awaiter::request_awaiter(async_ipc& ipc, payload_type payload_type, std::string_view payload)
+    : _ipc(ipc)
+    , _payload_type(payload_type)
+    , _payload(payload)
+{
+}
+
+bool async_ipc::request_awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    if (!_ipc._query_fd)
+    {
+        _result.emplace(std::unexpected(error_desc(error_desc::invalid_error_code::connection_closed,
+            error_desc::operation::request_without_connection)));
+        return false;
+    }
+
+    append_message(_ipc._pending_write, _payload_type, _payload);
+    std::expected<void, error_desc> flush_result = _ipc.flush_writes();
+    if (!flush_result.has_value())
+    {
+        _result.emplace(std::unexpected(std::move(flush_result.error())));
+        return false;
+    }
+
+    _handle = handle;
+    _ipc._pending_requests.push_back(this);
+    return true;
+}
+
+bool async_ipc::event_awaiter::await_ready()
+{
+    if (_ipc._event_error.has_value())
+    {
+        _frame.emplace(std::unexpected(_ipc._event_error.value()));
+        return true;
+    }
+
+    std::expected<std::optional<frame>, error_desc> frame_result = _ipc._event_frames.next_frame();
+    if (!frame_result.has_value())
+    {
+        _frame.emplace(std::unexpected(std::move(frame_result.error())));
+        return true;
+    }
+    else if (frame_result->has_value())
+    {
+        _frame.emplace(frame_result->value());
+        return true;
+    }
+    return false;
+}
+
+bool async_ipc::event_awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    if (!_ipc._event_fd)
+    {
+        _frame.emplace(std::unexpected(error_desc(error_desc::invalid_error_code::connection_closed,
+            error_desc::operation::event_without_subscription)));
+        return false;
+    }
+
+    std::expected<void, error_desc> modify_result = _ipc._loop.modify_fd(_ipc._event_fd, EPOLLIN);
+    if (!modify_result.has_value())
+    {
+        _frame.emplace(std::unexpected(std::move(modify_result.error())));
+        return false;
+    }
+
+    _handle = handle;
+    _ipc._event_waiter = this;
+    return true;
+}
+
+async_ipc::event_result async_ipc::event_awaiter::await_resume()
+{
+    if (!_frame->has_value())
+    {
+        return std::unexpected(std::move(_frame->error()));
+    }
+
+    const frame& event_frame = _frame->value();
+    return parse_payload(_ipc._event_parser, event_frame.payload, event_frame.length)
+        .transform([&event_frame](simdjson::ondemand::document json)
+        {
+            return event_payload{sway::event_type(event_frame.payload_type), std::move(json)};
+        });
+}
+
+async_ipc::async_ipc(event_loop& loop, bool print_errors_on_destroy /*= false*/)
+    : _loop(loop)
+    , _print_errors_on_destroy(print_errors_on_destroy)
+{
+}
+
+async_ipc::~async_ipc()
+{
+    close_fd(_event_fd);
+    close_fd(_query_fd);
+}
+
+void async_ipc::close_fd(int& fd)
+{
+    if (!fd)
+    {
+        return;
+    }
+
+    // fd is going to be closed, epoll will forget it anyway
+    (void)_loop.remove_fd(fd);
+    if (::close(fd) && _print_errors_on_destroy)
+    {
+        std::println(stderr, "[sway::async_ipc] Error encountered when closing socket "
+            "error code {}: {}", errno, strerror(errno));
+    }
+    fd = 0;
+}
+
+std::expected<void, error_desc> async_ipc::connect()
+{
+    if (!_socket_path.empty())
+    {
+        return connect(_socket_path);
+    }
+
+    return find_socket_path().and_then([this](std::string socket_path)
+    {
+        return this->connect(socket_path);
+    });
+}
+
+std::expected<void, error_desc> async_ipc::connect(std::string_view socket_path)
+{
+    if (socket_path.data() != _socket_path.data())
+    {
+        _socket_path = socket_path;
+    }
+
+    close_fd(_query_fd);
+    _query_frames.clear();
+    _pending_write.clear();
+
+    return open_socket(socket_path).and_then([this](int sock_fd) -> std::expected<void, error_desc>
+    {
+        _query_fd = sock_fd;
+        return set_nonblocking(sock_fd).and_then([this]()
+        {
+            return _loop.add_fd(_query_fd, [this](uint32_t events) { on_query_ready(events); });
+        }).or_else([this](error_desc error) -> std::expected<void, error_desc>
+        {
+            close_fd(_query_fd);
+            return std::unexpected(std::move(error));
+        });
+    });
+}
+
+std::expected<void, error_desc> async_ipc::disconnect()
+{
+    fail_requests(error_desc(error_desc::invalid_error_code::connection_closed,
+        error_desc::operation::wait_reply));
+    return {};
+}
+
+std::expected<void, error_desc> async_ipc::flush_writes()
+{
+    size_t written = 0;
+    while (written < _pending_write.size())
+    {
+        const ssize_t result = ::write(_query_fd, _pending_write.data() + written, _pending_write.size() - written);
+        if (result == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            else if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            return std::unexpected(error_desc(error_desc::operation::write_request));
+        }
+        written += result;
+    }
+    _pending_write.erase(0, written);
+
+    // wait for socket to become writable only while there is something to write
+    return _loop.modify_fd(_query_fd, _pending_write.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT);
+}
+
+void async_ipc::fail_requests(const error_desc& error)
+{
+    close_fd(_query_fd);
+    _query_frames.clear();
+    _pending_write.clear();
+
+    std::deque<request_awaiter*> pending = std::move(_pending_requests);
+    _pending_requests.clear();
+    for (request_awaiter* awaiter : pending)
+    {
+        awaiter->_result.emplace(std::unexpected(error));
+        awaiter->_handle.resume();
+    }
+}
+
+void async_ipc::on_query_ready(uint32_t events)
+{
+    if (events & EPOLLOUT)
+    {
+        std::expected<void, error_desc> flush_result = flush_writes();
+        if (!flush_result.has_value())
+        {
+            fail_requests(flush_result.error());
+            return;
+        }
+    }
+
+    if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+    {
+        return;
+    }
+
+    while (_query_fd)
+    {
+        std::expected<size_t, error_desc> fill_result = _query_frames.fill(_query_fd);
+        if (!fill_result.has_value())
+        {
+            fail_requests(fill_result.error());
+            return;
+        }
+
+        while (true)
+        {
+            std::expected<std::optional<frame>, error_desc> frame_result = _query_frames.next_frame();
+            if (!frame_result.has_value())
+            {
+                fail_requests(frame_result.error());
+                return;
+            }
+            else if (!frame_result->has_value())
+            {
+                break;
+            }
+
+            // reply without request, nobody to give it to
+            if (_pending_requests.empty())
+            {
+                continue;
+            }
+
+            request_awaiter* awaiter = _pending_requests.front();
+            _pending_requests.pop_front();
+            const frame& reply = frame_result->value();
+            awaiter->_result.emplace(parse_payload(_query_parser, reply.payload, reply.length));
+            // coroutine runs until its next suspension, possibly sending more requests
+            awaiter->_handle.resume();
+        }
+
+        if (fill_result.value() == 0)
+        {
+            break;
+        }
+    }
+}
+
+async_ipc::request_awaiter async_ipc::request(payload_type payload_type, std::string_view payload)
+{
+    return request_awaiter(*this, payload_type, payload);
+}
+
+async_ipc::request_awaiter async_ipc::run_commands(std::string_view commands)
+{
+    return request(payload_type::run_command, commands);
+}
+
+async_ipc::request_awaiter async_ipc::get_workspaces()
+{
+    return request(payload_type::get_workspaces);
+}
+
+async_ipc::request_awaiter async_ipc::get_outputs()
+{
+    return request(payload_type::get_outputs);
+}
+
+async_ipc::request_awaiter async_ipc::get_tree()
+{
+    return request(payload_type::get_tree);
+}
+
+async_ipc::request_awaiter async_ipc::get_marks()
+{
+    return request(payload_type::get_marks);
+}
+
+async_ipc::request_awaiter async_ipc::get_bar_config(std::string_view bar_id)
+{
+    return request(payload_type::get_bar_config, bar_id);
+}
+
+async_ipc::request_awaiter async_ipc::get_version()
+{
+    return request(payload_type::get_version);
+}
+
+async_ipc::request_awaiter async_ipc::get_binding_modes()
+{
+    return request(payload_type::get_binding_modes);
+}
+
+async_ipc::request_awaiter async_ipc::get_config()
+{
+    return request(payload_type::get_config);
+}
+
+async_ipc::request_awaiter async_ipc::send_tick(std::string_view payload)
+{
+    return request(payload_type::send_tick, payload);
+}
+
+async_ipc::request_awaiter async_ipc::get_binding_state()
+{
+    return request(payload_type::get_binding_state);
+}
+
+async_ipc::request_awaiter async_ipc::get_inputs()
+{
+    return request(payload_type::get_inputs);
+}
+
+async_ipc::request_awaiter async_ipc::get_seats()
+{
+    return request(payload_type::get_seats);
+}
+
+//=================================================================================================================
+task<std::expected<void, error_desc>> async_ipc::subscribe(std::vector<event_type> events)
+{
+    if (_socket_path.empty())
+    {
+        std::expected<std::string, error_desc> path_result = find_socket_path();
+        if (!path_result.has_value())
+        {
+            co_return std::unexpected(std::move(path_result.error()));
+        }
+        _socket_path = std::move(path_result.value());
+    }
+
+    close_fd(_event_fd);
+    _event_frames.clear();
+    _event_error.reset();
+
+    std::expected<int, error_desc> open_result = open_socket(_socket_path);
+    if (!open_result.has_value())
+    {
+        co_return std::unexpected(std::move(open_result.error()));
+    }
+    _event_fd = open_result.value();
+
+    std::string message;
+    append_message(message, payload_type::subscribe, subscribe_payload(events));
+    // socket is still blocking, and subscribe message is small anyway
+    for (size_t written = 0; written < message.size();)
+    {
+        const ssize_t result = ::write(_event_fd, message.data() + written, message.size() - written);
+        if (result == -1 && errno != EINTR)
+        {
+            error_desc error(error_desc::operation::write_request);
+            close_fd(_event_fd);
+            co_return std::unexpected(std::move(error));
+        }
+        written += result == -1 ? 0 : result;
+    }
+
+    // nobody waits for events yet, so socket is not polled until next_event is awaited
+    std::expected<void, error_desc> add_result = set_nonblocking(_event_fd).and_then([this]()
+    {
+        return _loop.add_fd(_event_fd, [this](uint32_t events) { on_event_ready(events); }, 0);
+    });
+    if (!add_result.has_value())
+    {
+        close_fd(_event_fd);
+        co_return std::unexpected(std::move(add_result.error()));
+    }
+
+    // first message on the connection is reply to subscription
+    event_result reply = co_await next_event();
+    if (!reply.has_value())
+    {
+        close_fd(_event_fd);
+        co_return std::unexpected(std::move(reply.error()));
+    }
+
+    simdjson::simdjson_result<bool> success = reply->json.find_field("success").get_bool();
+    if (success.error() != simdjson::error_code::SUCCESS)
+    {
+        close_fd(_event_fd);
+        co_return std::unexpected(error_desc(success.error(),
+            error_desc::operation::parse_subscribe_reply));
+    }
+    else if (!success.value_unsafe())
+    {
+        close_fd(_event_fd);
+        co_return std::unexpected(error_desc(0, error_desc::operation::subscribe_refused));
+    }
+    co_return std::expected<void, error_desc>{};
+}
+
+async_ipc::event_awaiter async_ipc::next_event()
+{
+    return event_awaiter(*this);
+}
+
+std::expected<void, error_desc> async_ipc::unsubscribe()
+{
+    close_fd(_event_fd);
+    _event_frames.clear();
+    return {};
+}
+
+void async_ipc::on_event_ready(uint32_t events)
+{
+    event_awaiter* waiter = _event_waiter;
+    if (!waiter)
+    {
+        // hangup is reported even when nothing is polled, remember it for the next waiter
+        if (events & (EPOLLHUP | EPOLLERR))
+        {
+            _event_error = error_desc(error_desc::invalid_error_code::connection_closed, error_desc::operation::wait_events);
+            close_fd(_event_fd);
+        }
+        return;
+    }
+
+    std::expected<size_t, error_desc> fill_result = _event_frames.fill(_event_fd);
+    std::expected<std::optional<frame>, error_desc> frame_result = fill_result.has_value() ?
+        _event_frames.next_frame() : std::unexpected(std::move(fill_result.error()));
+
+    if (frame_result.has_value())
+    {
+        if (!frame_result->has_value())
+        {
+            // only part of event arrived
+            return;
+        }
+        waiter->_frame.emplace(frame_result->value());
+    }
+    else
+    {
+        _event_error = frame_result.error();
+        waiter->_frame.emplace(std::unexpected(std::move(frame_result.error())));
+        close_fd(_event_fd);
+    }
+
+    _event_waiter = nullptr;
+    waiter->_handle.resume();
+
+    // nobody awaits next event, leave it in socket
+    if (!_event_waiter && _event_fd)
+    {
+        (void)_loop.modify_fd(_event_fd, 0);
+    }
+}
+} // namespace sway
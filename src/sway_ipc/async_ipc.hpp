@@ -0,0 +1,135 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <sway_ipc/event_loop.hpp>
+#include <sway_ipc/events/event_type.hpp>
+#include <sway_ipc/frame_buffer.hpp>
+#include <sway_ipc/message.hpp>
+#include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/task.hpp>
+#include <simdjson.h>
+#include <coroutine>
+#include <deque>
+#include <expected>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace sway
+{
+// coroutine version of sway::ipc, driven by sway::event_loop.
+// Requests can be awaited from many coroutines at once, they are pipelined over one
+// connection, and replies are handed to them in order, since sway answers in order.
+// Document returned by request is valid until next reply on the same connection is
+// parsed, so it should be consumed before awaiting anything else.
+// Object should outlive every coroutine awaiting it
+class async_ipc
+{
+public:
+    using request_result = ipc::request_result;
+    using event_payload = ipc::event_payload;
+    using event_result = ipc::event_result;
+
+    class request_awaiter
+    {
+    public:
+        request_awaiter(async_ipc& ipc, payload_type payload_type, std::string_view payload);
+
+        bool await_ready() const noexcept { return false; }
+        // request is sent here, so payload should live until request is awaited
+        bool await_suspend(std::coroutine_handle<> handle);
+        request_result await_resume() { return std::move(_result.value()); }
+
+    private:
+        friend class async_ipc;
+
+        async_ipc& _ipc;
+        payload_type _payload_type;
+        std::string_view _payload;
+        std::coroutine_handle<> _handle;
+        std::optional<request_result> _result;
+    };
+
+    class event_awaiter
+    {
+    public:
+        explicit event_awaiter(async_ipc& ipc) : _ipc(ipc) {}
+
+        // ready without suspending, if complete event is already buffered
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        event_result await_resume();
+
+    private:
+        friend class async_ipc;
+
+        async_ipc& _ipc;
+        std::coroutine_handle<> _handle;
+        std::optional<std::expected<frame, error_desc>> _frame;
+    };
+
+    async_ipc(event_loop& loop, bool print_errors_on_destroy = false);
+    ~async_ipc();
+
+    async_ipc(const async_ipc&) = delete;
+    async_ipc& operator=(const async_ipc&) = delete;
+
+    // connecting to unix socket does not block for long, so connect itself is not awaitable
+    std::expected<void, error_desc> connect();
+    std::expected<void, error_desc> connect(std::string_view socket_path);
+    std::expected<void, error_desc> disconnect();
+
+    //=================================================================================================================
+    request_awaiter request(payload_type payload_type, std::string_view payload = {});
+
+    // reply is the same array of results, sway::ipc::run_commands parses
+    request_awaiter run_commands(std::string_view commands);
+    request_awaiter get_workspaces();
+    request_awaiter get_outputs();
+    request_awaiter get_tree();
+    request_awaiter get_marks();
+    request_awaiter get_bar_config(std::string_view bar_id = {});
+    request_awaiter get_version();
+    request_awaiter get_binding_modes();
+    request_awaiter get_config();
+    request_awaiter send_tick(std::string_view payload);
+    request_awaiter get_binding_state();
+    request_awaiter get_inputs();
+    request_awaiter get_seats();
+
+    //=================================================================================================================
+    // opens separate connection for events, and waits for sway to confirm subscription
+    task<std::expected<void, error_desc>> subscribe(std::vector<event_type> events);
+
+    // awaiting it again and again works as async generator of events. Events are read
+    // from socket only while somebody awaits them, so slow consumer leaves them in socket
+    event_awaiter next_event();
+
+    bool subscribed() const { return _event_fd != 0; }
+    std::expected<void, error_desc> unsubscribe();
+
+private:
+    void on_query_ready(uint32_t events);
+    void on_event_ready(uint32_t events);
+    std::expected<void, error_desc> flush_writes();
+    // resumes every pending request with error, and closes query connection
+    void fail_requests(const error_desc& error);
+    void close_fd(int& fd);
+
+    event_loop& _loop;
+    bool _print_errors_on_destroy;
+    std::string _socket_path;
+
+    int _query_fd = 0;
+    frame_buffer _query_frames;
+    simdjson::ondemand::parser _query_parser;
+    // bytes socket did not accept yet, they are written when socket is writable
+    std::string _pending_write;
+    std::deque<request_awaiter*> _pending_requests;
+
+    int _event_fd = 0;
+    frame_buffer _event_frames;
+    simdjson::ondemand::parser _event_parser;
+    event_awaiter* _event_waiter = nullptr;
+    std::optional<error_desc> _event_error;
+};
+} // namespace sway
@@ -0,0 +1,312 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <simdjson.h>
+#include <concepts>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// decoding of sway json into plain structs. Struct is described by a table of its json
+// fields (see replies.hpp), and decoder walks object once, in the order sway wrote it,
+// matching each key against the table. Unknown fields are skipped, missing fields and
+// nulls keep default value. std::string_view fields point into parser, and are valid
+// until parser is used again, as any other document. std::pmr::vector fields are allocated
+// from memory resource given to decode (like arena of ipc), other containers use heap
+
+namespace sway
+{
+template <typename Class, typename Member>
+struct field
+{
+    std::string_view name;
+    Member Class::* member;
+};
+
+// specialize with std::tuple of fields to make struct decodable
+template <typename T>
+inline constexpr std::nullptr_t schema = nullptr;
+
+template <typename T>
+concept described = !std::same_as<std::remove_cvref_t<decltype(schema<T>)>, std::nullptr_t>;
+
+namespace detail
+{
+template <typename T>
+struct is_optional : std::false_type {};
+
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+struct is_vector : std::false_type {};
+
+template <typename T, typename Allocator>
+struct is_vector<std::vector<T, Allocator>> : std::true_type {};
+
+template <typename T>
+concept pmr_vector = is_vector<T>::value &&
+    std::same_as<typename T::allocator_type, std::pmr::polymorphic_allocator<typename T::value_type>>;
+
+template <typename T>
+simdjson::error_code decode_value(simdjson::ondemand::value value, T& out, std::pmr::memory_resource* resource);
+
+template <described T>
+simdjson::error_code decode_object(simdjson::ondemand::object object, T& out, std::pmr::memory_resource* resource)
+{
+    for (simdjson::simdjson_result<simdjson::ondemand::field> field_result : object)
+    {
+        simdjson::ondemand::field field;
+        simdjson::error_code error = std::move(field_result).get(field);
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return error;
+        }
+
+        // keys of sway have nothing to unescape, so raw key is compared as is
+        const simdjson::ondemand::raw_json_string key = field.key();
+        std::apply([&](const auto&... fields)
+        {
+            // stops at first matching field, value of unmatched key is skipped by iterator
+            (void)((key.unsafe_is_equal(fields.name) &&
+                (error = decode_value(field.value(), out.*fields.member, resource), true)) || ...);
+        }, schema<T>);
+
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return error;
+        }
+    }
+    return simdjson::error_code::SUCCESS;
+}
+
+template <typename T, typename F>
+simdjson::error_code decode_elements(simdjson::ondemand::array array, std::pmr::memory_resource* resource,
+    F&& function)
+{
+    for (simdjson::simdjson_result<simdjson::ondemand::value> element_result : array)
+    {
+        simdjson::ondemand::value element;
+        simdjson::error_code error = std::move(element_result).get(element);
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return error;
+        }
+
+        T decoded{};
+        error = decode_value(element, decoded, resource);
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return error;
+        }
+        function(std::move(decoded));
+    }
+    return simdjson::error_code::SUCCESS;
+}
+
+template <typename T>
+simdjson::error_code decode_value(simdjson::ondemand::value value, T& out, std::pmr::memory_resource* resource)
+{
+    bool null = false;
+    simdjson::error_code error = value.is_null().get(null);
+    if (error != simdjson::error_code::SUCCESS)
+    {
+        return error;
+    }
+    else if (null)
+    {
+        if constexpr (is_optional<T>::value)
+        {
+            out.reset();
+        }
+        return simdjson::error_code::SUCCESS;
+    }
+
+    if constexpr (is_optional<T>::value)
+    {
+        return decode_value(value, out.emplace(), resource);
+    }
+    else if constexpr (std::same_as<T, bool>)
+    {
+        return value.get_bool().get(out);
+    }
+    else if constexpr (std::integral<T> && std::is_signed_v<T>)
+    {
+        int64_t number;
+        error = value.get_int64().get(number);
+        out = static_cast<T>(number);
+        return error;
+    }
+    else if constexpr (std::integral<T>)
+    {
+        uint64_t number;
+        error = value.get_uint64().get(number);
+        out = static_cast<T>(number);
+        return error;
+    }
+    else if constexpr (std::floating_point<T>)
+    {
+        double number;
+        error = value.get_double().get(number);
+        out = static_cast<T>(number);
+        return error;
+    }
+    else if constexpr (std::same_as<T, std::string_view>)
+    {
+        return value.get_string().get(out);
+    }
+    else if constexpr (std::same_as<T, std::string>)
+    {
+        std::string_view string;
+        error = value.get_string().get(string);
+        out.assign(string);
+        return error;
+    }
+    else if constexpr (is_vector<T>::value)
+    {
+        simdjson::ondemand::array array;
+        error = value.get_array().get(array);
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return error;
+        }
+        if constexpr (pmr_vector<T>)
+        {
+            if (out.get_allocator().resource() != resource)
+            {
+                // pmr containers keep their allocator on assignment, so vector is constructed again
+                std::destroy_at(&out);
+                std::construct_at(&out, resource);
+            }
+        }
+        out.clear();
+        return decode_elements<typename T::value_type>(array, resource, [&out](typename T::value_type element)
+        {
+            out.push_back(std::move(element));
+        });
+    }
+    else
+    {
+        static_assert(described<T>, "type has no schema, and is not a supported json value");
+        simdjson::ondemand::object object;
+        error = value.get_object().get(object);
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return error;
+        }
+        return decode_object(object, out, resource);
+    }
+}
+
+inline error_desc decode_error(simdjson::error_code error)
+{
+    return error_desc(error, error_desc::operation::decode_json);
+}
+
+template <typename T>
+T make_value(std::pmr::memory_resource* resource)
+{
+    if constexpr (pmr_vector<T>)
+    {
+        return T(resource);
+    }
+    else
+    {
+        return T{};
+    }
+}
+
+template <typename T>
+std::expected<T, error_desc> decode_document(simdjson::ondemand::document document, std::pmr::memory_resource* resource)
+{
+    // root of document can not be taken as value, so it is opened here
+    T result = make_value<T>(resource);
+    simdjson::error_code error;
+    if constexpr (is_vector<T>::value)
+    {
+        simdjson::ondemand::array array;
+        error = document.get_array().get(array);
+        if (error == simdjson::error_code::SUCCESS)
+        {
+            error = decode_elements<typename T::value_type>(array, resource,
+                [&result](typename T::value_type element)
+                {
+                    result.push_back(std::move(element));
+                });
+        }
+    }
+    else
+    {
+        static_assert(described<T>, "only described struct or std::vector can be decoded from document");
+        simdjson::ondemand::object object;
+        error = document.get_object().get(object);
+        if (error == simdjson::error_code::SUCCESS)
+        {
+            error = decode_object(object, result, resource);
+        }
+    }
+
+    if (error != simdjson::error_code::SUCCESS)
+    {
+        return std::unexpected(decode_error(error));
+    }
+    return result;
+}
+} // namespace detail
+
+// T is described struct, or std::vector of them (like get_workspaces reply)
+template <typename T>
+std::expected<T, error_desc> decode_value(simdjson::ondemand::value value,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    T result = detail::make_value<T>(resource);
+    const simdjson::error_code error = detail::decode_value(value, result, resource);
+    if (error != simdjson::error_code::SUCCESS)
+    {
+        return std::unexpected(detail::decode_error(error));
+    }
+    return result;
+}
+
+// taken by value, so it can be used as ipc.get_tree().and_then(sway::decode<sway::node>)
+template <typename T>
+std::expected<T, error_desc> decode(simdjson::ondemand::document document)
+{
+    return detail::decode_document<T>(std::move(document), std::pmr::get_default_resource());
+}
+
+// same, but pmr vectors are allocated from resource:
+// ipc.get_tree().and_then(sway::decode_with<sway::node>(ipc.reply_arena()))
+template <typename T>
+auto decode_with(std::pmr::memory_resource* resource)
+{
+    return [resource](simdjson::ondemand::document document)
+    {
+        return detail::decode_document<T>(std::move(document), resource);
+    };
+}
+
+// decodes array elements one by one and passes them to function, without collecting them
+template <typename T, typename F>
+std::expected<void, error_desc> decode_each(simdjson::ondemand::document& document, F&& function,
+    std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+{
+    simdjson::ondemand::array array;
+    simdjson::error_code error = document.get_array().get(array);
+    if (error == simdjson::error_code::SUCCESS)
+    {
+        error = detail::decode_elements<T>(array, resource, std::forward<F>(function));
+    }
+    if (error != simdjson::error_code::SUCCESS)
+    {
+        return std::unexpected(detail::decode_error(error));
+    }
+    return {};
+}
+} // namespace sway
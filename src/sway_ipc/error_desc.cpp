@@ -0,0 +1,169 @@
+#include <sway_ipc/error_desc.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <format>
+
+namespace
+{
+std::string_view operation_message(sway::error_desc::operation what)
+{
+    using operation = sway::error_desc::operation;
+    switch (what)
+    {
+        case operation::start_get_socketpath:
+            return "Error trying to get socket path from sway. "
+                "Error can be encountered when sway is not installed, or not accessible from PATH";
+        case operation::read_get_socketpath: return "Reading socket path from sway failed";
+        case operation::wait_get_socketpath: return "Failed to get sway process status on pclose";
+        case operation::exit_get_socketpath: return "Sway closed with non zero exit code, when getting socket path";
+        case operation::check_socket_path: return "Path to sway socket was too long";
+        case operation::create_socket: return "Creation of sway socket failed";
+        case operation::connect_socket: return "Error encountered when connecting to sway socket";
+        case operation::close_socket: return "Error encountered when closing sway socket";
+        case operation::listen_socket: return "Failed to listen on socket";
+        case operation::make_nonblocking: return "Failed to make sway socket non-blocking";
+        case operation::write_request: return "Error when writing sway commands";
+        case operation::read_reply: return "Error when reading sway response";
+        case operation::read_header: return "Sway sent invalid message header";
+        case operation::allocate_parser: return "Error while allocating space for parsing response from sway";
+        case operation::parse_reply: return "Parsing error when receiving response from sway";
+        case operation::parse_subscribe_reply: return "Failed to parse response from sway, when attempting to subscribe to event(s)";
+        case operation::subscribe_refused: return "Sway returned success false in subscription response";
+        case operation::parse_tick_reply: return "Error parsing response from SEND_TICK";
+        case operation::parse_binding_state_reply: return "Error parsing response from GET_BINDING_STATE";
+        case operation::decode_json: return "Error while decoding sway json";
+        case operation::request_without_connection: return "Request sent without connection to sway";
+        case operation::event_without_subscription: return "Event awaited without subscription";
+        case operation::wait_reply: return "Connection to sway closed before reply arrived";
+        case operation::wait_events: return "Error when waiting for sway events";
+        case operation::create_epoll: return "Creation of epoll failed";
+        case operation::add_to_epoll: return "Failed to add fd to epoll";
+        case operation::remove_from_epoll: return "Failed to remove fd from epoll";
+        case operation::modify_epoll: return "Failed to modify epoll events of fd";
+        case operation::wait_epoll: return "epoll_wait failed";
+        case operation::create_timer: return "Creation of timer failed";
+        case operation::start_timer: return "Failed to start timer";
+        case operation::close_timer: return "Error encountered when closing timer";
+        case operation::create_eventfd: return "Creation of eventfd failed";
+        case operation::compile_query: return "Failed to compile criteria";
+        case operation::open_shared_memory: return "Opening of shared memory failed";
+        case operation::map_shared_memory: return "Mapping of shared memory failed";
+        case operation::event_barrier: return "Event barrier failed";
+        // message is captured
+        case operation::application: return "";
+    }
+    return "Unknown error";
+}
+
+std::string_view invalid_message(sway::error_desc::invalid_error_code error_code)
+{
+    using invalid_error_code = sway::error_desc::invalid_error_code;
+    switch (error_code)
+    {
+        case invalid_error_code::path_to_socket_too_long: return "path to socket too long";
+        case invalid_error_code::magic_string_was_wrong: return "magic string was wrong";
+        case invalid_error_code::negative_payload_length: return "negative payload length";
+        case invalid_error_code::connection_closed: return "connection closed";
+        case invalid_error_code::invalid_criteria: return "invalid criteria";
+        case invalid_error_code::unsupported_criteria: return "unsupported criteria";
+        case invalid_error_code::not_subscribed: return "not subscribed";
+    }
+    return "unknown";
+}
+} // namespace
+
+namespace sway
+{
+error_desc::error_desc(operation what, int64_t first, int64_t second)
+    : error_code(errno)
+    , error_source(error_desc::error_source::posix)
+    , what(what)
+    , arguments{first, second}
+{}
+
+error_desc::error_desc(int error, operation what)
+    : error_code(error)
+    , error_source(error_desc::error_source::sway)
+    , what(what)
+    , arguments{}
+{}
+
+error_desc::error_desc(error_desc::invalid_error_code error_code, operation what, int64_t first, int64_t second)
+    : error_code(static_cast<int>(error_code))
+    , error_source(error_desc::error_source::invalid)
+    , what(what)
+    , arguments{first, second}
+{}
+
+error_desc::error_desc(error_desc::invalid_error_code error_code, operation what, std::string_view bytes)
+    : error_desc(error_code, what)
+{
+    std::copy_n(bytes.data(), std::min(bytes.size(), sizeof(this->bytes)), this->bytes);
+}
+
+error_desc::error_desc(simdjson::error_code error_code, operation what)
+    : error_code(static_cast<int>(error_code))
+    , error_source(error_desc::error_source::parsing_error)
+    , what(what)
+    , arguments{}
+{}
+
+error_desc::error_desc(const char* message)
+    : error_desc(operation::application)
+{
+    this->message = message;
+}
+
+std::string error_desc::describe() const
+{
+    std::string message(operation_message(what));
+    switch (what)
+    {
+        case operation::check_socket_path:
+            std::format_to(std::back_inserter(message), ". Path length is {}, sockaddr_un::sun_path length is {}",
+                arguments[0], arguments[1]);
+            break;
+        case operation::add_to_epoll:
+        case operation::remove_from_epoll:
+        case operation::modify_epoll:
+            std::format_to(std::back_inserter(message), " {}", arguments[0]);
+            break;
+        case operation::application:
+            message = this->message;
+            break;
+        default:
+            break;
+    }
+
+    switch (error_source)
+    {
+        case error_source::posix:
+            std::format_to(std::back_inserter(message), ". error code {}: {}", error_code, strerror(error_code));
+            break;
+        case error_source::sway:
+            std::format_to(std::back_inserter(message), ". Exit code: {}", error_code);
+            break;
+        case error_source::invalid:
+            std::format_to(std::back_inserter(message), ": {}",
+                invalid_message(static_cast<invalid_error_code>(error_code)));
+            if (static_cast<invalid_error_code>(error_code) == invalid_error_code::magic_string_was_wrong)
+            {
+                // magic string is not null terminated
+                std::format_to(std::back_inserter(message), ". Magic string was {}",
+                    std::string_view(bytes, std::find(bytes, bytes + sizeof(bytes), '\0')));
+            }
+            else if (what == operation::compile_query)
+            {
+                std::format_to(std::back_inserter(message), " at \"{}\"",
+                    std::string_view(bytes, std::find(bytes, bytes + sizeof(bytes), '\0')));
+            }
+            break;
+        case error_source::parsing_error:
+            std::format_to(std::back_inserter(message), ". simdjson error {}: {}", error_code,
+                simdjson::error_message(static_cast<simdjson::error_code>(error_code)));
+            break;
+    }
+    return message;
+}
+} // namespace sway
@@ -0,0 +1,130 @@
+#pragma once
+#include <simdjson.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace sway
+{
+// Error is only a code, what failed and a couple of captured values, so it is copied around
+// in std::expected without allocations. Message is formatted only when somebody calls describe()
+struct error_desc
+{
+    enum class error_source : uint8_t
+    {
+        // error returned by standard C or posix function (like popen, fread, socket, e.t.c)
+        posix,
+        // error returned by sway process
+        sway,
+        // everything worked without error, but sway returned invalid output
+        invalid,
+        // json sent by by sway was invalid, or had unexpected structure
+        parsing_error
+    };
+
+    enum class invalid_error_code : int
+    {
+        // sway --get-socketpath returned path to socket, which was too long to put inside sockaddr_un
+        // which makes it impossible to create socket from it
+        path_to_socket_too_long,
+        // in sway response message, magic string was wrong
+        magic_string_was_wrong,
+        // sway returned message with negative payload length
+        negative_payload_length,
+        // sway closed connection, or connection was closed before whole message was read
+        connection_closed,
+        // criteria string could not be parsed
+        invalid_criteria,
+        // criteria key or regex syntax which query does not implement
+        unsupported_criteria,
+        // there is no subscription to events, which are needed
+        not_subscribed
+    };
+
+    // what was done when error happened, picks message of describe().
+    // Comments list values captured in arguments
+    enum class operation : uint8_t
+    {
+        // popen of sway --get-socketpath
+        start_get_socketpath,
+        read_get_socketpath,
+        wait_get_socketpath,
+        // sway --get-socketpath exited with non zero code
+        exit_get_socketpath,
+        // path length, sockaddr_un::sun_path length
+        check_socket_path,
+        create_socket,
+        connect_socket,
+        close_socket,
+        listen_socket,
+        make_nonblocking,
+        write_request,
+        read_reply,
+        // magic string in bytes
+        read_header,
+        allocate_parser,
+        parse_reply,
+        parse_subscribe_reply,
+        // sway returned success false
+        subscribe_refused,
+        parse_tick_reply,
+        parse_binding_state_reply,
+        decode_json,
+        request_without_connection,
+        event_without_subscription,
+        wait_reply,
+        wait_events,
+        create_epoll,
+        // fd
+        add_to_epoll,
+        // fd
+        remove_from_epoll,
+        // fd
+        modify_epoll,
+        wait_epoll,
+        create_timer,
+        start_timer,
+        close_timer,
+        create_eventfd,
+        // part of criteria in bytes
+        compile_query,
+        open_shared_memory,
+        // ftruncate or mmap
+        map_shared_memory,
+        event_barrier,
+        // posix function called by application itself, and not by library. Message in argument
+        application
+    };
+
+    // used with error_source posix, error_code is set to errno
+    error_desc(operation what, int64_t first = 0, int64_t second = 0);
+    // used with error_source sway, error_code is set to sway_return_code
+    error_desc(int sway_return_code, operation what);
+    // sway returned invalid output, error_code made up by me and placed enum error_code
+    error_desc(invalid_error_code error_code, operation what, int64_t first = 0, int64_t second = 0);
+    // bytes are cut to the size of captured bytes
+    error_desc(invalid_error_code error_code, operation what, std::string_view bytes);
+    error_desc(simdjson::error_code error_code, operation what);
+    // used by application with error_source posix, for its own calls, like opening its files.
+    // Only pointer to message is kept, so it should be string literal
+    explicit error_desc(const char* message);
+
+    // formats message, error code included
+    std::string describe() const;
+
+    int error_code;
+    enum error_source error_source;
+    operation what;
+    // what is set, depends on operation
+    union
+    {
+        int64_t arguments[2];
+        char bytes[sizeof(int64_t) * 2];
+        const char* message;
+    };
+};
+
+static_assert(std::is_trivially_copyable_v<error_desc>);
+static_assert(sizeof(error_desc) <= 24);
+} // namespace sway
@@ -0,0 +1,267 @@
+#include <sway_ipc/event_loop.hpp>
+#include <sway_ipc/sway_ipc.hpp>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <format>
+#include <print>
+#include <span>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace sway
+{
+event_loop::event_loop(bool print_errors_on_destroy /*= false*/)
+    : _print_errors_on_destroy(print_errors_on_destroy)
+{
+}
+
+event_loop::~event_loop()
+{
+    for (int timer_fd : _timers)
+    {
+        if (::close(timer_fd) && _print_errors_on_destroy)
+        {
+            std::println(stderr, "[sway::event_loop] Error encountered when closing timer "
+                "error code {}: {}", errno, strerror(errno));
+        }
+    }
+    if (_epoll_fd && ::close(_epoll_fd) && _print_errors_on_destroy)
+    {
+        std::println(stderr, "[sway::event_loop] Error encountered when closing epoll "
+            "error code {}: {}", errno, strerror(errno));
+    }
+}
+
+std::expected<void, error_desc> event_loop::create_epoll()
+{
+    if (_epoll_fd)
+    {
+        return {};
+    }
+
+    const int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1)
+    {
+        return std::unexpected(error_desc(error_desc::operation::create_epoll));
+    }
+    _epoll_fd = epoll_fd;
+    return {};
+}
+
+std::expected<void, error_desc> event_loop::add_fd(int fd, fd_callback callback, uint32_t events)
+{
+    std::expected<void, error_desc> create_result = create_epoll();
+    if (!create_result.has_value())
+    {
+        return create_result;
+    }
+
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (::epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event))
+    {
+        return std::unexpected(error_desc(error_desc::operation::add_to_epoll, fd));
+    }
+
+    // fd could be removed and added again during dispatch
+    std::erase(_removed, fd);
+    _callbacks.insert_or_assign(fd, std::move(callback));
+    return {};
+}
+
+std::expected<void, error_desc> event_loop::remove_fd(int fd)
+{
+    if (::epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr))
+    {
+        return std::unexpected(error_desc(error_desc::operation::remove_from_epoll, fd));
+    }
+
+    forget_fd(fd);
+    return {};
+}
+
+std::expected<void, error_desc> event_loop::modify_fd(int fd, uint32_t events)
+{
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (::epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event))
+    {
+        return std::unexpected(error_desc(error_desc::operation::modify_epoll, fd));
+    }
+    return {};
+}
+
+void event_loop::forget_fd(int fd)
+{
+    if (_dispatching)
+    {
+        // callback could be the one running right now
+        _removed.push_back(fd);
+    }
+    else
+    {
+        _callbacks.erase(fd);
+    }
+}
+
+std::expected<void, error_desc> event_loop::add_ipc(ipc& ipc, std::function<void(error_desc)> on_error)
+{
+    // without subscription there is no event fd to wait for
+    if (!ipc.subscribed())
+    {
+        return std::unexpected(error_desc(error_desc::invalid_error_code::not_subscribed,
+            error_desc::operation::event_without_subscription));
+    }
+    const int fd = ipc.event_fd();
+    std::expected<void, error_desc> add_result = add_fd(fd, [this, &ipc, fd, on_error = std::move(on_error)](uint32_t)
+    {
+        std::expected<size_t, error_desc> dispatch_result = ipc.dispatch();
+        if (!ipc.subscribed())
+        {
+            // subscription closed either by callback, or by error. fd is closed already,
+            // so epoll forgot about it, only callback is left
+            forget_fd(fd);
+        }
+        if (!dispatch_result.has_value())
+        {
+            on_error(std::move(dispatch_result.error()));
+        }
+    });
+
+    // events could arrive together with reply to subscription, and be buffered already.
+    // epoll would not report them until something else arrives, so dispatch them now.
+    // Callback can forget itself while it runs, so it is called as from run_once
+    if (add_result.has_value())
+    {
+        const bool dispatching = _dispatching;
+        _dispatching = true;
+        _callbacks.at(fd)(EPOLLIN);
+        _dispatching = dispatching;
+        if (!_dispatching)
+        {
+            erase_removed();
+        }
+    }
+    return add_result;
+}
+
+std::expected<int, error_desc> event_loop::add_timer(std::chrono::milliseconds interval, std::function<void()> callback)
+{
+    const int timer_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1)
+    {
+        return std::unexpected(error_desc(error_desc::operation::create_timer));
+    }
+
+    const std::chrono::seconds seconds = std::chrono::duration_cast<std::chrono::seconds>(interval);
+    itimerspec spec{};
+    spec.it_interval.tv_sec = seconds.count();
+    spec.it_interval.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(interval - seconds).count();
+    spec.it_value = spec.it_interval;
+    if (::timerfd_settime(timer_fd, 0, &spec, nullptr))
+    {
+        error_desc error(error_desc::operation::start_timer);
+        ::close(timer_fd);
+        return std::unexpected(std::move(error));
+    }
+
+    std::expected<void, error_desc> add_result = add_fd(timer_fd,
+        [timer_fd, callback = std::move(callback)](uint32_t)
+        {
+            uint64_t expirations;
+            // timer could expire several times, if loop was busy, it is called once anyway
+            if (::read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+            {
+                callback();
+            }
+        });
+    if (!add_result.has_value())
+    {
+        ::close(timer_fd);
+        return std::unexpected(std::move(add_result.error()));
+    }
+
+    _timers.push_back(timer_fd);
+    return timer_fd;
+}
+
+std::expected<void, error_desc> event_loop::remove_timer(int timer_id)
+{
+    std::expected<void, error_desc> remove_result = remove_fd(timer_id);
+    std::erase(_timers, timer_id);
+    if (::close(timer_id))
+    {
+        return std::unexpected(error_desc(error_desc::operation::close_timer));
+    }
+    return remove_result;
+}
+
+std::expected<void, error_desc> event_loop::run_once(int timeout_ms)
+{
+    std::expected<void, error_desc> create_result = create_epoll();
+    if (!create_result.has_value())
+    {
+        return create_result;
+    }
+
+    std::array<epoll_event, 16> events;
+    const int ready = ::epoll_wait(_epoll_fd, events.data(), events.size(), timeout_ms);
+    if (ready == -1)
+    {
+        if (errno == EINTR)
+        {
+            return {};
+        }
+        return std::unexpected(error_desc(error_desc::operation::wait_epoll));
+    }
+
+    _dispatching = true;
+    for (const epoll_event& event : std::span(events.data(), ready))
+    {
+        const int fd = event.data.fd;
+        // removed by one of previous callbacks
+        if (std::ranges::find(_removed, fd) != _removed.end())
+        {
+            continue;
+        }
+
+        auto it = _callbacks.find(fd);
+        if (it != _callbacks.end())
+        {
+            it->second(event.events);
+        }
+    }
+    _dispatching = false;
+
+    erase_removed();
+    return {};
+}
+
+void event_loop::erase_removed()
+{
+    for (int fd : _removed)
+    {
+        _callbacks.erase(fd);
+    }
+    _removed.clear();
+}
+
+std::expected<void, error_desc> event_loop::run()
+{
+    _running = true;
+    while (_running)
+    {
+        std::expected<void, error_desc> result = run_once();
+        if (!result.has_value())
+        {
+            _running = false;
+            return result;
+        }
+    }
+    return {};
+}
+} // namespace sway
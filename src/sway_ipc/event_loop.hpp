@@ -0,0 +1,66 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <chrono>
+#include <expected>
+#include <functional>
+#include <map>
+#include <vector>
+#include <sys/epoll.h>
+
+namespace sway
+{
+class ipc;
+
+// single threaded epoll loop. Lets one thread serve several sway connections,
+// timers, and anything else which has file descriptor
+class event_loop
+{
+public:
+    // callback is called with epoll events of file descriptor
+    using fd_callback = std::function<void(uint32_t events)>;
+
+    event_loop(bool print_errors_on_destroy = false);
+    ~event_loop();
+
+    event_loop(const event_loop&) = delete;
+    event_loop& operator=(const event_loop&) = delete;
+
+    // fd is not owned by loop, and should be removed before it is closed
+    std::expected<void, error_desc> add_fd(int fd, fd_callback callback, uint32_t events = EPOLLIN);
+    std::expected<void, error_desc> remove_fd(int fd);
+    // changes epoll events fd waits for, callback stays the same
+    std::expected<void, error_desc> modify_fd(int fd, uint32_t events);
+
+    // subscription should be made with subscribe_nonblocking, ipc without it is refused. On dispatch error
+    // fd is removed from loop, and error is given to on_error.
+    // Events already buffered by ipc are dispatched right away
+    std::expected<void, error_desc> add_ipc(ipc& ipc, std::function<void(error_desc)> on_error);
+
+    // timer fd is owned by loop. Returns id, which can be used to remove timer
+    std::expected<int, error_desc> add_timer(std::chrono::milliseconds interval, std::function<void()> callback);
+    std::expected<void, error_desc> remove_timer(int timer_id);
+
+    // waits for events at most timeout (-1 means forever), and calls callbacks of ready fds
+    std::expected<void, error_desc> run_once(int timeout_ms = -1);
+    // runs until stop is called, or error returned by epoll
+    std::expected<void, error_desc> run();
+    void stop() { _running = false; }
+
+private:
+    std::expected<void, error_desc> create_epoll();
+    // removes callback of fd, which is already gone from epoll
+    void forget_fd(int fd);
+    // callbacks forgotten while callbacks were running
+    void erase_removed();
+
+    int _epoll_fd = 0;
+    bool _running = false;
+    bool _print_errors_on_destroy;
+    // map, so callbacks are not moved when other fds added from inside callback
+    std::map<int, fd_callback> _callbacks;
+    std::vector<int> _timers;
+    // fds removed while callbacks are running, erased after all of them are called
+    std::vector<int> _removed;
+    bool _dispatching = false;
+};
+} // namespace sway
@@ -0,0 +1,45 @@
+#include <sway_ipc/events/event_filter.hpp>
+#include <algorithm>
+
+namespace sway
+{
+bool passes(std::span<const event_filter> filters, const frame& event)
+{
+    const std::string_view payload(event.payload, event.length);
+    // found once, and only if some filter needs it
+    std::string_view change;
+    bool change_found = false;
+
+    bool has_filter = false;
+    for (const event_filter& filter : filters)
+    {
+        if (static_cast<uint32_t>(filter.type) != event.payload_type)
+        {
+            continue;
+        }
+        has_filter = true;
+
+        if (!filter.changes.empty())
+        {
+            if (!change_found)
+            {
+                change = raw_change(event);
+                change_found = true;
+            }
+            if (std::ranges::find(filter.changes, change) == filter.changes.end())
+            {
+                continue;
+            }
+        }
+
+        if (std::ranges::all_of(filter.contains, [payload](std::string_view part)
+        {
+            return payload.find(part) != std::string_view::npos;
+        }))
+        {
+            return true;
+        }
+    }
+    return !has_filter;
+}
+} // namespace sway
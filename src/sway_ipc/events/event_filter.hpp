@@ -0,0 +1,47 @@
+#pragma once
+#include <sway_ipc/events/event_type.hpp>
+#include <sway_ipc/frame_buffer.hpp>
+#include <span>
+#include <string_view>
+
+// filters, which reject events on raw bytes of frame, before simdjson sees them. Rejected event is not
+// parsed and not delivered, but it still invalidates cached replies of ipc. Filters are only a cheap
+// first pass: what they accept is checked by subscriber as usual, so they can let through too much,
+// but never reject event subscriber would act on.
+//
+// Checks are string searches over payload, which libc does with vector instructions. Change is the
+// first key of sway events, so looking for it stops after a few bytes whatever size of event is.
+// Typed handler declares its filters as
+//     static constexpr sway::event_filter event_filters[] = {...};
+
+namespace sway
+{
+struct event_filter
+{
+    event_type type;
+    // event passes if its change is one of these. Empty accepts any change
+    std::span<const std::string_view> changes;
+    // event passes if all of these are somewhere in payload. Matched against json as it is on the wire,
+    // so strings with characters, which json escapes ('/' among them), are not found
+    std::span<const std::string_view> contains;
+};
+
+// true if some filter of event type accepts event, or there is no filter of its type
+bool passes(std::span<const event_filter> filters, const frame& event);
+
+namespace detail
+{
+template <typename Handler>
+constexpr std::span<const event_filter> handler_filters()
+{
+    if constexpr (requires { std::span<const event_filter>(Handler::event_filters); })
+    {
+        return Handler::event_filters;
+    }
+    else
+    {
+        return {};
+    }
+}
+} // namespace detail
+} // namespace sway
@@ -0,0 +1,115 @@
+#pragma once
+#include <sway_ipc/events/event_type.hpp>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// typed handlers of events for ipc::subscribe. Handler is any object with overloads
+//     bool operator()(sway::event_tag<sway::event_type::mode>, sway::ipc::event_payload& event);
+// for event types it wants, returning true to unsubscribe, like function of untyped subscribe.
+// Subscription is made to exactly these event types, and each event goes straight to its overload
+// through a table built at compile time, so handler can be inlined, and nothing is type erased.
+// Optional bool on_error(const sway::error_desc&) gets errors, without it they end subscription
+
+namespace sway
+{
+template <event_type type>
+struct event_tag
+{
+    static constexpr event_type value = type;
+};
+
+inline constexpr event_type all_event_types[] = {
+    event_type::workspace,
+    event_type::output,
+    event_type::mode,
+    event_type::window,
+    event_type::barconfig_update,
+    event_type::binding,
+    event_type::shutdown,
+    event_type::tick,
+    event_type::bar_state_update,
+    event_type::input,
+};
+
+template <typename Handler, typename Payload, event_type type>
+concept handles = requires(Handler& handler, Payload& payload)
+{
+    { handler(event_tag<type>{}, payload) } -> std::convertible_to<bool>;
+};
+
+namespace detail
+{
+// event types are 0x80000000 | small number, which is index in table
+constexpr uint32_t event_index(event_type type)
+{
+    return static_cast<uint32_t>(type) & 0x7fffffff;
+}
+
+inline constexpr size_t event_table_size = event_index(event_type::input) + 1;
+
+template <typename Handler, typename Payload>
+using event_function = bool (*)(Handler&, Payload&);
+
+template <typename Handler, typename Payload, event_type type>
+bool call_handler(Handler& handler, Payload& payload)
+{
+    return handler(event_tag<type>{}, payload);
+}
+
+template <typename Handler, typename Payload>
+constexpr auto make_event_table()
+{
+    std::array<event_function<Handler, Payload>, event_table_size> table{};
+    [&table]<size_t... i>(std::index_sequence<i...>)
+    {
+        ([&table]()
+        {
+            constexpr event_type type = all_event_types[i];
+            if constexpr (handles<Handler, Payload, type>)
+            {
+                table[event_index(type)] = &call_handler<Handler, Payload, type>;
+            }
+        }(), ...);
+    }(std::make_index_sequence<std::size(all_event_types)>());
+    return table;
+}
+
+template <typename Handler, typename Payload>
+constexpr auto handled_events()
+{
+    constexpr size_t count = []<size_t... i>(std::index_sequence<i...>)
+    {
+        return (size_t(handles<Handler, Payload, all_event_types[i]>) + ...);
+    }(std::make_index_sequence<std::size(all_event_types)>());
+    static_assert(count != 0, "handler has no overload for any event type");
+
+    std::array<event_type, count> events{};
+    size_t next = 0;
+    for (size_t i = 0; const auto& function : make_event_table<Handler, Payload>())
+    {
+        if (function != nullptr)
+        {
+            events[next++] = static_cast<event_type>(0x80000000 | i);
+        }
+        ++i;
+    }
+    return events;
+}
+
+template <typename Handler, typename Payload>
+bool dispatch_event(Handler& handler, Payload& payload)
+{
+    static constexpr auto table = make_event_table<Handler, Payload>();
+    const uint32_t index = event_index(payload.event_type);
+    // sway sends only subscribed events, but stream could have anything
+    if (index >= table.size() || table[index] == nullptr)
+    {
+        return false;
+    }
+    return table[index](handler, payload);
+}
+} // namespace detail
+} // namespace sway
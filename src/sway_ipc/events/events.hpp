@@ -0,0 +1,84 @@
+#pragma once
+#include <sway_ipc/replies.hpp>
+#include <optional>
+#include <string_view>
+#include <tuple>
+
+// typed payloads of events, described in sway-ipc(7)
+
+namespace sway
+{
+struct workspace_event
+{
+    // init, empty, focus, move, rename, urgent or reload
+    std::string_view change;
+    std::optional<workspace> current;
+    std::optional<workspace> old;
+};
+
+template <>
+inline constexpr auto schema<workspace_event> = std::tuple{
+    field{"change", &workspace_event::change},
+    field{"current", &workspace_event::current},
+    field{"old", &workspace_event::old},
+};
+
+struct output_event
+{
+    std::string_view change;
+};
+
+template <>
+inline constexpr auto schema<output_event> = std::tuple{
+    field{"change", &output_event::change},
+};
+
+struct mode_event
+{
+    // name of the mode, "default" if none
+    std::string_view change;
+    bool pango_markup = false;
+};
+
+template <>
+inline constexpr auto schema<mode_event> = std::tuple{
+    field{"change", &mode_event::change},
+    field{"pango_markup", &mode_event::pango_markup},
+};
+
+struct window_event
+{
+    // new, close, focus, title, fullscreen_mode, move, floating, urgent or mark
+    std::string_view change;
+    node container;
+};
+
+template <>
+inline constexpr auto schema<window_event> = std::tuple{
+    field{"change", &window_event::change},
+    field{"container", &window_event::container},
+};
+
+struct shutdown_event
+{
+    std::string_view change;
+};
+
+template <>
+inline constexpr auto schema<shutdown_event> = std::tuple{
+    field{"change", &shutdown_event::change},
+};
+
+struct tick_event
+{
+    // true for tick sent right after subscribing to it
+    bool first = false;
+    std::string_view payload;
+};
+
+template <>
+inline constexpr auto schema<tick_event> = std::tuple{
+    field{"first", &tick_event::first},
+    field{"payload", &tick_event::payload},
+};
+} // namespace sway
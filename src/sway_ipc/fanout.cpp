@@ -0,0 +1,411 @@
+#include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/frame_buffer.hpp>
+#include <sway_ipc/spsc_ring.hpp>
+#include <simdjson.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+// event copied out of frame buffer, owned by queue slot. Buffer of slot keeps its memory
+// between events, so queues do not allocate after they saw the biggest event
+struct queued_event
+{
+    uint32_t payload_type = 0;
+    size_t length = 0;
+    sized_buffer payload;
+    // reader failed, the last element queued
+    std::optional<sway::error_desc> error;
+
+    void assign(const sway::frame& event_frame)
+    {
+        payload_type = event_frame.payload_type;
+        length = event_frame.length;
+        // parsed in place by worker
+        payload.allocate(length + simdjson::SIMDJSON_PADDING);
+        std::memcpy(payload.ptr(), event_frame.payload, length);
+        error.reset();
+    }
+
+    sway::frame as_frame() { return sway::frame{payload_type, payload.ptr(), length}; }
+};
+
+struct worker
+{
+    explicit worker(size_t capacity) : queue(capacity) {}
+
+    sway::spsc_ring<queued_event> queue;
+    // events which did not fit into queue, touched only by reader. Used by drop_oldest and coalesce
+    std::vector<queued_event> held;
+    // events taken out of held, kept for their buffers
+    std::vector<queued_event> spare;
+    // held is not empty. Worker can not look at held itself
+    std::atomic<bool> holding{false};
+    std::thread thread;
+};
+
+struct fanout
+{
+    sway::fanout_options options;
+    sway::fanout_stats& stats;
+    std::vector<std::unique_ptr<worker>> workers;
+    // set by worker, which function asked to unsubscribe
+    std::atomic<bool> stop{false};
+    // wakes reader, when worker stops or takes event while reader holds some
+    int wake_fd = -1;
+
+    void wake()
+    {
+        const uint64_t value = 1;
+        // counter can not overflow from this, so write fails only if fd is broken, and then
+        // there is nobody to wake anyway
+        (void)::write(wake_fd, &value, sizeof(value));
+    }
+
+    void note_depth(const worker& target)
+    {
+        const size_t depth = target.queue.size();
+        size_t deepest = stats.max_queue_depth.load(std::memory_order_relaxed);
+        while (depth > deepest &&
+            !stats.max_queue_depth.compare_exchange_weak(deepest, depth, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // moves held events into queue while it has space, oldest first
+    void flush_held(worker& target)
+    {
+        while (true)
+        {
+            size_t moved = 0;
+            while (moved < target.held.size())
+            {
+                queued_event* slot = target.queue.back();
+                if (slot == nullptr)
+                {
+                    break;
+                }
+                std::swap(*slot, target.held[moved]);
+                target.queue.push();
+                ++moved;
+            }
+            if (moved != 0)
+            {
+                std::move(target.held.begin(), target.held.begin() + moved, std::back_inserter(target.spare));
+                target.held.erase(target.held.begin(), target.held.begin() + moved);
+                note_depth(target);
+            }
+
+            if (target.held.empty())
+            {
+                target.holding.store(false, std::memory_order_relaxed);
+                return;
+            }
+            // pairs with fence in worker: either worker sees holding after its pop and wakes
+            // reader, or reader sees space here and goes for another round
+            target.holding.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (target.queue.back() == nullptr)
+            {
+                return;
+            }
+        }
+    }
+
+    // all queues, so reader does not wait for space in queue of worker which already quit
+    void close_queues()
+    {
+        for (std::unique_ptr<worker>& target : workers)
+        {
+            target->queue.close();
+        }
+    }
+
+    queued_event& hold(worker& target)
+    {
+        if (target.spare.empty())
+        {
+            return target.held.emplace_back();
+        }
+        target.held.push_back(std::move(target.spare.back()));
+        target.spare.pop_back();
+        return target.held.back();
+    }
+
+    worker& route(const sway::frame& event_frame)
+    {
+        if (options.routing == sway::fanout_options::routing::container && workers.size() > 1)
+        {
+            const std::optional<sway::event_key> key = sway::raw_event_key(event_frame);
+            if (key.has_value() && key->id != 0)
+            {
+                return *workers[static_cast<uint64_t>(key->id) % workers.size()];
+            }
+        }
+        return *workers[sway::detail::event_index(sway::event_type(event_frame.payload_type)) % workers.size()];
+    }
+
+    // returns false if worker is gone, and reader should stop
+    bool enqueue(const sway::frame& event_frame)
+    {
+        stats.read.fetch_add(1, std::memory_order_relaxed);
+        worker& target = route(event_frame);
+
+        flush_held(target);
+        queued_event* slot = target.held.empty() ? target.queue.back() : nullptr;
+        if (slot == nullptr)
+        {
+            stats.overflows.fetch_add(1, std::memory_order_relaxed);
+            switch (options.overflow)
+            {
+                case sway::fanout_options::overflow::block:
+                    slot = target.queue.wait_back();
+                    if (slot == nullptr)
+                    {
+                        return false;
+                    }
+                    break;
+                case sway::fanout_options::overflow::coalesce:
+                {
+                    // events of different windows are never merged, close of one window is not
+                    // the newer state of another
+                    const std::optional<sway::event_key> key = sway::raw_event_key(event_frame);
+                    auto same = !key.has_value() ? target.held.end() :
+                        std::ranges::find_if(target.held, [&key](queued_event& held)
+                        {
+                            return sway::raw_event_key(held.as_frame()) == key;
+                        });
+                    if (same != target.held.end())
+                    {
+                        // newer event takes place at the end, as the last one of its kind
+                        std::rotate(same, same + 1, target.held.end());
+                        target.held.back().assign(event_frame);
+                        stats.coalesced.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                    [[fallthrough]];
+                }
+                case sway::fanout_options::overflow::drop_oldest:
+                    if (target.held.size() >= target.queue.capacity())
+                    {
+                        target.spare.push_back(std::move(target.held.front()));
+                        target.held.erase(target.held.begin());
+                        stats.dropped.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    hold(target).assign(event_frame);
+                    // worker could take event since the check above
+                    flush_held(target);
+                    return true;
+            }
+        }
+
+        slot->assign(event_frame);
+        target.queue.push();
+        note_depth(target);
+        return true;
+    }
+
+    // error ends subscription, so it waits for space whatever the policy is
+    void enqueue_error(sway::error_desc error)
+    {
+        worker& target = *workers.front();
+        for (queued_event& held : target.held)
+        {
+            queued_event* slot = target.queue.wait_back();
+            if (slot == nullptr)
+            {
+                return;
+            }
+            std::swap(*slot, held);
+            target.queue.push();
+        }
+        target.held.clear();
+        target.holding.store(false, std::memory_order_relaxed);
+
+        queued_event* slot = target.queue.wait_back();
+        if (slot != nullptr)
+        {
+            slot->error = error;
+            target.queue.push();
+        }
+    }
+
+    // sink is ipc::event_sink, which is private to ipc
+    template <typename Sink>
+    void run_worker(worker& self, Sink sink)
+    {
+        // documents are bound to parser, so each worker has its own
+        simdjson::ondemand::parser parser;
+        while (!stop.load(std::memory_order_acquire))
+        {
+            queued_event* event = self.queue.wait_front();
+            if (event == nullptr || stop.load(std::memory_order_acquire))
+            {
+                break;
+            }
+
+            const size_t remaining = self.queue.size() - 1;
+            sway::ipc::event_result result = event->error.has_value() ?
+                sway::ipc::event_result(std::unexpected(event->error.value())) :
+                sway::parse_payload(parser, event->payload.ptr(), event->length)
+                    .transform([event, remaining](simdjson::ondemand::document json)
+                    {
+                        return sway::ipc::event_payload{sway::event_type(event->payload_type), std::move(json), remaining};
+                    });
+            const bool should_unsubscribe = sink(std::move(result));
+            self.queue.pop();
+            stats.delivered.fetch_add(1, std::memory_order_relaxed);
+
+            if (should_unsubscribe)
+            {
+                stop.store(true, std::memory_order_release);
+                close_queues();
+                wake();
+                break;
+            }
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (self.holding.load(std::memory_order_relaxed))
+            {
+                // reader holds events, which now fit. It is woken to move them, and
+                // not only when the next event arrives
+                wake();
+            }
+        }
+    }
+};
+} // namespace
+
+namespace sway
+{
+ipc::subscribe_result ipc::subscribe_threaded(std::span<sway::event_type> events,
+    std::function<bool(ipc::event_result)> function, fanout_options options, std::span<const event_filter> filters)
+{
+    return subscribe_threaded_sink(events, event_sink::to_function(function), options, filters);
+}
+
+ipc::subscribe_result ipc::subscribe_threaded_sink(std::span<sway::event_type> events, event_sink sink,
+    fanout_options options, std::span<const event_filter> filters)
+{
+    subscribe_result result = open_subscription(events, filters);
+    if (!result.subscription_successful || result.error.has_value())
+    {
+        return result;
+    }
+
+    fanout context{options, _fanout_stats};
+    context.wake_fd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (context.wake_fd == -1)
+    {
+        error_desc error{error_desc::operation::create_eventfd};
+        close_subscription();
+        return subscribe_result{true, std::move(error)};
+    }
+
+    for (std::atomic<uint64_t>* counter : {&_fanout_stats.read, &_fanout_stats.delivered,
+        &_fanout_stats.dropped, &_fanout_stats.coalesced, &_fanout_stats.overflows})
+    {
+        counter->store(0, std::memory_order_relaxed);
+    }
+    _fanout_stats.max_queue_depth.store(0, std::memory_order_relaxed);
+
+    const size_t worker_count = std::max<size_t>(options.workers, 1);
+    for (size_t i = 0; i < worker_count; ++i)
+    {
+        context.workers.push_back(std::make_unique<worker>(options.queue_capacity));
+    }
+    // started after all of them exist, since reader routes to any of them
+    for (std::unique_ptr<worker>& target : context.workers)
+    {
+        target->thread = std::thread([&context, &target = *target, sink]()
+        {
+            context.run_worker(target, sink);
+        });
+    }
+
+    // events already buffered together with subscription reply go first
+    bool reading = true;
+    std::optional<error_desc> read_error;
+    pollfd poll_fds[2] = {{_event_socket.get(), POLLIN, 0}, {context.wake_fd, POLLIN, 0}};
+    while (reading && !context.stop.load(std::memory_order_acquire))
+    {
+        while (true)
+        {
+            std::expected<std::optional<frame>, error_desc> frame_result = _event_frames.next_frame();
+            if (!frame_result.has_value())
+            {
+                read_error = std::move(frame_result.error());
+                reading = false;
+                break;
+            }
+            else if (!frame_result->has_value())
+            {
+                break;
+            }
+            note_event(frame_result->value());
+            if (!passes(_event_filters, frame_result->value()))
+            {
+                continue;
+            }
+            if (!context.enqueue(frame_result->value()))
+            {
+                reading = false;
+                break;
+            }
+        }
+        if (!reading)
+        {
+            break;
+        }
+
+        const int ready = ::poll(poll_fds, 2, -1);
+        if (ready == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            read_error = error_desc(error_desc::operation::wait_events);
+            break;
+        }
+
+        if (poll_fds[1].revents != 0)
+        {
+            uint64_t wakes;
+            (void)::read(context.wake_fd, &wakes, sizeof(wakes));
+            for (std::unique_ptr<worker>& target : context.workers)
+            {
+                context.flush_held(*target);
+            }
+        }
+        if (poll_fds[0].revents != 0)
+        {
+            std::expected<size_t, error_desc> fill_result = _event_frames.fill(_event_socket.get());
+            if (!fill_result.has_value())
+            {
+                read_error = std::move(fill_result.error());
+                break;
+            }
+        }
+    }
+
+    if (read_error.has_value() && !context.stop.load(std::memory_order_acquire))
+    {
+        // function gets error after events read before it, as without threads
+        context.enqueue_error(read_error.value());
+    }
+    context.close_queues();
+    for (std::unique_ptr<worker>& target : context.workers)
+    {
+        target->thread.join();
+    }
+    ::close(context.wake_fd);
+
+    return subscribe_result{true, close_subscription()};
+}
+} // namespace sway
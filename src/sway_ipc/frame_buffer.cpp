@@ -0,0 +1,293 @@
+#include <sway_ipc/frame_buffer.hpp>
+#include <sway_ipc/events/event_type.hpp>
+#include <sway_ipc/message.hpp>
+#include <simdjson.h>
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <unistd.h>
+
+namespace
+{
+// minimum amount of free space given to single read
+constexpr size_t min_read_size = 4096;
+
+// header on the wire starts from magic
+constexpr size_t header_length_offset = offsetof(sway::message_header, length) - offsetof(sway::message_header, magic);
+
+size_t skip_space(std::string_view text, size_t position)
+{
+    while (position < text.size() && (text[position] == ' ' || text[position] == '\n' || text[position] == '\t'))
+    {
+        ++position;
+    }
+    return position;
+}
+
+// true if text at position is token, possibly after whitespace. Position is moved past it
+bool expect(std::string_view text, size_t& position, std::string_view token)
+{
+    position = skip_space(text, position);
+    if (text.substr(position, token.size()) != token)
+    {
+        return false;
+    }
+    position += token.size();
+    return true;
+}
+
+// id of node under key. Sway writes id as the first field of node, so it follows right after
+// the brace. String equal to key somewhere in values is not followed by colon and brace, and is skipped
+std::optional<int64_t> raw_node_id(std::string_view payload, std::string_view quoted_key)
+{
+    for (size_t found = payload.find(quoted_key); found != std::string_view::npos;
+        found = payload.find(quoted_key, found + 1))
+    {
+        size_t position = found + quoted_key.size();
+        if (!expect(payload, position, ":") || !expect(payload, position, "{") ||
+            !expect(payload, position, "\"id\"") || !expect(payload, position, ":"))
+        {
+            continue;
+        }
+        position = skip_space(payload, position);
+        int64_t id;
+        const std::from_chars_result result = std::from_chars(payload.data() + position,
+            payload.data() + payload.size(), id);
+        if (result.ec == std::errc{})
+        {
+            return id;
+        }
+    }
+    return std::nullopt;
+}
+} // namespace
+
+namespace sway
+{
+void frame_buffer::reserve(size_t min_free)
+{
+    // tail of the buffer is always left for simdjson padding of the last frame
+    const size_t tail = min_free + simdjson::SIMDJSON_PADDING;
+    // space taken by frames already returned is reused, and buffer grows only if that is not enough.
+    // Incomplete message is moved to the front first, so growth does not copy consumed bytes
+    if (_buffer.size() - _end < tail && _begin != 0)
+    {
+        std::memmove(_buffer.ptr(), _buffer.ptr() + _begin, _end - _begin);
+        _end -= _begin;
+        _begin = 0;
+    }
+    // called even when buffer is big enough, so that high water mark counts every read
+    _buffer.grow(_end + tail, _end);
+}
+
+void frame_buffer::shrink()
+{
+    if (_begin == _end)
+    {
+        _begin = _end = 0;
+        _buffer.shrink(0);
+    }
+}
+
+std::expected<size_t, error_desc> frame_buffer::fill(int sock_fd)
+{
+    if (_begin == _end)
+    {
+        _begin = _end = 0;
+    }
+
+    size_t min_free = min_read_size;
+    // if size of incomplete message is known, make space for it right away. First message
+    // can be complete too, when more is read before taking frames out
+    const size_t available = _end - _begin;
+    if (available >= header_size)
+    {
+        int length;
+        std::memcpy(&length, _buffer.ptr() + _begin + header_length_offset, sizeof(length));
+        if (length > 0 && header_size + static_cast<size_t>(length) > available)
+        {
+            min_free = std::max(min_free, header_size + static_cast<size_t>(length) - available);
+        }
+    }
+    reserve(min_free);
+
+    while (true)
+    {
+        const ssize_t result = ::read(sock_fd, _buffer.ptr() + _end,
+            _buffer.size() - _end - simdjson::SIMDJSON_PADDING);
+        if (result > 0)
+        {
+            _end += result;
+            return static_cast<size_t>(result);
+        }
+        else if (result == 0)
+        {
+            return std::unexpected(error_desc(error_desc::invalid_error_code::connection_closed,
+                error_desc::operation::read_reply));
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return 0;
+        }
+        else if (errno != EINTR)
+        {
+            return std::unexpected(error_desc(error_desc::operation::read_reply));
+        }
+    }
+}
+
+bool frame_buffer::has_frame() const
+{
+    if (_end - _begin < header_size)
+    {
+        return false;
+    }
+
+    int length;
+    std::memcpy(&length, _buffer.ptr() + _begin + header_length_offset, sizeof(length));
+    // negative length is reported by next_frame
+    return length < 0 || _end - _begin - header_size >= static_cast<size_t>(length);
+}
+
+size_t frame_buffer::count_frames(size_t limit) const
+{
+    size_t count = 0;
+    for (size_t offset = _begin; count < limit && _end - offset >= header_size; ++count)
+    {
+        int length;
+        std::memcpy(&length, _buffer.ptr() + offset + header_length_offset, sizeof(length));
+        if (length < 0 || _end - offset - header_size < static_cast<size_t>(length))
+        {
+            break;
+        }
+        offset += header_size + length;
+    }
+    return count;
+}
+
+std::expected<std::optional<frame>, error_desc> frame_buffer::next_frame()
+{
+    const size_t available = _end - _begin;
+    if (available < header_size)
+    {
+        return std::nullopt;
+    }
+
+    // header on the wire starts from magic
+    message_header header;
+    std::memcpy(header.magic, _buffer.ptr() + _begin, header_size);
+
+    if (std::memcmp(header.magic, "i3-ipc", 6) != 0)
+    {
+        return std::unexpected(error_desc(
+            error_desc::invalid_error_code::magic_string_was_wrong,
+            error_desc::operation::read_header,
+            std::string_view(header.magic, 6)));
+    }
+
+    if (header.length < 0)
+    {
+        return std::unexpected(error_desc(
+            error_desc::invalid_error_code::negative_payload_length,
+            error_desc::operation::read_header));
+    }
+
+    const size_t length = static_cast<size_t>(header.length);
+    if (available - header_size < length)
+    {
+        return std::nullopt;
+    }
+
+    frame result{static_cast<uint32_t>(header.payload_type), _buffer.ptr() + _begin + header_size, length};
+    _begin += header_size + length;
+    return result;
+}
+
+// value of top level "change" field, without parsing whole event. Sway puts it first in
+// every event, which has it. Empty if event has no change, or it could not be found
+std::string_view raw_change(const frame& event)
+{
+    constexpr std::string_view key = "\"change\"";
+    const std::string_view payload(event.payload, event.length);
+    size_t position = payload.find(key);
+    if (position == std::string_view::npos)
+    {
+        return {};
+    }
+
+    position = payload.find('"', payload.find(':', position + key.size()));
+    if (position == std::string_view::npos)
+    {
+        return {};
+    }
+    const size_t end = payload.find('"', position + 1);
+    if (end == std::string_view::npos)
+    {
+        return {};
+    }
+    return payload.substr(position + 1, end - position - 1);
+}
+
+std::optional<event_key> raw_event_key(const frame& event)
+{
+    event_key key{event.payload_type, raw_change(event)};
+    const std::string_view payload(event.payload, event.length);
+    std::optional<int64_t> id = 0;
+    switch (event_type(event.payload_type))
+    {
+        case event_type::window:
+            id = raw_node_id(payload, "\"container\"");
+            break;
+        case event_type::workspace:
+            id = raw_node_id(payload, "\"current\"");
+            break;
+        case event_type::binding:
+        case event_type::tick:
+        case event_type::shutdown:
+            return std::nullopt;
+        default:
+            break;
+    }
+    if (!id.has_value())
+    {
+        return std::nullopt;
+    }
+    key.id = id.value();
+    return key;
+}
+
+std::expected<simdjson::ondemand::document, error_desc>
+parse_payload(simdjson::ondemand::parser& parser, const char* ptr, size_t length)
+{
+    // allocate reallocates for any other capacity, smaller too. Grows to power of two, so payloads
+    // which get a bit longer each time, like ticks with a counter, do not reallocate every time
+    if (length > parser.capacity())
+    {
+        simdjson::error_code error = parser.allocate(std::min(std::bit_ceil(length), parser.max_capacity()));
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return std::unexpected(error_desc(error, error_desc::operation::allocate_parser));
+        }
+    }
+    simdjson::simdjson_result<simdjson::ondemand::document> document =
+        parser.iterate(simdjson::padded_string_view(ptr, length, length + simdjson::SIMDJSON_PADDING));
+    if (document.error() != simdjson::error_code::SUCCESS)
+    {
+        return std::unexpected(error_desc(document.error(), error_desc::operation::parse_reply));
+    }
+
+    return std::move(document.value_unsafe());
+}
+
+void shrink_parser(simdjson::ondemand::parser& parser, size_t capacity)
+{
+    if (parser.capacity() > capacity)
+    {
+        const simdjson::error_code error = parser.allocate(capacity);
+        // failed allocation leaves parser empty, and the next parse allocates again
+        (void)error;
+    }
+}
+} // namespace sway
@@ -0,0 +1,83 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <sway_ipc/sized_buffer.hpp>
+#include <expected>
+#include <optional>
+#include <string_view>
+
+namespace sway
+{
+// complete i3-ipc message, carved from frame_buffer
+struct frame
+{
+    uint32_t payload_type;
+    // payload is followed by at least SIMDJSON_PADDING bytes of readable memory,
+    // so it can be given to simdjson in place
+    char* payload;
+    size_t length;
+};
+
+// accumulates bytes read from socket, and splits them into messages. Bytes of
+// incomplete message at the end are kept until the rest of it arrives
+class frame_buffer
+{
+public:
+    // one read of everything socket has, without waiting for complete message.
+    // returns number of bytes read, 0 means non-blocking socket had nothing to read
+    // frames returned by next_frame before call are invalidated
+    std::expected<size_t, error_desc> fill(int sock_fd);
+
+    // returns nullopt if there is no complete message in buffer
+    std::expected<std::optional<frame>, error_desc> next_frame();
+
+    // true if next_frame would return frame, or report broken message. Does not take frame out
+    bool has_frame() const;
+    // complete frames in buffer, counted up to limit by their headers
+    size_t count_frames(size_t limit) const;
+
+    // bytes read from socket, but not yet returned as frames
+    size_t buffered() const { return _end - _begin; }
+
+    // drops everything buffered, allocated memory is kept
+    void clear() { _begin = _end = 0; }
+
+    // if nothing is buffered, gives back memory above the biggest size needed since the last shrink
+    void shrink();
+    // no message longer than that fits
+    size_t capacity() const { return _buffer.size(); }
+
+private:
+    // makes sure that at least min_free bytes can be read after _end
+    void reserve(size_t min_free);
+
+    sized_buffer _buffer;
+    size_t _begin = 0;
+    size_t _end = 0;
+};
+
+// value of top level "change" field, without parsing whole event. Empty if event has no change
+std::string_view raw_change(const frame& event);
+
+// identity of event, which is replaced by later event of the same identity when only the last state
+// matters: event type, change, and id of container of window event or of current workspace of
+// workspace event. Binding, tick and shutdown are not states, and have none, as events whose id
+// could not be found
+struct event_key
+{
+    uint32_t payload_type;
+    std::string_view change;
+    int64_t id = 0;
+
+    bool operator==(const event_key&) const = default;
+};
+
+std::optional<event_key> raw_event_key(const frame& event);
+
+// ptr should have at least SIMDJSON_PADDING bytes of readable memory after length.
+// Parser only grows, so messages of different sizes do not reallocate it every time
+std::expected<simdjson::ondemand::document, error_desc>
+parse_payload(simdjson::ondemand::parser& parser, const char* ptr, size_t length);
+
+// gives back capacity of parser above given one, like frame_buffer::shrink
+void shrink_parser(simdjson::ondemand::parser& parser, size_t capacity);
+} // namespace sway
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace sway
+{
+enum class payload_type : uint32_t
+{
+    run_command = 0,
+    get_workspaces = 1,
+    subscribe = 2,
+    get_outputs = 3,
+    get_tree = 4,
+    get_marks = 5,
+    get_bar_config = 6,
+    get_version = 7,
+    get_binding_modes = 8,
+    get_config = 9,
+    send_tick = 10,
+    sync = 11,
+    get_binding_state = 12,
+    get_inputs = 100,
+    get_seats = 101
+};
+
+constexpr size_t header_size = 6 + sizeof(int) + sizeof(payload_type);
+
+// padding is there only to align length and payload_type,
+// message sent over socket starts from magic
+struct message_header
+{
+    char padding[2];
+    char magic[6] = {'i', '3', '-', 'i', 'p', 'c'};
+    int length;
+    payload_type payload_type;
+};
+} // namespace sway
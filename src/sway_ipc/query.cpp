@@ -0,0 +1,634 @@
+#include <sway_ipc/query.hpp>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+namespace
+{
+// characters of regex, which are not implemented when not escaped
+constexpr std::string_view regex_syntax = "^$*+?()[]{}|";
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+simdjson::error_code optional_string(simdjson::ondemand::value value, std::optional<std::string_view>& out)
+{
+    bool null = false;
+    simdjson::error_code error = value.is_null().get(null);
+    if (error != simdjson::error_code::SUCCESS || null)
+    {
+        return error;
+    }
+    return value.get_string().get(out.emplace());
+}
+
+template <typename T>
+simdjson::error_code optional_number(simdjson::ondemand::value value, std::optional<T>& out)
+{
+    bool null = false;
+    simdjson::error_code error = value.is_null().get(null);
+    if (error != simdjson::error_code::SUCCESS || null)
+    {
+        return error;
+    }
+    int64_t number;
+    error = value.get_int64().get(number);
+    out = static_cast<T>(number);
+    return error;
+}
+
+std::optional<int64_t> parse_number(std::string_view value)
+{
+    int64_t number;
+    const std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (result.ec != std::errc{} || result.ptr != value.data() + value.size())
+    {
+        return std::nullopt;
+    }
+    return number;
+}
+
+sway::error_desc criteria_error(sway::error_desc::invalid_error_code error_code, std::string_view near)
+{
+    return sway::error_desc(error_code, sway::error_desc::operation::compile_query, near);
+}
+} // namespace
+
+namespace sway
+{
+//=====================================================================================================================
+bool query::pattern::parse(std::string_view regex)
+{
+    text.clear();
+    any_characters = false;
+    at_start = regex.starts_with('^');
+    if (at_start)
+    {
+        regex.remove_prefix(1);
+    }
+    at_end = regex.ends_with('$') && !regex.ends_with("\\$");
+    if (at_end)
+    {
+        regex.remove_suffix(1);
+    }
+    // .* next to the end, which is not anchored, matches the same as nothing
+    if (regex.starts_with(".*"))
+    {
+        at_start = false;
+        regex.remove_prefix(2);
+    }
+    if (regex.ends_with(".*") && !regex.ends_with("\\.*"))
+    {
+        at_end = false;
+        regex.remove_suffix(2);
+    }
+
+    for (size_t i = 0; i < regex.size(); ++i)
+    {
+        const char c = regex[i];
+        if (c == '\\')
+        {
+            // \d, \w and others are classes, not characters
+            if (i + 1 == regex.size() || std::isalnum(static_cast<unsigned char>(regex[i + 1])))
+            {
+                return false;
+            }
+            text.push_back(regex[++i]);
+        }
+        else if (c == '.')
+        {
+            text.push_back('\0');
+            any_characters = true;
+        }
+        else if (regex_syntax.find(c) != std::string_view::npos)
+        {
+            return false;
+        }
+        else
+        {
+            text.push_back(c);
+        }
+    }
+    return true;
+}
+
+bool query::pattern::matches(std::string_view value) const
+{
+    if (!any_characters)
+    {
+        if (at_start && at_end)
+        {
+            return value == text;
+        }
+        else if (at_start)
+        {
+            return value.starts_with(text);
+        }
+        else if (at_end)
+        {
+            return value.ends_with(text);
+        }
+        return value.find(text) != std::string_view::npos;
+    }
+
+    if (value.size() < text.size())
+    {
+        return false;
+    }
+    auto matches_at = [this, value](size_t offset)
+    {
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            if (text[i] != '\0' && text[i] != value[offset + i])
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (at_start)
+    {
+        return (!at_end || value.size() == text.size()) && matches_at(0);
+    }
+    else if (at_end)
+    {
+        return matches_at(value.size() - text.size());
+    }
+    for (size_t offset = 0; offset + text.size() <= value.size(); ++offset)
+    {
+        if (matches_at(offset))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//=====================================================================================================================
+std::expected<query, error_desc> query::compile(std::string_view criteria)
+{
+    while (!criteria.empty() && is_space(criteria.front()))
+    {
+        criteria.remove_prefix(1);
+    }
+    while (!criteria.empty() && is_space(criteria.back()))
+    {
+        criteria.remove_suffix(1);
+    }
+    if (criteria.starts_with('['))
+    {
+        if (!criteria.ends_with(']'))
+        {
+            return std::unexpected(criteria_error(error_desc::invalid_error_code::invalid_criteria, criteria));
+        }
+        criteria = criteria.substr(1, criteria.size() - 2);
+    }
+
+    query result;
+    size_t position = 0;
+    while (true)
+    {
+        while (position < criteria.size() && is_space(criteria[position]))
+        {
+            ++position;
+        }
+        if (position == criteria.size())
+        {
+            return result;
+        }
+
+        const std::string_view rest = criteria.substr(position);
+        const size_t key_end = rest.find_first_of(" \t=");
+        const std::string_view key = rest.substr(0, key_end);
+        position += key.size();
+
+        std::optional<std::string_view> value;
+        if (position < criteria.size() && criteria[position] == '=')
+        {
+            ++position;
+            if (position < criteria.size() && criteria[position] == '"')
+            {
+                // quote escaped by backslash is part of value, backslash is dropped by regex
+                size_t end = position + 1;
+                while (end < criteria.size() && criteria[end] != '"')
+                {
+                    end += criteria[end] == '\\' ? 2 : 1;
+                }
+                if (end >= criteria.size())
+                {
+                    return std::unexpected(criteria_error(error_desc::invalid_error_code::invalid_criteria, rest));
+                }
+                value = criteria.substr(position + 1, end - position - 1);
+                position = end + 1;
+            }
+            else
+            {
+                const size_t end = std::min(criteria.find_first_of(" \t", position), criteria.size());
+                value = criteria.substr(position, end - position);
+                position = end;
+            }
+        }
+
+        if (key.empty())
+        {
+            return std::unexpected(criteria_error(error_desc::invalid_error_code::invalid_criteria, rest));
+        }
+        std::expected<void, error_desc> added = result.add(key, value);
+        if (!added.has_value())
+        {
+            return std::unexpected(added.error());
+        }
+    }
+}
+
+std::expected<void, error_desc> query::add(std::string_view key, std::optional<std::string_view> value)
+{
+    struct pattern_key
+    {
+        std::string_view name;
+        criterion bit;
+        pattern query::* member;
+    };
+    static constexpr pattern_key pattern_keys[] = {
+        {"app_id", app_id, &query::_app_id},
+        {"class", window_class, &query::_window_class},
+        {"instance", instance, &query::_instance},
+        {"title", title, &query::_title},
+        {"window_role", window_role, &query::_window_role},
+        {"shell", shell, &query::_shell},
+        {"con_mark", con_mark, &query::_con_mark},
+        {"workspace", workspace, &query::_workspace},
+    };
+
+    struct number_key
+    {
+        std::string_view name;
+        criterion bit;
+        int64_t query::* member;
+    };
+    static constexpr number_key number_keys[] = {
+        {"con_id", con_id, &query::_con_id},
+        {"pid", pid, &query::_pid},
+        {"id", window, &query::_window},
+    };
+
+    if (key == "all" || key == "floating" || key == "tiling")
+    {
+        if (value.has_value())
+        {
+            return std::unexpected(criteria_error(error_desc::invalid_error_code::invalid_criteria, key));
+        }
+        _required |= key == "floating" ? floating : key == "tiling" ? tiling : 0;
+        return {};
+    }
+    else if (!value.has_value())
+    {
+        return std::unexpected(criteria_error(error_desc::invalid_error_code::invalid_criteria, key));
+    }
+
+    for (const pattern_key& pattern_key : pattern_keys)
+    {
+        if (pattern_key.name != key)
+        {
+            continue;
+        }
+        // __focused__ means value of focused window, which is not known before the pass
+        if (*value == "__focused__" || !(this->*pattern_key.member).parse(*value))
+        {
+            return std::unexpected(criteria_error(error_desc::invalid_error_code::unsupported_criteria, *value));
+        }
+        _required |= pattern_key.bit;
+        return {};
+    }
+
+    if (key == "con_id" && *value == "__focused__")
+    {
+        _required |= focused;
+        return {};
+    }
+    for (const number_key& number_key : number_keys)
+    {
+        if (number_key.name != key)
+        {
+            continue;
+        }
+        std::optional<int64_t> number = parse_number(*value);
+        if (!number.has_value())
+        {
+            return std::unexpected(criteria_error(error_desc::invalid_error_code::invalid_criteria, *value));
+        }
+        this->*number_key.member = *number;
+        _required |= number_key.bit;
+        return {};
+    }
+
+    return std::unexpected(criteria_error(error_desc::invalid_error_code::unsupported_criteria, key));
+}
+
+//=====================================================================================================================
+struct query::scan
+{
+    // workspace of nodes being scanned
+    struct placement
+    {
+        std::string_view workspace;
+        bool workspace_matches = false;
+    };
+
+    enum class node_type : uint8_t
+    {
+        other,
+        workspace,
+        con,
+        floating_con
+    };
+
+    const query& criteria;
+    size_t limit;
+    std::pmr::vector<query_match>& found;
+
+    bool done() const { return found.size() >= limit; }
+
+    simdjson::error_code children(simdjson::ondemand::value value, placement parent)
+    {
+        simdjson::ondemand::array array;
+        simdjson::error_code error = value.get_array().get(array);
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return error;
+        }
+        for (simdjson::simdjson_result<simdjson::ondemand::value> element_result : array)
+        {
+            simdjson::ondemand::object object;
+            error = element_result.get_object().get(object);
+            if (error == simdjson::error_code::SUCCESS)
+            {
+                error = node(object, parent);
+            }
+            if (error != simdjson::error_code::SUCCESS || done())
+            {
+                return error;
+            }
+        }
+        return simdjson::error_code::SUCCESS;
+    }
+
+    simdjson::error_code window_properties(simdjson::ondemand::value value, query_match& match, uint16_t& satisfied,
+        bool& view)
+    {
+        bool null = false;
+        simdjson::error_code error = value.is_null().get(null);
+        if (error != simdjson::error_code::SUCCESS || null)
+        {
+            return error;
+        }
+        view = true;
+        simdjson::ondemand::object object;
+        error = value.get_object().get(object);
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return error;
+        }
+
+        for (simdjson::simdjson_result<simdjson::ondemand::field> field_result : object)
+        {
+            simdjson::ondemand::field field;
+            error = std::move(field_result).get(field);
+            if (error != simdjson::error_code::SUCCESS)
+            {
+                return error;
+            }
+
+            const simdjson::ondemand::raw_json_string key = field.key();
+            std::optional<std::string_view> property;
+            if (key.unsafe_is_equal("class"))
+            {
+                error = optional_string(field.value(), match.window_class);
+            }
+            else if (key.unsafe_is_equal("instance") && criteria.has(instance))
+            {
+                error = optional_string(field.value(), property);
+                satisfied |= property.has_value() && criteria._instance.matches(*property) ? instance : 0;
+            }
+            else if (key.unsafe_is_equal("window_role") && criteria.has(window_role))
+            {
+                error = optional_string(field.value(), property);
+                satisfied |= property.has_value() && criteria._window_role.matches(*property) ? window_role : 0;
+            }
+            if (error != simdjson::error_code::SUCCESS)
+            {
+                return error;
+            }
+        }
+        return simdjson::error_code::SUCCESS;
+    }
+
+    simdjson::error_code marks(simdjson::ondemand::value value, uint16_t& satisfied)
+    {
+        simdjson::ondemand::array array;
+        simdjson::error_code error = value.get_array().get(array);
+        if (error != simdjson::error_code::SUCCESS)
+        {
+            return error;
+        }
+        for (simdjson::simdjson_result<simdjson::ondemand::value> element_result : array)
+        {
+            std::string_view mark;
+            error = element_result.get_string().get(mark);
+            if (error != simdjson::error_code::SUCCESS)
+            {
+                return error;
+            }
+            satisfied |= criteria._con_mark.matches(mark) ? con_mark : 0;
+        }
+        return simdjson::error_code::SUCCESS;
+    }
+
+    simdjson::error_code node(simdjson::ondemand::object object, placement parent)
+    {
+        query_match match;
+        match.workspace = parent.workspace;
+        node_type type = node_type::other;
+        uint16_t satisfied = 0;
+        // xwayland window has window_properties, the other views have app_id
+        bool view = false;
+        std::optional<placement> inside;
+
+        for (simdjson::simdjson_result<simdjson::ondemand::field> field_result : object)
+        {
+            simdjson::ondemand::field field;
+            simdjson::error_code error = std::move(field_result).get(field);
+            if (error != simdjson::error_code::SUCCESS)
+            {
+                return error;
+            }
+
+            // keys of sway have nothing to unescape, so raw key is compared as is
+            const simdjson::ondemand::raw_json_string key = field.key();
+            if (key.unsafe_is_equal("id"))
+            {
+                error = field.value().get_int64().get(match.id);
+            }
+            else if (key.unsafe_is_equal("type"))
+            {
+                std::string_view type_name;
+                error = field.value().get_string().get(type_name);
+                type = type_name == "workspace" ? node_type::workspace :
+                    type_name == "con" ? node_type::con :
+                    type_name == "floating_con" ? node_type::floating_con : node_type::other;
+            }
+            else if (key.unsafe_is_equal("focused"))
+            {
+                error = field.value().get_bool().get(match.focused);
+            }
+            else if (key.unsafe_is_equal("name"))
+            {
+                error = optional_string(field.value(), match.name);
+            }
+            else if (key.unsafe_is_equal("marks") && criteria.has(con_mark))
+            {
+                error = marks(field.value(), satisfied);
+            }
+            else if (key.unsafe_is_equal("window") && criteria.has(window))
+            {
+                std::optional<int64_t> window_id;
+                error = optional_number(field.value(), window_id);
+                satisfied |= window_id == criteria._window ? window : 0;
+            }
+            else if (key.unsafe_is_equal("nodes") || key.unsafe_is_equal("floating_nodes"))
+            {
+                // name of workspace is written before its children
+                if (!inside.has_value())
+                {
+                    inside = type != node_type::workspace ? parent : placement{match.name.value_or(""),
+                        !criteria.has(workspace) || criteria._workspace.matches(match.name.value_or(""))};
+                }
+                const bool tiling_part = key.unsafe_is_equal("nodes");
+                const bool skipped = type == node_type::workspace &&
+                    (!inside->workspace_matches || (tiling_part && criteria.has(floating)));
+                if (!skipped)
+                {
+                    error = children(field.value(), *inside);
+                }
+                if (error != simdjson::error_code::SUCCESS || done())
+                {
+                    return error;
+                }
+            }
+            else if (key.unsafe_is_equal("pid"))
+            {
+                error = optional_number(field.value(), match.pid);
+            }
+            else if (key.unsafe_is_equal("app_id"))
+            {
+                error = optional_string(field.value(), match.app_id);
+            }
+            else if (key.unsafe_is_equal("shell") && criteria.has(shell))
+            {
+                std::optional<std::string_view> shell_name;
+                error = optional_string(field.value(), shell_name);
+                satisfied |= shell_name.has_value() && criteria._shell.matches(*shell_name) ? shell : 0;
+            }
+            else if (key.unsafe_is_equal("window_properties"))
+            {
+                error = window_properties(field.value(), match, satisfied, view);
+            }
+
+            if (error != simdjson::error_code::SUCCESS)
+            {
+                return error;
+            }
+        }
+
+        // split containers are con too, but criteria of sway match views only. Otherwise
+        // parent of window could match criteria like workspace or floating before window itself
+        view = view || match.pid.has_value() || match.app_id.has_value();
+        if ((type != node_type::con && type != node_type::floating_con) || !view)
+        {
+            return simdjson::error_code::SUCCESS;
+        }
+        match.floating = type == node_type::floating_con;
+        satisfied |= match.floating ? floating : tiling;
+        satisfied |= match.focused ? focused : 0;
+        satisfied |= match.id == criteria._con_id ? con_id : 0;
+        satisfied |= match.pid == criteria._pid ? pid : 0;
+        satisfied |= !parent.workspace.empty() && parent.workspace_matches ? workspace : 0;
+        if (criteria.has(app_id) && match.app_id.has_value() && criteria._app_id.matches(*match.app_id))
+        {
+            satisfied |= app_id;
+        }
+        if (criteria.has(window_class) && match.window_class.has_value() &&
+            criteria._window_class.matches(*match.window_class))
+        {
+            satisfied |= window_class;
+        }
+        if (criteria.has(title) && match.name.has_value() && criteria._title.matches(*match.name))
+        {
+            satisfied |= title;
+        }
+
+        if ((satisfied & criteria._required) == criteria._required)
+        {
+            found.push_back(match);
+        }
+        return simdjson::error_code::SUCCESS;
+    }
+};
+
+std::expected<std::pmr::vector<query_match>, error_desc> query::find(simdjson::ondemand::document& tree,
+    size_t limit, std::pmr::memory_resource* resource) const
+{
+    std::pmr::vector<query_match> found(resource);
+    if (limit == 0)
+    {
+        return found;
+    }
+
+    simdjson::ondemand::object root;
+    simdjson::error_code error = tree.get_object().get(root);
+    if (error == simdjson::error_code::SUCCESS)
+    {
+        error = scan{*this, limit, found}.node(root, {});
+    }
+    if (error != simdjson::error_code::SUCCESS)
+    {
+        return std::unexpected(error_desc(error, error_desc::operation::decode_json));
+    }
+    return found;
+}
+
+std::expected<std::optional<query_match>, error_desc> query::find_first(simdjson::ondemand::document& tree) const
+{
+    // one match fits into buffer on stack
+    alignas(query_match) std::byte buffer[sizeof(query_match) * 2];
+    std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+    return find(tree, 1, &resource).transform([](std::pmr::vector<query_match> found)
+    {
+        return found.empty() ? std::nullopt : std::optional<query_match>(found.front());
+    });
+}
+
+std::expected<std::optional<query_match>, error_desc> query::match_window_event(
+    simdjson::ondemand::document& event) const
+{
+    alignas(query_match) std::byte buffer[sizeof(query_match) * 2];
+    std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+    std::pmr::vector<query_match> found(&resource);
+
+    event.rewind();
+    simdjson::ondemand::object container;
+    simdjson::error_code error = event.find_field("container").get_object().get(container);
+    if (error == simdjson::error_code::SUCCESS)
+    {
+        error = scan{*this, 1, found}.node(container, {});
+    }
+    if (error != simdjson::error_code::SUCCESS)
+    {
+        return std::unexpected(error_desc(error, error_desc::operation::decode_json));
+    }
+    return found.empty() ? std::nullopt : std::optional<query_match>(found.front());
+}
+} // namespace sway
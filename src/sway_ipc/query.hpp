@@ -0,0 +1,115 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <simdjson.h>
+#include <cstdint>
+#include <expected>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// sway criteria (CRITERIA in sway(5)), like [app_id="firefox" floating], matched against GET_TREE reply.
+// Criteria string is compiled once, and then each find is one forward pass over ondemand document,
+// without decoding it into sway::node. Subtrees, which can not have match, are skipped (workspaces
+// not matching workspace criterion, tiling part of workspace for floating), and the pass stops as soon
+// as limit of matches is found. Since children come before fields of window in sway json, parent
+// is matched after its children. Like in sway, only views match, and not split containers.
+//
+// Supported keys are all, app_id, class, instance, title, window_role, shell, con_mark, workspace,
+// con_id (number or __focused__), pid, id, floating and tiling. Sway matches values as regex without
+// anchors, this matches them the same way, but knows only part of regex: escaped characters, "."
+// as any character, ^ and $ anchors, and .* at the start and at the end of value
+
+namespace sway
+{
+// container found by query. Strings point into parser, and are valid until it is used again
+struct query_match
+{
+    int64_t id = 0;
+    std::optional<std::string_view> name;
+    std::optional<std::string_view> app_id;
+    // xwayland only
+    std::optional<std::string_view> window_class;
+    std::optional<int> pid;
+    // name of workspace with container, __i3_scratch for scratchpad
+    std::string_view workspace;
+    bool floating = false;
+    bool focused = false;
+};
+
+class query
+{
+public:
+    static constexpr size_t no_limit = std::numeric_limits<size_t>::max();
+
+    // brackets around criteria are optional
+    static std::expected<query, error_desc> compile(std::string_view criteria);
+
+    // matches are in arena when resource is reply_arena() of ipc, as decode_with does
+    std::expected<std::pmr::vector<query_match>, error_desc> find(simdjson::ondemand::document& tree,
+        size_t limit = no_limit, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+    // stops at the first match
+    std::expected<std::optional<query_match>, error_desc> find_first(simdjson::ondemand::document& tree) const;
+    // matches container of window event, without tree. Event does not say where container is, so
+    // workspace criterion never matches. Document is rewound first, so many queries can match one event
+    std::expected<std::optional<query_match>, error_desc> match_window_event(
+        simdjson::ondemand::document& event) const;
+
+private:
+    // value of criterion, with the part of regex which can be matched without regex engine
+    struct pattern
+    {
+        // '\0' is any character
+        std::string text;
+        bool any_characters = false;
+        bool at_start = false;
+        bool at_end = false;
+
+        // false if regex has syntax which is not supported
+        bool parse(std::string_view regex);
+        bool matches(std::string_view value) const;
+    };
+
+    // bit for each criterion, query matches when all its bits are set by container
+    enum criterion : uint16_t
+    {
+        app_id = 1 << 0,
+        window_class = 1 << 1,
+        instance = 1 << 2,
+        title = 1 << 3,
+        window_role = 1 << 4,
+        shell = 1 << 5,
+        con_mark = 1 << 6,
+        workspace = 1 << 7,
+        con_id = 1 << 8,
+        focused = 1 << 9,
+        pid = 1 << 10,
+        window = 1 << 11,
+        floating = 1 << 12,
+        tiling = 1 << 13
+    };
+
+    // one pass over tree, defined with find
+    struct scan;
+
+    query() = default;
+
+    bool has(criterion criterion) const { return (_required & criterion) != 0; }
+    std::expected<void, error_desc> add(std::string_view key, std::optional<std::string_view> value);
+
+    uint16_t _required = 0;
+    pattern _app_id;
+    pattern _window_class;
+    pattern _instance;
+    pattern _title;
+    pattern _window_role;
+    pattern _shell;
+    pattern _con_mark;
+    pattern _workspace;
+    int64_t _con_id = 0;
+    int64_t _pid = 0;
+    int64_t _window = 0;
+};
+} // namespace sway
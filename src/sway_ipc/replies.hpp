@@ -0,0 +1,250 @@
+#pragma once
+#include <sway_ipc/decode.hpp>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// typed replies of sway, described in sway-ipc(7). Only fields used in practice are
+// here, add more to struct and its schema when needed. Arrays are std::pmr::vector, so
+// decode_with can put decoded tree into arena of ipc, instead of hundreds of small allocations
+
+namespace sway
+{
+struct rect
+{
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+template <>
+inline constexpr auto schema<rect> = std::tuple{
+    field{"x", &rect::x},
+    field{"y", &rect::y},
+    field{"width", &rect::width},
+    field{"height", &rect::height},
+};
+
+// element of RUN_COMMAND reply
+struct command_result
+{
+    bool success = false;
+    std::optional<bool> parse_error;
+    std::string_view error;
+};
+
+template <>
+inline constexpr auto schema<command_result> = std::tuple{
+    field{"success", &command_result::success},
+    field{"parse_error", &command_result::parse_error},
+    field{"error", &command_result::error},
+};
+
+// element of GET_WORKSPACES reply, also used in workspace event
+struct workspace
+{
+    int64_t id = 0;
+    int num = -1;
+    std::string_view name;
+    std::string_view output;
+    std::string_view layout;
+    bool visible = false;
+    bool focused = false;
+    bool urgent = false;
+    sway::rect rect;
+};
+
+template <>
+inline constexpr auto schema<workspace> = std::tuple{
+    field{"id", &workspace::id},
+    field{"num", &workspace::num},
+    field{"name", &workspace::name},
+    field{"output", &workspace::output},
+    field{"layout", &workspace::layout},
+    field{"visible", &workspace::visible},
+    field{"focused", &workspace::focused},
+    field{"urgent", &workspace::urgent},
+    field{"rect", &workspace::rect},
+};
+
+// element of GET_WORKSPACES reply as served by ipc::cached_workspaces. It has no layout: layout
+// command changes it without any event, so cached one could be stale
+struct cached_workspace
+{
+    int64_t id = 0;
+    int num = -1;
+    std::string_view name;
+    std::string_view output;
+    bool visible = false;
+    bool focused = false;
+    bool urgent = false;
+    sway::rect rect;
+};
+
+template <>
+inline constexpr auto schema<cached_workspace> = std::tuple{
+    field{"id", &cached_workspace::id},
+    field{"num", &cached_workspace::num},
+    field{"name", &cached_workspace::name},
+    field{"output", &cached_workspace::output},
+    field{"visible", &cached_workspace::visible},
+    field{"focused", &cached_workspace::focused},
+    field{"urgent", &cached_workspace::urgent},
+    field{"rect", &cached_workspace::rect},
+};
+
+struct output_mode
+{
+    int width = 0;
+    int height = 0;
+    // in mHz
+    int refresh = 0;
+};
+
+template <>
+inline constexpr auto schema<output_mode> = std::tuple{
+    field{"width", &output_mode::width},
+    field{"height", &output_mode::height},
+    field{"refresh", &output_mode::refresh},
+};
+
+// element of GET_OUTPUTS reply
+struct output
+{
+    std::string_view name;
+    std::string_view make;
+    std::string_view model;
+    std::string_view serial;
+    bool active = false;
+    bool power = false;
+    bool focused = false;
+    double scale = 1.0;
+    std::string_view transform;
+    std::optional<std::string_view> current_workspace;
+    std::pmr::vector<output_mode> modes;
+    output_mode current_mode;
+    sway::rect rect;
+};
+
+template <>
+inline constexpr auto schema<output> = std::tuple{
+    field{"name", &output::name},
+    field{"make", &output::make},
+    field{"model", &output::model},
+    field{"serial", &output::serial},
+    field{"active", &output::active},
+    field{"power", &output::power},
+    field{"focused", &output::focused},
+    field{"scale", &output::scale},
+    field{"transform", &output::transform},
+    field{"current_workspace", &output::current_workspace},
+    field{"modes", &output::modes},
+    field{"current_mode", &output::current_mode},
+    field{"rect", &output::rect},
+};
+
+// xwayland only
+struct window_properties
+{
+    std::string_view title;
+    std::string_view window_class;
+    std::string_view instance;
+    std::string_view window_role;
+};
+
+template <>
+inline constexpr auto schema<window_properties> = std::tuple{
+    field{"title", &window_properties::title},
+    field{"class", &window_properties::window_class},
+    field{"instance", &window_properties::instance},
+    field{"window_role", &window_properties::window_role},
+};
+
+// GET_TREE reply is root node, also used in window event
+struct node
+{
+    int64_t id = 0;
+    std::optional<std::string_view> name;
+    // root, output, workspace, con or floating_con
+    std::string_view type;
+    std::string_view layout;
+    std::string_view orientation;
+    // none, fresh or changed, only in windows
+    std::optional<std::string_view> scratchpad_state;
+    bool focused = false;
+    bool urgent = false;
+    bool sticky = false;
+    std::optional<bool> visible;
+    int fullscreen_mode = 0;
+    std::optional<int> pid;
+    // null for xwayland windows
+    std::optional<std::string_view> app_id;
+    std::optional<int64_t> window;
+    std::optional<sway::window_properties> window_properties;
+    std::optional<std::string_view> shell;
+    sway::rect rect;
+    std::pmr::vector<std::string_view> marks;
+    std::pmr::vector<int64_t> focus;
+    std::pmr::vector<node> nodes;
+    std::pmr::vector<node> floating_nodes;
+};
+
+template <>
+inline constexpr auto schema<node> = std::tuple{
+    field{"id", &node::id},
+    field{"name", &node::name},
+    field{"type", &node::type},
+    field{"layout", &node::layout},
+    field{"orientation", &node::orientation},
+    field{"scratchpad_state", &node::scratchpad_state},
+    field{"focused", &node::focused},
+    field{"urgent", &node::urgent},
+    field{"sticky", &node::sticky},
+    field{"visible", &node::visible},
+    field{"fullscreen_mode", &node::fullscreen_mode},
+    field{"pid", &node::pid},
+    field{"app_id", &node::app_id},
+    field{"window", &node::window},
+    field{"window_properties", &node::window_properties},
+    field{"shell", &node::shell},
+    field{"rect", &node::rect},
+    field{"marks", &node::marks},
+    field{"focus", &node::focus},
+    field{"nodes", &node::nodes},
+    field{"floating_nodes", &node::floating_nodes},
+};
+
+// GET_VERSION reply
+struct version
+{
+    int major = 0;
+    int minor = 0;
+    int patch = 0;
+    std::string_view human_readable;
+    std::string_view loaded_config_file_name;
+};
+
+template <>
+inline constexpr auto schema<version> = std::tuple{
+    field{"major", &version::major},
+    field{"minor", &version::minor},
+    field{"patch", &version::patch},
+    field{"human_readable", &version::human_readable},
+    field{"loaded_config_file_name", &version::loaded_config_file_name},
+};
+
+// GET_BINDING_STATE reply
+struct binding_state
+{
+    std::string_view name;
+};
+
+template <>
+inline constexpr auto schema<binding_state> = std::tuple{
+    field{"name", &binding_state::name},
+};
+} // namespace sway
@@ -0,0 +1,157 @@
+#include <sway_ipc/scratchpad_tracker.hpp>
+#include <sway_ipc/decode.hpp>
+#include <sway_ipc/events/events.hpp>
+#include <sway_ipc/replies.hpp>
+#include <sway_ipc/sway_ipc.hpp>
+#include <algorithm>
+
+namespace
+{
+const sway::node* find_child(std::span<const sway::node> nodes, std::string_view name)
+{
+    auto it = std::ranges::find_if(nodes, [name](const sway::node& node)
+    {
+        return node.name == name;
+    });
+    return it == nodes.end() ? nullptr : &*it;
+}
+
+void set_window(sway::scratchpad_tracker::window& window, const sway::node& container)
+{
+    window.id = container.id;
+    if (container.app_id.has_value())
+    {
+        window.app = container.app_id.value();
+    }
+    else if (container.window_properties.has_value())
+    {
+        window.app = container.window_properties->window_class;
+    }
+    window.title = container.name.value_or(std::string_view());
+}
+} // namespace
+
+namespace sway
+{
+std::expected<void, error_desc> scratchpad_tracker::rebuild(ipc& ipc)
+{
+    // decoded tree is needed only here, so it goes into reply arena
+    return ipc.get_tree().and_then(decode_with<sway::node>(ipc.reply_arena())).transform([this](sway::node root)
+    {
+        _hidden.clear();
+        // scratchpad is a workspace __i3_scratch on a fake output __i3.
+        // Windows shown from scratchpad are on ordinary workspaces, and are not counted
+        const sway::node* output = find_child(root.nodes, "__i3");
+        const sway::node* workspace = output == nullptr ? nullptr : find_child(output->nodes, "__i3_scratch");
+        if (workspace != nullptr)
+        {
+            for (const sway::node& container : workspace->floating_nodes)
+            {
+                insert(container);
+            }
+        }
+        _stale = false;
+    });
+}
+
+std::expected<void, error_desc> scratchpad_tracker::sync(ipc& ipc)
+{
+    if (!_stale)
+    {
+        return {};
+    }
+    return rebuild(ipc);
+}
+
+bool scratchpad_tracker::apply(event_type event_type, simdjson::ondemand::document json)
+{
+    if (event_type == event_type::window)
+    {
+        std::expected<window_event, error_desc> event = decode<window_event>(std::move(json));
+        _stale = _stale || !event.has_value();
+        return event.has_value() && apply(event.value());
+    }
+    return !_stale;
+}
+
+bool scratchpad_tracker::apply(const window_event& event)
+{
+    // when stale there is nothing to patch, tree will be fetched anyway
+    _stale = _stale || !apply_window(event);
+    return !_stale;
+}
+
+bool scratchpad_tracker::apply_window(const window_event& event)
+{
+    const sway::node& container = event.container;
+    const bool in_scratchpad = container.scratchpad_state.has_value() && container.scratchpad_state != "none";
+    const bool visible = container.visible.value_or(false);
+
+    if (event.change == "move")
+    {
+        // sent by move scratchpad, and when scratchpad show hides window back.
+        // Shown window is put on a visible workspace, and is visible right away
+        if (in_scratchpad && !visible)
+        {
+            insert(container);
+        }
+        else
+        {
+            erase(container.id);
+        }
+        return true;
+    }
+    else if (event.change == "close" || event.change == "focus")
+    {
+        // hidden window is shown before it gets focus
+        erase(container.id);
+        return true;
+    }
+    else if (event.change == "new")
+    {
+        // new window is never in scratchpad, for_window rules send move afterwards
+        return true;
+    }
+
+    // title, urgent, mark and others do not move window, but still say whether it is hidden.
+    // Window which is not tracked could be either hidden, or shown from scratchpad onto workspace
+    // which is not visible, so only tracked ones can be checked
+    window* tracked = find(container.id);
+    if (tracked == nullptr)
+    {
+        return true;
+    }
+    else if (!in_scratchpad || visible)
+    {
+        return false;
+    }
+    set_window(*tracked, container);
+    return true;
+}
+
+scratchpad_tracker::window* scratchpad_tracker::find(int64_t id)
+{
+    auto it = std::ranges::find(_hidden, id, &window::id);
+    return it == _hidden.end() ? nullptr : &*it;
+}
+
+void scratchpad_tracker::insert(const sway::node& container)
+{
+    window* tracked = find(container.id);
+    if (tracked == nullptr)
+    {
+        tracked = &_hidden.emplace_back();
+    }
+    set_window(*tracked, container);
+}
+
+void scratchpad_tracker::erase(int64_t id)
+{
+    auto it = std::ranges::find(_hidden, id, &window::id);
+    if (it != _hidden.end())
+    {
+        *it = std::move(_hidden.back());
+        _hidden.pop_back();
+    }
+}
+} // namespace sway
@@ -0,0 +1,64 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <sway_ipc/events/event_type.hpp>
+#include <simdjson.h>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace sway
+{
+class ipc;
+struct node;
+struct window_event;
+
+// ids of windows hidden in scratchpad, kept by container of window events alone. Unlike
+// tree_cache, it does not care where other windows are, so moves of ordinary windows cost
+// nothing, and tree is fetched only on start, and when event contradicts what is tracked
+class scratchpad_tracker
+{
+public:
+    struct window
+    {
+        int64_t id = 0;
+        // app_id, or class of xwayland window
+        std::string app;
+        std::string title;
+    };
+
+    // empty and stale until first sync
+    scratchpad_tracker() = default;
+
+    // fetches tree with get_tree of ipc, and takes hidden windows from __i3_scratch
+    std::expected<void, error_desc> rebuild(ipc& ipc);
+    // rebuilds only if tracker is stale
+    std::expected<void, error_desc> sync(ipc& ipc);
+    bool stale() const { return _stale; }
+    // for when events could be missed, like after reconnect
+    void invalidate() { _stale = true; }
+
+    // Returns false if event contradicts tracked state, tracker is stale after that until sync.
+    // Events other than window are ignored
+    bool apply(event_type event_type, simdjson::ondemand::document json);
+    // same, for event already decoded
+    bool apply(const window_event& event);
+
+    // in no particular order
+    std::span<const window> hidden() const { return _hidden; }
+    size_t size() const { return _hidden.size(); }
+    bool empty() const { return _hidden.empty(); }
+
+private:
+    bool apply_window(const window_event& event);
+    window* find(int64_t id);
+    void insert(const sway::node& container);
+    void erase(int64_t id);
+
+    // scratchpad rarely has more than a few windows, vector is faster than any set here
+    std::vector<window> _hidden;
+    bool _stale = true;
+};
+} // namespace sway
@@ -0,0 +1,179 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// State of sway, published by sway::state_publisher into shared memory.
+// Header only, and does not need sway_ipc or simdjson, so anything can read sway state
+// without its own connection to sway: no syscalls after open, no json
+
+namespace sway
+{
+inline constexpr uint32_t shared_state_magic = 0x79617773; // "sway"
+// bumped when layout changes, reader refuses region of other version
+inline constexpr uint32_t shared_state_version = 2;
+
+// strings are null terminated, unless they take the whole array. Longer ones are cut
+inline constexpr size_t shared_name_size = 64;
+inline constexpr size_t shared_max_outputs = 8;
+
+struct shared_output
+{
+    char name[shared_name_size];
+    char current_workspace[shared_name_size];
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    uint8_t active;
+    uint8_t focused;
+    uint8_t padding[6];
+};
+
+// everything reader gets in one consistent copy
+struct state_snapshot
+{
+    char focused_workspace[shared_name_size];
+    char focused_output[shared_name_size];
+    // "default" if no mode is active
+    char mode[shared_name_size];
+    // app_id, or class of xwayland window, and title of focused window. Empty if workspace is focused
+    char focused_app[shared_name_size];
+    char focused_title[shared_name_size];
+    uint32_t scratchpad_count;
+    // outputs past shared_max_outputs are not published
+    uint32_t output_count;
+    shared_output outputs[shared_max_outputs];
+};
+
+// whole shared memory region. Sequence is odd while publisher writes snapshot
+struct shared_state_region
+{
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> sequence;
+    uint32_t padding;
+    state_snapshot state;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+template <size_t N>
+std::string_view shared_string(const char (&string)[N])
+{
+    return std::string_view(string, strnlen(string, N));
+}
+
+// name for shm_open, one per user
+inline std::string shared_state_name()
+{
+    return "/sway-state." + std::to_string(::getuid());
+}
+
+// maps region created by publisher read only. Errors are errno values, since
+// reader does not link sway_ipc: ENOENT means that no publisher was started yet,
+// EPERM that region was not created by this user
+class shared_state_reader
+{
+public:
+    ~shared_state_reader()
+    {
+        if (_region != nullptr)
+        {
+            ::munmap(const_cast<shared_state_region*>(_region), sizeof(shared_state_region));
+        }
+    }
+
+    shared_state_reader(const shared_state_reader&) = delete;
+    shared_state_reader& operator=(const shared_state_reader&) = delete;
+    shared_state_reader(shared_state_reader&& other) : _region(std::exchange(other._region, nullptr)) {}
+    shared_state_reader& operator=(shared_state_reader&& other) = delete;
+
+    static std::expected<shared_state_reader, int> open(const std::string& name = shared_state_name())
+    {
+        const int fd = ::shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+        if (fd == -1)
+        {
+            return std::unexpected(errno);
+        }
+        struct stat file_stat;
+        if (::fstat(fd, &file_stat) == -1)
+        {
+            const int error = errno;
+            ::close(fd);
+            return std::unexpected(error);
+        }
+        else if (file_stat.st_uid != ::getuid())
+        {
+            // anybody could create region with our name, and feed us made up state
+            ::close(fd);
+            return std::unexpected(EPERM);
+        }
+        else if (file_stat.st_size < static_cast<off_t>(sizeof(shared_state_region)))
+        {
+            // publisher did not resize region yet
+            ::close(fd);
+            return std::unexpected(ENODATA);
+        }
+        void* memory = ::mmap(nullptr, sizeof(shared_state_region), PROT_READ, MAP_SHARED, fd, 0);
+        const int error = errno;
+        // mapping stays valid after fd is closed
+        ::close(fd);
+        if (memory == MAP_FAILED)
+        {
+            return std::unexpected(error);
+        }
+
+        shared_state_reader reader(static_cast<const shared_state_region*>(memory));
+        // magic is zero until publisher initialised region
+        if (reader._region->magic != shared_state_magic || reader._region->version != shared_state_version)
+        {
+            return std::unexpected(EPROTO);
+        }
+        return reader;
+    }
+
+    // bumped by every publish, can be compared to skip reads when nothing changed
+    uint32_t sequence() const
+    {
+        return _region->sequence.load(std::memory_order_acquire);
+    }
+
+    // copies consistent snapshot, retrying while publisher writes. Returns its sequence, or EAGAIN after
+    // max_attempts reads: publisher which died in the middle of publish leaves sequence odd, until the
+    // next publisher opens region
+    std::expected<uint32_t, int> read(state_snapshot& out, size_t max_attempts = 100000) const
+    {
+        for (size_t attempt = 0; attempt < max_attempts; ++attempt)
+        {
+            const uint32_t before = _region->sequence.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                continue;
+            }
+            // copy may be torn, it is thrown away then, and never looked at
+            std::memcpy(&out, &_region->state, sizeof(state_snapshot));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_region->sequence.load(std::memory_order_relaxed) == before)
+            {
+                return before;
+            }
+        }
+        return std::unexpected(EAGAIN);
+    }
+
+private:
+    explicit shared_state_reader(const shared_state_region* region) : _region(region) {}
+
+    const shared_state_region* _region = nullptr;
+};
+} // namespace sway
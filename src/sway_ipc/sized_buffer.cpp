@@ -1,18 +1,147 @@
 #include <sway_ipc/sized_buffer.hpp>
+#include <algorithm>
 #include <bit>
-#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+#include <sys/mman.h>
+
+namespace
+{
+bool is_mapped(size_t size)
+{
+    return size >= sized_buffer::huge_page_size;
+}
+
+// power of two, so growth is geometric. Mapped sizes are multiples of huge page this way
+size_t rounded_size(size_t size)
+{
+    return std::bit_ceil(size);
+}
+
+char* map(size_t size)
+{
+    void* memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        // the same as failed new, without exceptions
+        std::abort();
+    }
+    // only advice, transparent huge pages could be disabled
+    ::madvise(memory, size, MADV_HUGEPAGE);
+    return static_cast<char*>(memory);
+}
+
+void release(char* buffer, size_t size)
+{
+    if (buffer == nullptr)
+    {
+        return;
+    }
+    if (is_mapped(size))
+    {
+        ::munmap(buffer, size);
+    }
+    else
+    {
+        std::free(buffer);
+    }
+}
+} // namespace
+
+thread_local size_t sized_buffer::_thread_reallocations = 0;
+
+sized_buffer::~sized_buffer()
+{
+    release(_buffer, _size);
+}
+
+sized_buffer::sized_buffer(sized_buffer&& other)
+    : _buffer(std::exchange(other._buffer, nullptr))
+    , _size(std::exchange(other._size, 0))
+    , _high_water(std::exchange(other._high_water, 0))
+{
+}
+
+sized_buffer& sized_buffer::operator=(sized_buffer&& other)
+{
+    if (this != &other)
+    {
+        release(_buffer, _size);
+        _buffer = std::exchange(other._buffer, nullptr);
+        _size = std::exchange(other._size, 0);
+        _high_water = std::exchange(other._high_water, 0);
+    }
+    return *this;
+}
 
 void sized_buffer::allocate(size_t new_size)
 {
+    grow(new_size, 0);
+}
+
+void sized_buffer::grow(size_t new_size, size_t keep)
+{
+    _high_water = std::max(_high_water, new_size);
     if (new_size <= _size)
     {
         return;
     }
+    reallocate(rounded_size(new_size), keep);
+}
 
-    // if read_size was 0, function should return earlier
-    const int leading_zeros = std::countl_zero(new_size - 1);
-    const int log = sizeof(new_size) * CHAR_BIT - leading_zeros;
-    _size = 1 << log;
+void sized_buffer::shrink(size_t keep)
+{
+    const size_t needed = std::max(_high_water, keep);
+    const size_t new_size = needed == 0 ? 0 : rounded_size(needed);
+    if (new_size < _size)
+    {
+        reallocate(new_size, keep);
+    }
+    _high_water = keep;
+}
 
-    _buffer = std::make_unique_for_overwrite<char[]>(_size);
+size_t sized_buffer::thread_reallocations()
+{
+    return _thread_reallocations;
+}
+
+void sized_buffer::reallocate(size_t new_size, size_t keep)
+{
+    ++_thread_reallocations;
+    keep = std::min({keep, _size, new_size});
+    if (new_size == 0)
+    {
+        release(_buffer, _size);
+        _buffer = nullptr;
+        _size = 0;
+        return;
+    }
+
+    if (is_mapped(_size) && is_mapped(new_size))
+    {
+        // kernel moves pages, so big buffer grows without copying its content
+        void* memory = ::mremap(_buffer, _size, new_size, MREMAP_MAYMOVE);
+        if (memory == MAP_FAILED)
+        {
+            std::abort();
+        }
+        ::madvise(memory, new_size, MADV_HUGEPAGE);
+        _buffer = static_cast<char*>(memory);
+        _size = new_size;
+        return;
+    }
+
+    char* buffer = is_mapped(new_size) ? map(new_size) : static_cast<char*>(std::malloc(new_size));
+    if (buffer == nullptr)
+    {
+        std::abort();
+    }
+    if (keep != 0)
+    {
+        std::memcpy(buffer, _buffer, keep);
+    }
+    release(_buffer, _size);
+    _buffer = buffer;
+    _size = new_size;
 }
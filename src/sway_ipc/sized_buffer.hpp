@@ -1,17 +1,52 @@
 #pragma once
-#include <memory>
+#include <cstddef>
 
+// receive buffer, reused between messages. Grows geometrically, so stream of growing replies
+// reallocates only a few times. Buffers of huge_page_size and more are mapped with mmap and
+// advised to be backed by huge pages, and grow with mremap, which moves pages instead of bytes.
+// Largest size asked for is remembered, so memory taken by one big tree can be given back later
 class sized_buffer
 {
 public:
-    char* ptr() { return _buffer.get(); };
-    const char* ptr() const { return _buffer.get(); }
+    // buffers of this size and bigger are mapped, and rounded to it
+    static constexpr size_t huge_page_size = size_t(2) << 20;
 
-    size_t size() { return _size; }
+    sized_buffer() = default;
+    ~sized_buffer();
 
-    void allocate(size_t newSize);
+    sized_buffer(const sized_buffer&) = delete;
+    sized_buffer& operator=(const sized_buffer&) = delete;
+    sized_buffer(sized_buffer&& other);
+    sized_buffer& operator=(sized_buffer&& other);
+
+    char* ptr() { return _buffer; };
+    const char* ptr() const { return _buffer; }
+
+    size_t size() const { return _size; }
+
+    // content is not kept
+    void allocate(size_t new_size);
+    // first keep bytes stay in buffer
+    void grow(size_t new_size, size_t keep);
+
+    // the biggest size asked for since the last shrink
+    size_t high_water() const { return _high_water; }
+    // releases memory above high water mark, keeping first keep bytes, and starts counting
+    // high water mark again. Meant to be called when buffer was not used for a while
+    void shrink(size_t keep);
+
+    // reallocations of all buffers made by calling thread, shrinks included. Memory is taken by malloc
+    // and mmap, which replaced operator new does not see, so benchmarks check this to tell that steady
+    // state does not grow buffers
+    static size_t thread_reallocations();
 
 private:
-    std::unique_ptr<char[]> _buffer;
+    // reallocates to exactly new_size, new_size is already rounded
+    void reallocate(size_t new_size, size_t keep);
+
+    static thread_local size_t _thread_reallocations;
+
+    char* _buffer = nullptr;
     size_t _size = 0;
+    size_t _high_water = 0;
 };
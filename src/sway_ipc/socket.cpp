@@ -0,0 +1,313 @@
+#include <sway_ipc/socket.hpp>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace
+{
+std::expected<FILE*, sway::error_desc> start_sway_getsocketpath()
+{
+    constexpr static const char* swayCommand = "sway --get-socketpath";
+
+    FILE* socket_path_desc = popen(swayCommand, "r");
+    if (!socket_path_desc) [[unlikely]]
+    {
+        return std::unexpected{sway::error_desc{sway::error_desc::operation::start_get_socketpath}};
+    }
+    return socket_path_desc;
+}
+
+struct read_socket_result
+{
+    FILE* socket;
+    size_t last_read_size;
+    std::vector<std::array<char, PIPE_BUF>> pipe_data;
+};
+
+std::expected<read_socket_result, sway::error_desc> read_sway_socket(FILE* socket_path_desc)
+{
+    read_socket_result read_socket;
+    read_socket.socket = socket_path_desc;
+    std::vector<std::array<char, PIPE_BUF>>& pipe_data = read_socket.pipe_data;
+
+    size_t& last_read_size = read_socket.last_read_size;
+    do
+    {
+        std::array<char, PIPE_BUF>* currentPipeData = &pipe_data.emplace_back();
+        last_read_size = fread(currentPipeData->data(),
+            sizeof(char), PIPE_BUF, socket_path_desc);
+    }
+    while (last_read_size == PIPE_BUF);
+
+    if (ferror(socket_path_desc)) [[unlikely]]
+    {
+        return std::unexpected{sway::error_desc{sway::error_desc::operation::read_get_socketpath}};
+    }
+
+    return std::move(read_socket);
+}
+
+struct close_sway_socket_result
+{
+    int socket_path_desc;
+    size_t last_read_size;
+    std::vector<std::array<char, PIPE_BUF>> pipe_data;
+};
+
+std::expected<close_sway_socket_result, sway::error_desc>
+close_sway_socket(const read_socket_result context)
+{
+    FILE* socket_path_desc = context.socket;
+
+    close_sway_socket_result close_socket;
+    close_socket.pipe_data = std::move(context.pipe_data);
+    close_socket.last_read_size = context.last_read_size;
+
+    int& sway_exit_code = close_socket.socket_path_desc;
+    if (sway_exit_code = pclose(socket_path_desc); sway_exit_code != 0) [[unlikely]]
+    {
+        if (errno == ECHILD)
+        {
+            return std::unexpected{sway::error_desc{sway::error_desc::operation::wait_get_socketpath}};
+        }
+    }
+
+    return std::move(close_socket);
+}
+
+struct socket_path
+{
+    std::unique_ptr<char[]> path_memory;
+    size_t size;
+};
+
+std::expected<socket_path, sway::error_desc>
+combine_pipe_data(const close_sway_socket_result context)
+{
+    auto& [sway_exit_code, last_read_size, pipe_data] = context;
+
+    const size_t path_size = (pipe_data.size() - 1) * PIPE_BUF + last_read_size + 1;
+
+    socket_path result{std::make_unique_for_overwrite<char[]>(path_size), path_size};
+    std::unique_ptr<char[]>& path_to_socket_buf = result.path_memory;
+    path_to_socket_buf[path_size - 1] = '\0';
+    char* beg = path_to_socket_buf.get();
+    for (size_t i = 0; i < pipe_data.size() - 1; ++i)
+    {
+        memcpy(beg, pipe_data[i].data(), PIPE_BUF);
+        beg += PIPE_BUF;
+    }
+    memcpy(beg, pipe_data.back().data(), last_read_size);
+
+    if (result.size > 1) [[unlikely]]
+    {
+        for (char* it = path_to_socket_buf.get() + result.size - 2; it != path_to_socket_buf.get(); --it)
+        {
+            if (std::isspace(*it))
+            {
+                *it = '\0';
+                --result.size;
+            }
+        }
+    }
+
+    if (sway_exit_code != 0) [[unlikely]]
+    {
+        return std::unexpected{sway::error_desc{sway_exit_code, sway::error_desc::operation::exit_get_socketpath}};
+    }
+
+    return std::move(result);
+}
+
+template <typename T>
+struct member_pointer_to_array_length {};
+
+template <typename Elem, typename C, size_t arr_size>
+// surprisingly, not array of pointers, but pointer to array
+struct member_pointer_to_array_length<Elem (C::*)[arr_size]>
+{
+    constexpr static size_t size = arr_size;
+};
+
+constexpr size_t unix_socket_address_length = member_pointer_to_array_length<decltype(&sockaddr_un::sun_path)>::size;
+
+std::expected<socket_path, sway::error_desc>
+check_path_length(socket_path path)
+{
+    // equality is error too, since it does not allow for '\0' to be placed
+    if (path.size >= unix_socket_address_length)
+    {
+        return std::unexpected{sway::error_desc{
+            sway::error_desc::invalid_error_code::path_to_socket_too_long,
+            sway::error_desc::operation::check_socket_path,
+            static_cast<int64_t>(path.size), static_cast<int64_t>(unix_socket_address_length)}};
+    }
+    return std::move(path);
+}
+
+std::expected<socket_path, sway::error_desc> get_socket_path()
+{
+    return start_sway_getsocketpath().and_then(
+        read_sway_socket).and_then(
+        close_sway_socket).and_then(
+        combine_pipe_data).and_then(
+        check_path_length);
+}
+
+bool is_socket(const char* path)
+{
+    struct stat file_stat;
+    return ::stat(path, &file_stat) == 0 && S_ISSOCK(file_stat.st_mode);
+}
+
+// sway exports SWAYSOCK to everything it starts, and sets I3SOCK for i3 compatible
+// clients, so programs started from sway config or waybar never need to ask sway itself
+std::optional<std::string> socket_path_from_environment()
+{
+    for (const char* variable : {"SWAYSOCK", "I3SOCK"})
+    {
+        const char* value = std::getenv(variable);
+        if (value && *value && is_socket(value))
+        {
+            return std::string(value);
+        }
+    }
+    return std::nullopt;
+}
+
+struct dir_close
+{
+    void operator()(DIR* dir) { ::closedir(dir); }
+};
+
+// sway creates its socket as $XDG_RUNTIME_DIR/sway-ipc.$UID.$PID.sock, this is
+// what sway --get-socketpath falls back to as well, when SWAYSOCK is not set
+std::optional<std::string> socket_path_from_runtime_dir()
+{
+    const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (!runtime_dir || !*runtime_dir)
+    {
+        return std::nullopt;
+    }
+
+    std::unique_ptr<DIR, dir_close> dir(::opendir(runtime_dir));
+    if (!dir)
+    {
+        return std::nullopt;
+    }
+
+    const uid_t uid = ::getuid();
+    while (const dirent* entry = ::readdir(dir.get()))
+    {
+        unsigned int socket_uid = 0;
+        int sway_pid = 0;
+        int name_length = 0;
+        if (std::sscanf(entry->d_name, "sway-ipc.%u.%d.sock%n", &socket_uid, &sway_pid, &name_length) != 2 ||
+            entry->d_name[name_length] != '\0' || socket_uid != uid)
+        {
+            continue;
+        }
+
+        // sway does not remove socket when it crashes, skip sockets of dead processes
+        if (::kill(sway_pid, 0) != 0 && errno == ESRCH)
+        {
+            continue;
+        }
+
+        std::string path = std::format("{}/{}", runtime_dir, entry->d_name);
+        if (is_socket(path.c_str()))
+        {
+            return path;
+        }
+    }
+    return std::nullopt;
+}
+
+std::expected<std::string_view, sway::error_desc> check_socket_path_length(const std::string_view socket_path)
+{
+    // equality is error too, since it does not allow for '\0' to be placed
+    if (socket_path.size() >= unix_socket_address_length)
+    {
+        return std::unexpected{sway::error_desc{
+            sway::error_desc::invalid_error_code::path_to_socket_too_long,
+            sway::error_desc::operation::check_socket_path,
+            static_cast<int64_t>(socket_path.size()), static_cast<int64_t>(unix_socket_address_length)}};
+    }
+    return socket_path;
+}
+
+struct create_socket_context
+{
+    int sock_fd;
+    std::string_view socket_path;
+};
+
+std::expected<create_socket_context, sway::error_desc> create_socket(const std::string_view socket_path)
+{
+    int sock_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock_fd == -1)
+    {
+        return std::unexpected{sway::error_desc{sway::error_desc::operation::create_socket}};
+    }
+    return create_socket_context{sock_fd, socket_path};
+}
+
+std::expected<int, sway::error_desc> connect_socket(create_socket_context socket_context)
+{
+    sockaddr_un sock_addr{};
+    sock_addr.sun_family = AF_UNIX;
+    // length was checked earlier, and sock_addr is zeroed, so path stays null terminated
+    std::strncpy(sock_addr.sun_path, socket_context.socket_path.data(), socket_context.socket_path.size());
+
+    if (::connect(socket_context.sock_fd, reinterpret_cast<sockaddr*>(&sock_addr), sizeof(sockaddr_un)))
+    {
+        sway::error_desc error{sway::error_desc::operation::connect_socket};
+        ::close(socket_context.sock_fd);
+        return std::unexpected{std::move(error)};
+    }
+
+    return socket_context.sock_fd;
+}
+} // namespace
+
+namespace sway
+{
+std::expected<std::string, error_desc> find_socket_path()
+{
+    if (std::optional<std::string> path = socket_path_from_environment())
+    {
+        return std::move(path.value());
+    }
+
+    if (std::optional<std::string> path = socket_path_from_runtime_dir())
+    {
+        return std::move(path.value());
+    }
+
+    // last resort, costs fork and exec of the whole sway binary
+    return get_socket_path().transform([](socket_path path)
+    {
+        // path_memory is null terminated, and trailing whitespace is already replaced with nulls
+        return std::string(path.path_memory.get());
+    });
+}
+
+std::expected<int, error_desc> open_socket(const std::string_view socket_path)
+{
+    return check_socket_path_length(socket_path).and_then(
+        create_socket).and_then(
+        connect_socket);
+}
+} // namespace sway
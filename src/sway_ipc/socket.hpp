@@ -0,0 +1,15 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <expected>
+#include <string>
+#include <string_view>
+
+namespace sway
+{
+// looks for sway socket in SWAYSOCK, I3SOCK and $XDG_RUNTIME_DIR/sway-ipc.*.sock,
+// and only if none found asks sway --get-socketpath
+std::expected<std::string, error_desc> find_socket_path();
+
+// creates unix socket, and connects it to socket_path. Returns socket fd
+std::expected<int, error_desc> open_socket(std::string_view socket_path);
+} // namespace sway
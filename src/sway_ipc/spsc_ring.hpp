@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace sway
+{
+inline constexpr size_t cache_line_size = 64;
+
+// lock-free queue of one producer thread and one consumer thread. Slots are allocated once,
+// and reused: producer fills slot in place and publishes it, consumer uses it in place and
+// pops it, so slots can own buffers which keep their memory between elements.
+// Waiting for element or for space sleeps on futex, only when there is nothing to do
+template <typename T>
+class spsc_ring
+{
+public:
+    // capacity is rounded up to power of two
+    explicit spsc_ring(size_t capacity)
+        : _slots(std::bit_ceil(capacity == 0 ? size_t(1) : capacity))
+        , _mask(_slots.size() - 1)
+    {
+    }
+
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+    size_t capacity() const { return _slots.size(); }
+    // exact only when called by producer or consumer, approximate for others
+    size_t size() const
+    {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+
+    //=================================================================================================================
+    // producer. Slot to fill, or nullptr if ring is full. Slot is not visible to consumer until push
+    T* back()
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == _slots.size())
+        {
+            return nullptr;
+        }
+        return &_slots[tail & _mask];
+    }
+
+    void push()
+    {
+        _tail.store(_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        signal();
+    }
+
+    // blocks until back() has slot. Returns nullptr if ring was closed
+    T* wait_back()
+    {
+        while (!closed())
+        {
+            const uint32_t signals = _signals.load(std::memory_order_acquire);
+            if (T* slot = back())
+            {
+                return slot;
+            }
+            _signals.wait(signals, std::memory_order_acquire);
+        }
+        return nullptr;
+    }
+
+    //=================================================================================================================
+    // consumer. The oldest element, or nullptr if ring is empty
+    T* front()
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return &_slots[head & _mask];
+    }
+
+    void pop()
+    {
+        _head.store(_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        signal();
+    }
+
+    // blocks until there is element. Returns nullptr if ring was closed and all elements were taken
+    T* wait_front()
+    {
+        while (true)
+        {
+            const uint32_t signals = _signals.load(std::memory_order_acquire);
+            if (T* slot = front())
+            {
+                return slot;
+            }
+            else if (closed())
+            {
+                return nullptr;
+            }
+            _signals.wait(signals, std::memory_order_acquire);
+        }
+    }
+
+    //=================================================================================================================
+    // wakes both sides. Consumer still gets elements pushed before close
+    void close()
+    {
+        _closed.store(true, std::memory_order_release);
+        signal();
+    }
+
+    bool closed() const { return _closed.load(std::memory_order_acquire); }
+
+private:
+    // every change is counted, so waiter never misses change made between its check and its wait
+    void signal()
+    {
+        _signals.fetch_add(1, std::memory_order_release);
+        _signals.notify_all();
+    }
+
+    std::vector<T> _slots;
+    size_t _mask;
+    // separate cache lines, so producer and consumer do not fight over one
+    alignas(cache_line_size) std::atomic<size_t> _head{0};
+    alignas(cache_line_size) std::atomic<size_t> _tail{0};
+    alignas(cache_line_size) std::atomic<uint32_t> _signals{0};
+    std::atomic<bool> _closed{false};
+};
+} // namespace sway
@@ -0,0 +1,260 @@
+#include <sway_ipc/state_publisher.hpp>
+#include <sway_ipc/decode.hpp>
+#include <sway_ipc/events/events.hpp>
+#include <sway_ipc/replies.hpp>
+#include <sway_ipc/sway_ipc.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+template <size_t N>
+void copy_string(char (&out)[N], std::string_view string)
+{
+    // the rest is already zeroed, so snapshots compare equal with memcmp
+    std::memcpy(out, string.data(), std::min(string.size(), N));
+}
+} // namespace
+
+namespace sway
+{
+state_publisher::state_publisher(int fd, shared_state_region* region)
+    : _fd(fd)
+    , _region(region)
+{
+}
+
+state_publisher::~state_publisher()
+{
+    // region is not unlinked, readers keep the last state, until the next publisher takes it
+    if (_region != nullptr)
+    {
+        ::munmap(_region, sizeof(shared_state_region));
+    }
+    if (_fd != -1)
+    {
+        ::close(_fd);
+    }
+}
+
+state_publisher::state_publisher(state_publisher&& other)
+    : _fd(std::exchange(other._fd, -1))
+    , _region(std::exchange(other._region, nullptr))
+    , _focused_workspace(std::move(other._focused_workspace))
+    , _mode(std::move(other._mode))
+    , _outputs(std::move(other._outputs))
+    , _tree(std::move(other._tree))
+    , _outputs_stale(other._outputs_stale)
+    , _draft(other._draft)
+{
+}
+
+std::expected<state_publisher, error_desc> state_publisher::open(const std::string& name)
+{
+    // state tells what user does, so nobody else reads it. Name is easy to guess, and other user
+    // could create region first, so region left by previous publisher is taken only if it is ours
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd == -1 && errno == EEXIST)
+    {
+        fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    }
+    if (fd == -1)
+    {
+        return std::unexpected(error_desc(error_desc::operation::open_shared_memory));
+    }
+
+    auto fail = [fd](error_desc error) -> std::expected<state_publisher, error_desc>
+    {
+        ::close(fd);
+        return std::unexpected(error);
+    };
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) == -1)
+    {
+        return fail(error_desc(error_desc::operation::open_shared_memory));
+    }
+    else if (file_stat.st_uid != ::getuid())
+    {
+        // region created by somebody else is refused, as open would refuse file of other user
+        errno = EPERM;
+        return fail(error_desc(error_desc::operation::open_shared_memory));
+    }
+    // region of older publisher could be readable by everybody
+    else if ((file_stat.st_mode & 0777) != 0600 && ::fchmod(fd, 0600) == -1)
+    {
+        return fail(error_desc(error_desc::operation::open_shared_memory));
+    }
+    if (::ftruncate(fd, sizeof(shared_state_region)) == -1)
+    {
+        return fail(error_desc(error_desc::operation::map_shared_memory));
+    }
+    void* memory = ::mmap(nullptr, sizeof(shared_state_region), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED)
+    {
+        return fail(error_desc(error_desc::operation::map_shared_memory));
+    }
+
+    shared_state_region* region = static_cast<shared_state_region*>(memory);
+    // previous publisher could die in the middle of publish, sequence is made even again.
+    // It is not reset, so readers comparing sequences notice the change
+    const uint32_t sequence = region->sequence.load(std::memory_order_relaxed);
+    region->sequence.store(sequence + (sequence & 1), std::memory_order_release);
+    region->version = shared_state_version;
+    region->magic = shared_state_magic;
+    return state_publisher(fd, region);
+}
+
+std::expected<void, error_desc> state_publisher::refresh(ipc& ipc)
+{
+    _outputs_stale = true;
+    _tree.invalidate();
+    return ipc.get_binding_state().transform([this](std::string_view mode)
+    {
+        _mode = mode;
+    }).and_then([this, &ipc]()
+    {
+        return settle(ipc);
+    });
+}
+
+void state_publisher::apply(const workspace_event& event)
+{
+    _tree.apply(event);
+    if (event.change == "focus" && event.current.has_value())
+    {
+        // focus is by far the most frequent, and is patched without query
+        _focused_workspace = event.current->name;
+        for (output& output : _outputs)
+        {
+            output.focused = output.name == event.current->output;
+            if (output.focused)
+            {
+                output.current_workspace = event.current->name;
+            }
+        }
+    }
+    else if (event.change == "move" || event.change == "rename" || event.change == "reload")
+    {
+        _outputs_stale = true;
+    }
+}
+
+void state_publisher::apply(const output_event&)
+{
+    // event has no details, only that something changed
+    _outputs_stale = true;
+}
+
+void state_publisher::apply(const mode_event& event)
+{
+    _mode = event.change;
+}
+
+void state_publisher::apply(const window_event& event)
+{
+    _tree.apply(event);
+}
+
+std::expected<void, error_desc> state_publisher::settle(ipc& ipc)
+{
+    std::expected<void, error_desc> result;
+    if (_outputs_stale)
+    {
+        result = query_outputs(ipc);
+    }
+    return result.and_then([this, &ipc]()
+    {
+        return _tree.sync(ipc);
+    }).transform([this]()
+    {
+        publish();
+    });
+}
+
+std::expected<void, error_desc> state_publisher::query_outputs(ipc& ipc)
+{
+    // replies live in reply arena only until the next request, so everything is copied out
+    return ipc.get_outputs().and_then([this, &ipc](simdjson::ondemand::document document)
+    {
+        _outputs.clear();
+        return decode_each<sway::output>(document, [this](sway::output reply)
+        {
+            _outputs.push_back(output{
+                .name = std::string(reply.name),
+                .current_workspace = std::string(reply.current_workspace.value_or(std::string_view())),
+                .x = reply.rect.x,
+                .y = reply.rect.y,
+                .width = reply.rect.width,
+                .height = reply.rect.height,
+                .active = reply.active,
+                .focused = reply.focused,
+            });
+        }, ipc.reply_arena());
+    }).and_then([&ipc]()
+    {
+        return ipc.get_workspaces();
+    }).and_then([this, &ipc](simdjson::ondemand::document document)
+    {
+        return decode_each<sway::workspace>(document, [this](const sway::workspace& workspace)
+        {
+            if (workspace.focused)
+            {
+                _focused_workspace = workspace.name;
+            }
+        }, ipc.reply_arena());
+    }).transform([this]()
+    {
+        _outputs_stale = false;
+    });
+}
+
+void state_publisher::publish()
+{
+    _draft = state_snapshot{};
+    copy_string(_draft.focused_workspace, _focused_workspace);
+    copy_string(_draft.mode, _mode);
+    const tree_cache::node_index focused = _tree.focused_node();
+    if (focused != tree_cache::no_node && _tree.at(focused).type != tree_cache::node_type::workspace)
+    {
+        copy_string(_draft.focused_app, _tree.app_id(focused));
+        copy_string(_draft.focused_title, _tree.name(focused));
+    }
+    _draft.scratchpad_count = static_cast<uint32_t>(_tree.scratchpad_size());
+    _draft.output_count = static_cast<uint32_t>(std::min(_outputs.size(), shared_max_outputs));
+    for (uint32_t i = 0; i < _draft.output_count; ++i)
+    {
+        const output& from = _outputs[i];
+        shared_output& to = _draft.outputs[i];
+        copy_string(to.name, from.name);
+        copy_string(to.current_workspace, from.current_workspace);
+        to.x = from.x;
+        to.y = from.y;
+        to.width = from.width;
+        to.height = from.height;
+        to.active = from.active;
+        to.focused = from.focused;
+        if (from.focused)
+        {
+            copy_string(_draft.focused_output, from.name);
+        }
+    }
+
+    // publisher is the only writer, so region can be compared without seqlock.
+    // Readers polling sequence see change only when state really changed
+    if (std::memcmp(&_draft, &_region->state, sizeof(state_snapshot)) == 0)
+    {
+        return;
+    }
+    const uint32_t sequence = _region->sequence.load(std::memory_order_relaxed);
+    _region->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&_region->state, &_draft, sizeof(state_snapshot));
+    _region->sequence.store(sequence + 2, std::memory_order_release);
+}
+} // namespace sway
@@ -0,0 +1,76 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <sway_ipc/shared_state.hpp>
+#include <sway_ipc/tree_cache.hpp>
+#include <expected>
+#include <string>
+#include <vector>
+
+namespace sway
+{
+class ipc;
+struct workspace_event;
+struct output_event;
+struct mode_event;
+struct window_event;
+
+// keeps focused workspace and window, mode, scratchpad and outputs from events, and publishes them into
+// shared memory, read with shared_state_reader. One process publishes, so tools which only
+// need this state do not query sway each on their own.
+// Same cycle as bar modules: refresh on start, apply events, settle after burst of events
+class state_publisher
+{
+public:
+    ~state_publisher();
+
+    state_publisher(const state_publisher&) = delete;
+    state_publisher& operator=(const state_publisher&) = delete;
+    state_publisher(state_publisher&& other);
+    state_publisher& operator=(state_publisher&& other) = delete;
+
+    // creates region, or takes one left by previous publisher
+    static std::expected<state_publisher, error_desc> open(const std::string& name = shared_state_name());
+
+    // queries everything, and publishes
+    std::expected<void, error_desc> refresh(ipc& ipc);
+
+    void apply(const workspace_event& event);
+    void apply(const output_event& event);
+    void apply(const mode_event& event);
+    void apply(const window_event& event);
+
+    // queries what events could not patch, and publishes if anything changed
+    std::expected<void, error_desc> settle(ipc& ipc);
+
+private:
+    struct output
+    {
+        std::string name;
+        std::string current_workspace;
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+        bool active = false;
+        bool focused = false;
+    };
+
+    state_publisher(int fd, shared_state_region* region);
+
+    std::expected<void, error_desc> query_outputs(ipc& ipc);
+    void publish();
+
+    int _fd = -1;
+    shared_state_region* _region = nullptr;
+
+    std::string _focused_workspace;
+    std::string _mode = "default";
+    std::vector<output> _outputs;
+    // focused window and scratchpad, patched by window and workspace events
+    tree_cache _tree;
+    // workspace was moved or renamed, or outputs changed
+    bool _outputs_stale = true;
+    // snapshot is built here, and copied into region only when it differs
+    state_snapshot _draft{};
+};
+} // namespace sway
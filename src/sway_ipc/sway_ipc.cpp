@@ -1,5 +1,10 @@
 #include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/replies.hpp>
+#include <sway_ipc/frame_buffer.hpp>
+#include <sway_ipc/message.hpp>
+#include <sway_ipc/socket.hpp>
 #include <simdjson.h>
+#include <algorithm>
 #include <memory>
 #include <expected>
 #include <cstdlib>
@@ -7,463 +12,181 @@
 #include <ranges>
 #include <unistd.h>
 #include <fcntl.h>
-#include <sys/socket.h>
-#include <sys/un.h>
+#include <poll.h>
+#include <charconv>
+#include <climits>
+#include <limits>
+#include <sys/uio.h>
 
 namespace
 {
-std::expected<FILE*, sway::error_desc> start_sway_getsocketpath()
-{
-    constexpr static const char* swayCommand = "sway --get-socketpath";
-
-    FILE* socket_path_desc = popen(swayCommand, "r");
-    if (!socket_path_desc) [[unlikely]]
-    {
-        return std::unexpected{sway::error_desc{
-            std::format("Error trying to get socket path from sway: {}\n"
-            "Error encontered when executing sway --get-socketpath.\n"
-            "Error can be encountered when sway is not installed, or not accessible from PATH", strerror(errno))
-        }};
-    }
-    return socket_path_desc;
-}
-
-struct read_socket_result
-{
-    FILE* socket;
-    size_t last_read_size;
-    std::vector<std::array<char, PIPE_BUF>> pipe_data;
-};
-
-std::expected<read_socket_result, sway::error_desc> read_sway_socket(FILE* socket_path_desc)
-{
-    read_socket_result read_socket;
-    read_socket.socket = socket_path_desc;
-    std::vector<std::array<char, PIPE_BUF>>& pipe_data = read_socket.pipe_data;
-
-    size_t& last_read_size = read_socket.last_read_size;
-    do
-    {
-        std::array<char, PIPE_BUF>* currentPipeData = &pipe_data.emplace_back();
-        last_read_size = fread(currentPipeData->data(),
-            sizeof(char), PIPE_BUF, socket_path_desc);
-    }
-    while (last_read_size == PIPE_BUF);
-
-    if (ferror(socket_path_desc)) [[unlikely]]
-    {
-        return std::unexpected{sway::error_desc{
-            std::format("Reading socket path from sway failed with error: {}", strerror(errno))
-        }};
-    }
-
-    return std::move(read_socket);
-}
-
-struct close_sway_socket_result
-{
-    int socket_path_desc;
-    size_t last_read_size;
-    std::vector<std::array<char, PIPE_BUF>> pipe_data;
-};
-
-std::expected<close_sway_socket_result, sway::error_desc>
-close_sway_socket(const read_socket_result context)
-{
-    FILE* socket_path_desc = context.socket;
-
-    close_sway_socket_result close_socket;
-    close_socket.pipe_data = std::move(context.pipe_data);
-    close_socket.last_read_size = context.last_read_size;
-
-    int& sway_exit_code = close_socket.socket_path_desc;
-    if (sway_exit_code = pclose(socket_path_desc); sway_exit_code != 0) [[unlikely]]
-    {
-        if (errno == ECHILD)
-        {
-            return std::unexpected{sway::error_desc{
-                std::format("Failed to get sway process status on pclose, ECHILD was in errno")
-            }};
-        }
-    }
-
-    return std::move(close_socket);
-}
-
-struct socket_path
-{
-    std::unique_ptr<char[]> path_memory;
-    size_t size;
-};
-
-std::expected<socket_path, sway::error_desc>
-combine_pipe_data(const close_sway_socket_result context)
-{
-    auto& [sway_exit_code, last_read_size, pipe_data] = context;
-
-    const size_t path_size = (pipe_data.size() - 1) * PIPE_BUF + last_read_size + 1;
-
-    socket_path result{std::make_unique_for_overwrite<char[]>(path_size), path_size};
-    std::unique_ptr<char[]>& path_to_socket_buf = result.path_memory;
-    path_to_socket_buf[path_size - 1] = '\0';
-    char* beg = path_to_socket_buf.get();
-    for (size_t i = 0; i < pipe_data.size() - 1; ++i)
-    {
-        memcpy(beg, pipe_data[i].data(), PIPE_BUF);
-        beg += PIPE_BUF;
-    }
-    memcpy(beg, pipe_data.back().data(), last_read_size);
-
-    if (result.size > 1) [[unlikely]]
-    {
-        for (char* it = path_to_socket_buf.get() + result.size - 2; it != path_to_socket_buf.get(); --it)
-        {
-            if (std::isspace(*it))
-            {
-                *it = '\0';
-                --result.size;
-            }
-        }
-    }
-
-    if (sway_exit_code != 0) [[unlikely]]
-    {
-        return std::unexpected{sway::error_desc{sway_exit_code,
-            std::format(
-                "Sway closed with non zero exit code, when getting socket path. "
-                "Exit Code: {}\n known stdout:\n{}", 
-                sway_exit_code, std::string_view(result.path_memory.get(), result.size))
-        }};
-    }
-
-    return std::move(result);
-}
-
-template <typename T>
-struct member_pointer_to_array_length {};
-
-template <typename Elem, typename C, size_t arr_size>
-// surprisingly, not array of pointers, but pointer to array
-struct member_pointer_to_array_length<Elem (C::*)[arr_size]>
-{
-    constexpr static size_t size = arr_size;
-};
-
-constexpr size_t unix_socket_address_length = member_pointer_to_array_length<decltype(&sockaddr_un::sun_path)>::size;
-
-std::expected<socket_path, sway::error_desc>
-check_path_length(socket_path path)
-{
-    // equality is error too, since it does not allow for '\0' to be placed
-    if (path.size >= unix_socket_address_length)
-    {
-        return std::unexpected{sway::error_desc{
-            sway::error_desc::invalid_error_code::path_to_socket_too_long,
-            std::format("path returned from sway --get-socketpath was too long. "
-                "sockaddr_un::sun_path length is {}, returned path is {}",
-                unix_socket_address_length, path.path_memory.get())}};
-    }
-    return std::move(path);
-}
-
-std::expected<socket_path, sway::error_desc> get_socket_path()
-{
-    return start_sway_getsocketpath().and_then(
-        read_sway_socket).and_then(
-        close_sway_socket).and_then(
-        combine_pipe_data).and_then(
-        check_path_length);
-}
+using sway::payload_type;
+using sway::message_header;
+using sway::header_size;
+using sway::find_socket_path;
+using sway::open_socket;
+using sway::parse_payload;
 
 // socket_path is null terminated
 std::expected<std::string_view, sway::error_desc> close_previous_socket(const int socket_fd, const std::string_view socket_path)
 {
     if (socket_fd && ::close(socket_fd))
     {
-        return std::unexpected{
-            sway::error_desc{
-                std::format("Socket closed with error code {}: {}",
-                    errno, strerror(errno))}};
+        return std::unexpected{sway::error_desc{sway::error_desc::operation::close_socket}};
     }
     return {std::move(socket_path)};
 }
 
-struct create_socket_context
+constexpr uint32_t event_bit(sway::event_type event)
 {
-    int sock_fd;
-    std::string_view socket_path;
-};
-
-std::expected<create_socket_context, sway::error_desc> create_socket(const std::string_view socket_path)
-{
-    int sock_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
-    if (sock_fd == -1)
-    {
-        return std::unexpected{sway::error_desc{
-            std::format("Creation of sway socket failed with error {}: {}", 
-                errno, strerror(errno))}};
-    }
-    return create_socket_context{sock_fd, socket_path};
+    return uint32_t(1) << sway::detail::event_index(event);
 }
 
-std::expected<int, sway::error_desc> connect_socket(create_socket_context socket_context)
-{
-    sockaddr_un sock_addr;
-    sock_addr.sun_family = AF_UNIX;
-    // length was checked earlier
-    // socket_path.size() includes null terminating symbol
-    std::strncpy(sock_addr.sun_path, socket_context.socket_path.data(), socket_context.socket_path.size());
-
-    if (::connect(socket_context.sock_fd, reinterpret_cast<sockaddr*>(&sock_addr), sizeof(sockaddr_un)))
-    {
-        return std::unexpected{sway::error_desc{
-            std::format("Error encountered when disconnecting from sway socket. error code {}: {}",
-                sock_addr.sun_path, errno, strerror(errno))}};
-    }
-
-    return socket_context.sock_fd;
-}
-
-enum class payload_type : uint32_t
-{
-    run_command = 0,
-    get_workspaces = 1,
-    subscribe = 2,
-    get_outputs = 3,
-    get_tree = 4,
-    get_marks = 5,
-    get_bar_config = 6,
-    get_version = 7,
-    get_binding_modes = 8,
-    get_config = 9,
-    send_tick = 10,
-    sync = 11,
-    get_binding_state = 12,
-    get_inputs = 100,
-    get_seats = 101
-};
-
-constexpr size_t header_size = 6 + sizeof(int) + sizeof(payload_type);
-
-struct message_header
-{
-    char padding[2];
-    char magic[6] = {'i', '3', '-', 'i', 'p', 'c'};
-    int length;
-    payload_type payload_type;
-};
-
 struct response_data
 {
     uint32_t payload_type;
     simdjson::ondemand::document json;
 };
 
-std::expected<void, sway::error_desc> blocking_read(int sock_fd, void* ptr, size_t n)
+// writes all buffers with as few syscalls as possible, iovs are modified on partial writes
+std::expected<void, sway::error_desc> blocking_writev(int sock_fd, std::span<iovec> iovs)
 {
-    do
+    while (!iovs.empty())
     {
-        const ssize_t result = read(sock_fd, ptr, n);
+        const ssize_t result = ::writev(sock_fd, iovs.data(), std::min<size_t>(iovs.size(), IOV_MAX));
         if (result == -1)
         {
-            return std::unexpected(sway::error_desc(
-                std::format("Error when reading sway response: {}", strerror(errno))
-            ));
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return std::unexpected(sway::error_desc(sway::error_desc::operation::write_request));
         }
-        n -= result;
-    }
-    while (n);
 
+        size_t written = result;
+        while (!iovs.empty() && written >= iovs.front().iov_len)
+        {
+            written -= iovs.front().iov_len;
+            iovs = iovs.subspan(1);
+        }
+        if (written)
+        {
+            iovs.front().iov_base = static_cast<char*>(iovs.front().iov_base) + written;
+            iovs.front().iov_len -= written;
+        }
+    }
     return {};
 }
 
-std::expected<void, sway::error_desc> blocking_write(int sock_fd, const void* ptr, size_t n)
+// blocks until whole message is buffered. Header and payload, and possibly following
+// messages are taken from socket in one read, whatever socket has at the moment
+std::expected<sway::frame, sway::error_desc> read_frame(sway::frame_buffer& frames, int sock_fd)
 {
-    do
+    while (true)
     {
-        const ssize_t result = write(sock_fd, ptr, n);
-        if (result == -1)
+        std::expected<std::optional<sway::frame>, sway::error_desc> frame_result = frames.next_frame();
+        if (!frame_result.has_value())
         {
-            return std::unexpected(sway::error_desc(std::format("Error when writing sway commands: {}", strerror(errno))));
+            return std::unexpected(std::move(frame_result.error()));
+        }
+        else if (frame_result->has_value())
+        {
+            return frame_result->value();
         }
-        n -= result;
-    }
-    while (n);
 
-    return {};
+        std::expected<size_t, sway::error_desc> fill_result = frames.fill(sock_fd);
+        if (!fill_result.has_value())
+        {
+            return std::unexpected(std::move(fill_result.error()));
+        }
+    }
 }
 
+// document is parsed in place, inside of frame buffer, and is valid until next read from it
 std::expected<response_data, sway::error_desc>
-read_response(sized_buffer& read_buffer, int sock_fd, simdjson::ondemand::parser& parser)
+read_response(sway::frame_buffer& frames, int sock_fd, simdjson::ondemand::parser& parser)
 {
-    message_header header_reply;
-
-    // intentionally reading more bytes, then there is in the field, to fill next fields
-    auto read_result = blocking_read(sock_fd, header_reply.magic, header_size);
-    if (!read_result.has_value())
-    {
-        return std::unexpected(std::move(read_result.error()));
-    }
-
-    if (std::memcmp(header_reply.magic, "i3-ipc", 6) != 0)
-    {
-        return std::unexpected(sway::error_desc(
-            sway::error_desc::invalid_error_code::magic_string_was_wrong,
-            std::format("Sway send response with wrong magic string. Magic string was {}",
-                std::string_view(header_reply.magic, 6))));
-    }
-
-    if (header_reply.length < 0)
-    {
-        return std::unexpected(sway::error_desc(
-            sway::error_desc::invalid_error_code::negative_payload_length,
-            "Sway sent response with negative payload length"
-        ));
-    }
-
-    read_buffer.allocate(header_reply.length + simdjson::SIMDJSON_PADDING);
-    
-    read_result = blocking_read(sock_fd, read_buffer.ptr(), static_cast<size_t>(header_reply.length));
-    if (!read_result.has_value())
+    return read_frame(frames, sock_fd).and_then([&parser](sway::frame response)
     {
-        return std::unexpected(read_result.error());
-    }
-
-    simdjson::error_code error =
-        parser.allocate(header_reply.length);
-    if (error != simdjson::error_code::SUCCESS)
-    {
-        return std::unexpected(sway::error_desc(error, "Error while allocating space for parsing response from sway"));
-    }
-    simdjson::simdjson_result<simdjson::ondemand::document> document =
-        parser.iterate(simdjson::padded_string_view(read_buffer.ptr(),
-            header_reply.length, header_reply.length + simdjson::SIMDJSON_PADDING));
-    if (document.error() != simdjson::error_code::SUCCESS)
-    {
-        return std::unexpected(sway::error_desc(document.error(), "Parsing error when reseiving response from sway"));
-    }
-
-    return response_data(static_cast<uint32_t>(header_reply.payload_type), std::move(document.value_unsafe()));
+        return parse_payload(parser, response.payload, response.length).transform(
+            [&response](simdjson::ondemand::document document)
+            {
+                return response_data(response.payload_type, std::move(document));
+            });
+    });
 }
 
-std::expected<std::vector<std::expected<void, sway::ipc::run_error>>, sway::error_desc>
-read_command_response(sized_buffer& read_buffer, int sock_fd, simdjson::ondemand::parser& parser)
+std::expected<std::pmr::vector<std::expected<void, sway::ipc::run_error>>, sway::error_desc>
+parse_command_response(simdjson::ondemand::document document, sway::arena& reply_arena)
 {
-    auto response_result = read_response(read_buffer, sock_fd, parser);
-    if (!response_result.has_value())
-    {
-        return std::unexpected(std::move(response_result.error()));
-    }
-
-    auto& [_, document] = response_result.value();
-
-    simdjson::simdjson_result<simdjson::ondemand::array> array = document.get_array();
-    simdjson::simdjson_result<simdjson::ondemand::array_iterator> begin_result = array.begin();
-    simdjson::simdjson_result<simdjson::ondemand::array_iterator> end_result = array.end();
-
-    simdjson::error_code cumulativeError = begin_result.error() != simdjson::error_code::SUCCESS ?
-        begin_result.error() : end_result.error();
-    
-    if (cumulativeError != simdjson::error_code::SUCCESS)
+    std::pmr::vector<std::expected<void, sway::ipc::run_error>> result(&reply_arena);
+    return sway::decode_each<sway::command_result>(document, [&result](sway::command_result command)
     {
-        return std::unexpected(sway::error_desc(
-            cumulativeError, "response from RUN_COMMAND wasn't array"));
-    }
-
-    std::vector<std::expected<void, sway::ipc::run_error>> result;
-
-    for (simdjson::ondemand::array_iterator it = begin_result.value_unsafe(); it != end_result.value_unsafe(); ++it)
-    {
-        simdjson::simdjson_result<simdjson::ondemand::value> val = *it;
-        simdjson::simdjson_result<simdjson::ondemand::value> success_field = val.find_field("success");
-        simdjson::simdjson_result<bool> success_value = success_field.get_bool();
-        // process errors
-        if (success_value.value_unsafe())
+        if (command.success)
         {
             result.push_back({});
         }
         else
         {
-            sway::ipc::run_error returned_error;
-            simdjson::simdjson_result<bool> parse_error = val.find_field_unordered("parse_error").get_bool();
-            if (parse_error.error() == simdjson::error_code::SUCCESS)
-            {
-                returned_error.parse_error = parse_error.value_unsafe();
-            }
-            simdjson::simdjson_result<std::string_view> error = val.find_field_unordered("error").get_string();
-            if (error.error() == simdjson::error_code::SUCCESS)
-            {
-                returned_error.error = std::string(error.value_unsafe());
-            }
-            result.push_back(std::unexpected(std::move(returned_error)));
+            // error points into parser, valid until next request, as any other document
+            result.push_back(std::unexpected(sway::ipc::run_error{command.error, command.parse_error}));
         }
-    }
-
-    return result;
+    }).transform([&result]()
+    {
+        return std::move(result);
+    });
 }
 
-sway::ipc::request_result send_command_with_precomputed_payload(
-    sized_buffer& write_buffer, sized_buffer& read_buffer, int sock_fd,
-    std::string_view payload, simdjson::ondemand::parser& parser, payload_type payload_type)
+// reply stays in read_frames until next read from them
+std::expected<sway::frame, sway::error_desc> exchange(sway::frame_buffer& read_frames, int sock_fd,
+    std::string_view payload, payload_type payload_type)
 {
-    write_buffer.allocate(sizeof(message_header));
-
-    message_header* header_ptr = new(write_buffer.ptr()) message_header;
-    header_ptr->length = payload.size();
-    header_ptr->payload_type = payload_type;
+    message_header header;
+    header.length = payload.size();
+    header.payload_type = payload_type;
 
+    // header and payload go in one syscall straight from where they are, without copying
     // writing not whole structure, but starting from magic
-    auto write_result = blocking_write(sock_fd, header_ptr->magic,
-        header_size + payload.size());
+    std::array<iovec, 2> iovs{{
+        {header.magic, header_size},
+        {const_cast<char*>(payload.data()), payload.size()}
+    }};
+    auto write_result = blocking_writev(sock_fd, std::span(iovs.data(), payload.empty() ? 1 : 2));
     if (!write_result.has_value())
     {
         return std::unexpected(std::move(write_result.error()));
     }
-    
-    header_ptr->~message_header();
 
-    return read_response(read_buffer, sock_fd, parser).transform([](response_data data)
-        {
-            return std::move(data.json);
-        });
+    return read_frame(read_frames, sock_fd);
+}
+
+sway::ipc::request_result send_command_with_precomputed_payload(
+    sway::frame_buffer& read_frames, int sock_fd, std::string_view payload,
+    simdjson::ondemand::parser& parser, sway::arena& reply_arena, payload_type payload_type)
+{
+    // previous reply is gone together with its document, and so is everything decoded from it
+    reply_arena.reset();
+
+    return exchange(read_frames, sock_fd, payload, payload_type).and_then([&parser](sway::frame response)
+    {
+        return parse_payload(parser, response.payload, response.length);
+    });
 }
 } // namespace
 
 namespace sway
 {
-error_desc::error_desc(std::string error_description)
-    : error_description(std::move(error_description))
-    , error_code(errno)
-    , error_source(error_desc::error_source::posix)
-{}
-
-error_desc::error_desc(int error, std::string error_description)
-    : error_description(std::move(error_description))
-    , error_code(error)
-    , error_source(error_desc::error_source::sway)
-{}
-
-error_desc::error_desc(error_desc::invalid_error_code error_code, std::string error_description)
-    : error_description(std::move(error_description))
-    , error_code(static_cast<int>(error_code))
-    , error_source(error_desc::error_source::invalid)
-{}
-
-error_desc::error_desc(simdjson::error_code error_code, std::string error_description)
-    : error_description(std::move(error_description))
-    , error_code(static_cast<int>(error_code))
-    , error_source(error_desc::error_source::parsing_error)
-{}
-
 ipc::ipc(simdjson::ondemand::parser& parser, bool print_errors_on_destroy /*= false*/)
     : _parser(parser)
     , _socket(nullptr, posix_close{print_errors_on_destroy})
+    , _event_socket(nullptr, posix_close{print_errors_on_destroy})
     // , _log_file(open_log_file(), posix_close{print_errors_on_destroy})
 {
 }
 
 ipc::~ipc()
 {
+    _event_socket.reset();
     _socket.reset();
 }
 
@@ -482,21 +205,37 @@ void ipc::posix_close::operator()(nullable_fd fd)
 
 std::expected<void, error_desc> ipc::connect()
 {
+    if (!_socket_path.empty())
+    {
+        if (this->connect(_socket_path).has_value()) [[likely]]
+        {
+            return {};
+        }
+        // sway could have been restarted with another socket, look for it again
+        _socket_path.clear();
+    }
+
     // monad is a monoid in the category of endofunctors
-    return get_socket_path().and_then([this](socket_path socket_path)
+    return find_socket_path().and_then([this](std::string socket_path)
     {
-        return this->connect(std::string_view(socket_path.path_memory.get(), socket_path.size));
+        return this->connect(socket_path);
     });
 }
 
 std::expected<void, error_desc> ipc::connect(std::string_view socket_path)
 {
+    if (socket_path.data() != _socket_path.data())
+    {
+        _socket_path = socket_path;
+    }
+
     return close_previous_socket(this->_socket.release(), socket_path).and_then(
-        create_socket).and_then(
-        connect_socket).and_then(
+        open_socket).and_then(
         [this](int sockFd) -> std::expected<void, error_desc>
         {
             this->_socket.reset(sockFd);
+            // it could be another sway
+            invalidate_replies(false);
             return {};
         });
 }
@@ -507,14 +246,22 @@ std::expected<void, error_desc> ipc::disconnect()
 
     if (sockFd && ::close(sockFd))
     {
-        return std::unexpected{error_desc{
-            std::format("Error encountered when disconnecting from sway socket. error code {}: {}",
-                errno, strerror(errno))}};
+        return std::unexpected{error_desc{error_desc::operation::close_socket}};
     }
     return {};
 }
 
-std::expected<std::vector<std::expected<void, ipc::run_error>>, error_desc>
+void ipc::shrink_buffers()
+{
+    _read_frames.shrink();
+    _event_frames.shrink();
+    _write_buffer.shrink(0);
+    // parser is never bigger than the biggest message, which fits in receive buffer
+    shrink_parser(_parser, _read_frames.capacity());
+    shrink_parser(_event_parser, _event_frames.capacity());
+}
+
+std::expected<std::pmr::vector<std::expected<void, ipc::run_error>>, error_desc>
 ipc::run_commands(const std::span<std::string> commands)
 {
     if (commands.empty())
@@ -525,205 +272,574 @@ ipc::run_commands(const std::span<std::string> commands)
     size_t payload_length = 0;
     for (const auto& command : commands)
     {
-        payload_length = command.size();
+        payload_length += command.size();
     }
     payload_length += commands.size() - 1;
 
-    // const size_t message_length = header_size + payload_length;
-    _write_buffer.allocate(sizeof(message_header) + payload_length);
+    message_header header;
+    header.length = payload_length;
+    header.payload_type = payload_type::run_command;
 
-    // placement new to construct header in payload
-    message_header* header_ptr = new (_write_buffer.ptr()) message_header;
-    header_ptr->length = payload_length;
-    header_ptr->payload_type = payload_type::run_command;
-
-    char* payload_ptr = _write_buffer.ptr() + sizeof(message_header);
-    // std::string::c_str() required by C++ standard to be null terminated
-    std::memcpy(payload_ptr, commands.front().data(), commands.front().size());
-    payload_ptr += commands.front().size();
+    // commands are sent from strings they are in, separated by commas, without copying them
+    static constexpr char separator = ',';
+    _write_iovecs.clear();
+    // writing not whole structure, but starting from magic
+    _write_iovecs.push_back({header.magic, header_size});
+    _write_iovecs.push_back({commands.front().data(), commands.front().size()});
 
     // drop one first element
-    for (const auto& command : std::ranges::views::drop(commands, 1))
+    for (auto& command : std::ranges::views::drop(commands, 1))
     {
-        *(payload_ptr++) = ',';
-        std::memcpy(payload_ptr, command.data(), command.size());
-        payload_ptr += command.size();
+        _write_iovecs.push_back({const_cast<char*>(&separator), 1});
+        _write_iovecs.push_back({command.data(), command.size()});
     }
 
-    auto write_result = blocking_write(_socket.get(), header_ptr->magic, header_size + payload_length);
+    auto write_result = blocking_writev(_socket.get(), _write_iovecs);
     if (!write_result.has_value())
     {
         return std::unexpected(std::move(write_result.error()));
     }
 
-    header_ptr->~message_header();
-
-    return read_command_response(_read_buffer, _socket.get(), _parser);
+    _reply_arena.reset();
+    return read_response(_read_frames, _socket.get(), _parser).and_then([this](response_data response)
+    {
+        return parse_command_response(std::move(response.json), _reply_arena);
+    });
 }
 
-std::expected<std::vector<std::expected<void, ipc::run_error>>, error_desc>
+std::expected<std::pmr::vector<std::expected<void, ipc::run_error>>, error_desc>
 ipc::run_commands(const std::string_view commands)
 {
-    auto send_result = send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), commands, _parser, payload_type::run_command);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), commands, _parser, _reply_arena, payload_type::run_command).and_then(
+        [this](simdjson::ondemand::document document)
+        {
+            return parse_command_response(std::move(document), _reply_arena);
+        });
+}
+
+ipc::request_result ipc::get_workspaces()
+{
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_workspaces);
+}
 
-    if (!send_result.has_value())
+std::expected<void, error_desc> ipc::open_event_connection()
+{
+    std::expected<void, error_desc> path_result;
+    if (_socket_path.empty())
     {
-        return std::unexpected(std::move(send_result.error()));
+        path_result = find_socket_path().transform([this](std::string socket_path)
+        {
+            _socket_path = std::move(socket_path);
+        });
     }
 
-    return read_command_response(_read_buffer, _socket.get(), _parser);
+    return path_result.and_then([this]()
+    {
+        return open_socket(_socket_path);
+    }).transform([this](int sock_fd)
+    {
+        _event_socket.reset(sock_fd);
+    });
 }
 
-ipc::request_result ipc::get_workspaces()
+ipc::subscribe_result ipc::open_subscription(std::span<sway::event_type> events,
+    std::span<const event_filter> filters)
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_workspaces);
-}
+    // subscription is never shared with requests, so callback is free to use get_tree and others
+    std::expected<void, error_desc> open_result = open_event_connection();
+    if (!open_result.has_value())
+    {
+        return subscribe_result{false, std::move(open_result.error())};
+    }
 
-ipc::subscribe_result ipc::subscribe(std::span<sway::event_type> events,
-    std::function<bool(ipc::event_result)> function, bool leave_connection_closed)
-{
-    // brackets for the empty array
-    size_t payload_size = 2;
+    // ["event",...], quotes around each name and commas between them
+    size_t payload_size = 2 + (events.empty() ? 0 : events.size() - 1);
     for (sway::event_type event : events)
     {
         payload_size += event_type_to_string(event).size() + 2;
     }
-    payload_size += events.size() - 1;
+    _write_buffer.allocate(payload_size);
+    char* payload_ptr = _write_buffer.ptr();
+    *payload_ptr++ = '[';
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        if (i != 0)
+        {
+            *payload_ptr++ = ',';
+        }
+        *payload_ptr++ = '"';
+        payload_ptr = std::ranges::copy(event_type_to_string(events[i]), payload_ptr).out;
+        *payload_ptr++ = '"';
+    }
+    *payload_ptr = ']';
 
-    _write_buffer.allocate(sizeof(message_header) + payload_size);
+    // header and payload are written together by exchange, and reply is parsed by parser of events
+    std::expected<simdjson::ondemand::document, error_desc> request_result =
+        exchange(_event_frames, _event_socket.get(), std::string_view(_write_buffer.ptr(), payload_size),
+            payload_type::subscribe).and_then([this](frame response)
+        {
+            return parse_payload(_event_parser, response.payload, response.length);
+        });
+    if (!request_result.has_value())
+    {
+        _event_socket.reset();
+        return subscribe_result{false, std::move(request_result.error())};
+    }
 
-    message_header* header_ptr = new(_write_buffer.ptr()) message_header;
-    header_ptr->length = payload_size;
-    header_ptr->payload_type = payload_type::subscribe;
-    char* payload_ptr = _write_buffer.ptr() + sizeof(message_header);
+    simdjson::simdjson_result<bool> success = request_result.value().find_field("success").get_bool();
+    if (success.error() != simdjson::error_code::SUCCESS)
+    {
+        _event_socket.reset();
+        return subscribe_result{false, sway::error_desc(success.error(),
+            sway::error_desc::operation::parse_subscribe_reply)};
+    }
+    else if (!success.value_unsafe())
+    {
+        _event_socket.reset();
+        return subscribe_result{false, std::nullopt};
+    }
 
-    // TODO: write something nicer
-    if (events.size() == 0)
+    _subscribed_events = 0;
+    for (sway::event_type event : events)
     {
-        *payload_ptr++ = '[';
-        *payload_ptr = ']';
+        _subscribed_events |= event_bit(event);
     }
-    else if (events.size() == 1)
+    _event_filters = filters;
+    // events from before subscription were not seen
+    invalidate_replies(true);
+    return subscribe_result{true, std::nullopt};
+}
+
+std::optional<error_desc> ipc::close_subscription()
+{
+    // the only way to unsubscribe is to close connection, query connection stays as it was
+    const int event_fd = _event_socket.release();
+    _event_function = nullptr;
+    _event_frames.clear();
+    _subscribed_events = 0;
+    _event_filters = {};
+    if (event_fd && ::close(event_fd))
     {
-        payload_ptr = std::format_to(payload_ptr, "[\"{}\"]", event_type_to_string(events.front()));
+        return error_desc{error_desc::operation::close_socket};
     }
-    else
+    return std::nullopt;
+}
+
+std::expected<void, error_desc> ipc::read_burst(const coalesce_options& coalesce)
+{
+    // frames are not taken out of buffer until burst is over, so growing
+    // buffer does not invalidate frames of this burst
+    // first event of burst is awaited without timeout
+    while (!_event_frames.has_frame())
     {
-        payload_ptr = std::format_to(payload_ptr, "[\"{}\"", event_type_to_string(events.front()));
-        for (sway::event_type event : std::ranges::views::drop(events, 1))
+        std::expected<size_t, error_desc> fill_result = _event_frames.fill(_event_socket.get());
+        if (!fill_result.has_value())
         {
-            payload_ptr = std::format_to(payload_ptr, ",\"{}\"", event_type_to_string(event));
+            return std::unexpected(std::move(fill_result.error()));
         }
-        *payload_ptr = ']';
     }
 
-    std::expected<void, sway::error_desc> write_result =
-        blocking_write(_socket.get(), header_ptr->magic, header_size + payload_size);
-    if (!write_result.has_value())
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + coalesce.max_duration;
+    pollfd poll_fd{_event_socket.get(), POLLIN, 0};
+    while (_event_frames.count_frames(coalesce.max_events) < coalesce.max_events)
     {
-        return subscribe_result{false, std::move(write_result.error())};
+        const auto remaining =
+            std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0)
+        {
+            break;
+        }
+        const int ready = ::poll(&poll_fd, 1, static_cast<int>(std::min(coalesce.quiet_window, remaining).count()));
+        if (ready == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return std::unexpected(error_desc(error_desc::operation::wait_events));
+        }
+        else if (ready == 0)
+        {
+            // quiet, or deadline
+            break;
+        }
+
+        std::expected<size_t, error_desc> fill_result = _event_frames.fill(_event_socket.get());
+        if (!fill_result.has_value())
+        {
+            return std::unexpected(std::move(fill_result.error()));
+        }
     }
 
-    std::expected<response_data, sway::error_desc> request_result = read_response(_read_buffer, _socket.get(), _parser);
-    if (!request_result.has_value())
+    return split_burst(coalesce.max_events);
+}
+
+std::expected<frame, error_desc> ipc::read_event_frame()
+{
+    while (true)
     {
-        return subscribe_result{false, std::move(request_result.error())};
+        std::expected<frame, error_desc> frame_result = read_frame(_event_frames, _event_socket.get());
+        if (!frame_result.has_value())
+        {
+            return frame_result;
+        }
+        note_event(frame_result.value());
+        if (passes(_event_filters, frame_result.value()))
+        {
+            return frame_result;
+        }
     }
+}
 
-    simdjson::simdjson_result<bool> success = request_result.value().json.find_field("success").get_bool();
-    if (success.error() != simdjson::error_code::SUCCESS)
+std::expected<void, error_desc> ipc::split_burst(size_t max_events)
+{
+    _burst.clear();
+    for (size_t taken = 0; taken < max_events; ++taken)
     {
-        return subscribe_result{false, sway::error_desc(success.error(),
-            "Failed to parse response from sway, when attempting to subscribe to event(s)")};
+        std::expected<std::optional<frame>, error_desc> frame_result = _event_frames.next_frame();
+        if (!frame_result.has_value())
+        {
+            return std::unexpected(std::move(frame_result.error()));
+        }
+        else if (!frame_result->has_value())
+        {
+            // incomplete event, if any, is left for the next burst
+            return {};
+        }
+        note_event(frame_result->value());
+        if (passes(_event_filters, frame_result->value()))
+        {
+            _burst.push_back(frame_result->value());
+        }
     }
-    else if (!success.value_unsafe())
+    // the rest is left for the next burst
+    return {};
+}
+
+void ipc::reserve_burst(size_t max_events)
+{
+    _burst.reserve(max_events);
+    _burst_keys.reserve(max_events);
+    _burst_delivered.reserve(max_events);
+}
+
+bool ipc::deliver_event(event_sink sink, event_result event)
+{
+    const bool should_unsubscribe = sink(std::move(event));
+    // objects decoded from event are not needed after callback, as the event itself
+    _event_arena.reset();
+    return should_unsubscribe;
+}
+
+bool ipc::deliver_burst(event_sink sink, enum coalesce_options::mode mode)
+{
+    _burst_delivered.assign(_burst.size(), true);
+    size_t remaining = _burst.size();
+
+    if (mode == coalesce_options::mode::collapse)
     {
-        return subscribe_result{false, std::nullopt};
+        // the last event of each key survives, so go from the end
+        _burst_keys.clear();
+        for (size_t i = _burst.size(); i-- > 0;)
+        {
+            const std::optional<event_key> key = raw_event_key(_burst[i]);
+            if (!key.has_value())
+            {
+                continue;
+            }
+            else if (std::ranges::find(_burst_keys, key.value()) != _burst_keys.end())
+            {
+                _burst_delivered[i] = false;
+                --remaining;
+            }
+            else
+            {
+                _burst_keys.push_back(key.value());
+            }
+        }
     }
 
-    bool should_unsubscribe;
-    do
+    for (size_t i = 0; i < _burst.size(); ++i)
     {
-        event_result response_result = read_response(_read_buffer, _socket.get(), _parser)
-            .transform([](response_data response)
+        if (!_burst_delivered[i])
+        {
+            continue;
+        }
+
+        --remaining;
+        const frame& event_frame = _burst[i];
+        event_result event = parse_payload(_event_parser, event_frame.payload, event_frame.length)
+            .transform([&event_frame, remaining](simdjson::ondemand::document json)
             {
-                return event_payload{sway::event_type(response.payload_type), std::move(response.json)};
+                return event_payload{sway::event_type(event_frame.payload_type), std::move(json), remaining};
             });
-        should_unsubscribe = function(std::move(response_result));
+        if (deliver_event(sink, std::move(event)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+ipc::subscribe_result ipc::subscribe(std::span<sway::event_type> events,
+    std::function<bool(ipc::event_result)> function, coalesce_options coalesce, std::span<const event_filter> filters)
+{
+    return subscribe_sink(events, event_sink::to_function(function), coalesce, filters);
+}
+
+ipc::subscribe_result ipc::subscribe_sink(std::span<sway::event_type> events, event_sink sink,
+    coalesce_options coalesce, std::span<const event_filter> filters)
+{
+    subscribe_result result = open_subscription(events, filters);
+    if (!result.subscription_successful || result.error.has_value())
+    {
+        return result;
+    }
+    if (coalesce.mode != coalesce_options::mode::none)
+    {
+        reserve_burst(coalesce.max_events);
+    }
+
+    bool should_unsubscribe;
+    do
+    {
+        if (coalesce.mode == coalesce_options::mode::none)
+        {
+            event_result response_result = read_event_frame()
+                .and_then([this](frame event_frame)
+                {
+                    return parse_payload(_event_parser, event_frame.payload, event_frame.length)
+                        .transform([&event_frame](simdjson::ondemand::document json)
+                        {
+                            return event_payload{sway::event_type(event_frame.payload_type), std::move(json)};
+                        });
+                });
+            should_unsubscribe = deliver_event(sink, std::move(response_result));
+            continue;
+        }
+
+        std::expected<void, error_desc> burst_result = read_burst(coalesce);
+        should_unsubscribe = burst_result.has_value() ?
+            deliver_burst(sink, coalesce.mode) :
+            deliver_event(sink, std::unexpected(std::move(burst_result.error())));
     }
     while(!should_unsubscribe);
 
-    std::expected<void, error_desc> unsubscribe_result = disconnect().and_then(
-        [this, leave_connection_closed]()
+    return subscribe_result{true, close_subscription()};
+}
+
+ipc::subscribe_result ipc::subscribe_nonblocking(std::span<sway::event_type> events,
+    std::function<bool(ipc::event_result)> function, coalesce_options coalesce, std::span<const event_filter> filters)
+{
+    // dispatch calls function long after this returns, so it is kept inside ipc
+    _event_function = std::move(function);
+    return subscribe_nonblocking_sink(events, event_sink::to_function(_event_function), coalesce, filters);
+}
+
+ipc::subscribe_result ipc::subscribe_nonblocking_sink(std::span<sway::event_type> events, event_sink sink,
+    coalesce_options coalesce, std::span<const event_filter> filters)
+{
+    subscribe_result result = open_subscription(events, filters);
+    if (!result.subscription_successful || result.error.has_value())
+    {
+        return result;
+    }
+
+    const int flags = ::fcntl(_event_socket.get(), F_GETFL);
+    if (flags == -1 || ::fcntl(_event_socket.get(), F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        error_desc error{error_desc::operation::make_nonblocking};
+        close_subscription();
+        return subscribe_result{true, std::move(error)};
+    }
+
+    _event_sink = sink;
+    _coalesce = coalesce;
+    if (coalesce.mode != coalesce_options::mode::none)
+    {
+        reserve_burst(coalesce.max_events);
+    }
+    return result;
+}
+
+int ipc::event_fd() const
+{
+    return _event_socket.get();
+}
+
+bool ipc::subscribed() const
+{
+    return event_fd() != 0;
+}
+
+std::expected<size_t, error_desc> ipc::dispatch()
+{
+    const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    size_t dispatched = 0;
+    while (subscribed())
+    {
+        std::expected<size_t, error_desc> fill_result = _event_frames.fill(_event_socket.get());
+        if (!fill_result.has_value())
         {
-            return !leave_connection_closed ? connect() : std::expected<void, error_desc>{};
-        });
-    
-    return subscribe_result{true, !unsubscribe_result.has_value() ? std::optional(unsubscribe_result.error()) : std::nullopt};
+            close_subscription();
+            return std::unexpected(std::move(fill_result.error()));
+        }
+
+        if (_coalesce.mode != coalesce_options::mode::none)
+        {
+            // frames are split only when socket has nothing more, or burst reached its bound,
+            // so they all stay valid together. Socket left unread makes event loop call dispatch again
+            if (fill_result.value() != 0 &&
+                _event_frames.count_frames(_coalesce.max_events) < _coalesce.max_events &&
+                std::chrono::steady_clock::now() - started < _coalesce.max_duration)
+            {
+                continue;
+            }
+
+            // what is read already is not reported by epoll again, so it is delivered now,
+            // in bursts of at most max_events
+            do
+            {
+                std::expected<void, error_desc> split_result = split_burst(_coalesce.max_events);
+                if (!split_result.has_value())
+                {
+                    close_subscription();
+                    return std::unexpected(std::move(split_result.error()));
+                }
+
+                dispatched += _burst.size();
+                if (deliver_burst(_event_sink, _coalesce.mode))
+                {
+                    std::optional<error_desc> close_error = close_subscription();
+                    if (close_error.has_value())
+                    {
+                        return std::unexpected(std::move(close_error.value()));
+                    }
+                    return dispatched;
+                }
+            }
+            while (_event_frames.has_frame());
+            return dispatched;
+        }
+
+        while (true)
+        {
+            std::expected<std::optional<frame>, error_desc> frame_result = _event_frames.next_frame();
+            if (!frame_result.has_value())
+            {
+                // stream is not synchronized anymore, there is no way to find next message
+                close_subscription();
+                return std::unexpected(std::move(frame_result.error()));
+            }
+            else if (!frame_result->has_value())
+            {
+                break;
+            }
+
+            const frame& event_frame = frame_result->value();
+            note_event(event_frame);
+            if (!passes(_event_filters, event_frame))
+            {
+                continue;
+            }
+            event_result event = parse_payload(_event_parser, event_frame.payload, event_frame.length)
+                .transform([&event_frame](simdjson::ondemand::document json)
+                {
+                    return event_payload{sway::event_type(event_frame.payload_type), std::move(json)};
+                });
+            ++dispatched;
+            if (deliver_event(_event_sink, std::move(event)))
+            {
+                std::optional<error_desc> close_error = close_subscription();
+                if (close_error.has_value())
+                {
+                    return std::unexpected(std::move(close_error.value()));
+                }
+                return dispatched;
+            }
+        }
+
+        // socket has nothing more right now
+        if (fill_result.value() == 0)
+        {
+            break;
+        }
+    }
+    return dispatched;
+}
+
+std::expected<void, error_desc> ipc::unsubscribe()
+{
+    std::optional<error_desc> close_error = close_subscription();
+    if (close_error.has_value())
+    {
+        return std::unexpected(std::move(close_error.value()));
+    }
+    return {};
 }
 
 ipc::request_result ipc::get_outputs()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_outputs);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_outputs);
 }
 
 ipc::request_result ipc::get_tree()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_tree);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_tree);
 }
 
 ipc::request_result ipc::get_marks()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_marks);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_marks);
 }
 
 ipc::request_result ipc::get_bar_config()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_bar_config);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_bar_config);
 }
 
 ipc::request_result ipc::get_bar_config(const std::string_view bar_id)
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), bar_id, _parser, payload_type::get_bar_config);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), bar_id, _parser, _reply_arena, payload_type::get_bar_config);
 }
 
 ipc::request_result ipc::get_version()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_version);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_version);
 }
 
 ipc::request_result ipc::get_binding_modes()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_binding_modes);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_binding_modes);
 }
 
 ipc::request_result ipc::get_config()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_config);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_config);
 }
 
 //=================================================================================================================
 std::expected<bool, sway::error_desc> ipc::send_tick(std::string_view payload)
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer, 
-        _socket.get(), payload, _parser, payload_type::send_tick).and_then(
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), payload, _parser, _reply_arena, payload_type::send_tick).and_then(
     [](simdjson::ondemand::document document) -> std::expected<bool, sway::error_desc>
     {
         simdjson::simdjson_result<bool> success = document.find_field("success").get_bool();
         if (success.error() != simdjson::error_code::SUCCESS)
         {
             return std::unexpected(sway::error_desc(success.error(),
-                "error parsing response from SEND_TICK"));
+                sway::error_desc::operation::parse_tick_reply));
         }
         else
         {
@@ -732,18 +848,72 @@ std::expected<bool, sway::error_desc> ipc::send_tick(std::string_view payload)
     });
 }
 
+std::expected<bool, sway::error_desc> ipc::event_barrier(std::chrono::milliseconds timeout)
+{
+    if (!subscribed() || (_subscribed_events & event_bit(event_type::tick)) == 0)
+    {
+        return std::unexpected(error_desc(error_desc::invalid_error_code::not_subscribed,
+            error_desc::operation::event_barrier));
+    }
+
+    // ticks of other clients come to subscription too, so payload tells process and call apart
+    static std::atomic<uint64_t> barrier_count = 0;
+    // formatted by to_chars, so barrier does not allocate once payload has capacity. Space after each
+    // number keeps payload of call 1 from being found inside payload of call 12
+    char number[std::numeric_limits<uint64_t>::digits10 + 1];
+    _barrier_payload.assign("sway_ipc barrier ");
+    const uint64_t call = barrier_count.fetch_add(1, std::memory_order_relaxed);
+    for (const uint64_t part : {static_cast<uint64_t>(::getpid()), call})
+    {
+        _barrier_payload.append(number, std::to_chars(std::begin(number), std::end(number), part).ptr);
+        _barrier_payload.push_back(' ');
+    }
+    _barrier_reached = false;
+
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+    std::expected<bool, sway::error_desc> result = send_tick(_barrier_payload);
+    while (result.has_value() && result.value() && !_barrier_reached)
+    {
+        // events buffered already are dispatched without waiting
+        std::expected<size_t, error_desc> dispatch_result = dispatch();
+        if (!dispatch_result.has_value())
+        {
+            result = std::unexpected(std::move(dispatch_result.error()));
+            break;
+        }
+        else if (_barrier_reached || !subscribed())
+        {
+            break;
+        }
+
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0)
+        {
+            break;
+        }
+        pollfd poll_fd{_event_socket.get(), POLLIN, 0};
+        if (::poll(&poll_fd, 1, static_cast<int>(remaining.count())) == -1 && errno != EINTR)
+        {
+            result = std::unexpected(error_desc(error_desc::operation::wait_events));
+        }
+    }
+
+    _barrier_payload.clear();
+    return result.transform([this](bool) { return _barrier_reached; });
+}
+
 //=================================================================================================================
 std::expected<std::string_view, sway::error_desc> ipc::get_binding_state()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer, 
-        _socket.get(), {}, _parser, payload_type::get_binding_state).and_then(
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_binding_state).and_then(
     [](simdjson::ondemand::document document) -> std::expected<std::string_view, sway::error_desc>
     {
         simdjson::simdjson_result<std::string_view> success = document.find_field("name").get_string();
         if (success.error() != simdjson::error_code::SUCCESS)
         {
             return std::unexpected(sway::error_desc(success.error(),
-                "error parsing response from SEND_TICK"));
+                sway::error_desc::operation::parse_binding_state_reply));
         }
         else
         {
@@ -755,14 +925,206 @@ std::expected<std::string_view, sway::error_desc> ipc::get_binding_state()
 //=================================================================================================================
 ipc::request_result ipc::get_inputs()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_inputs);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_inputs);
 }
 
 //=================================================================================================================
 ipc::request_result ipc::get_seats()
 {
-    return send_command_with_precomputed_payload(_write_buffer, _read_buffer,
-        _socket.get(), {}, _parser, payload_type::get_seats);
+    return send_command_with_precomputed_payload(_read_frames,
+        _socket.get(), {}, _parser, _reply_arena, payload_type::get_seats);
+}
+
+//=================================================================================================================
+size_t ipc::batch::add(payload_type payload_type, std::string_view payload)
+{
+    if (_size == _slots.size())
+    {
+        _slots.emplace_back();
+    }
+
+    slot& new_slot = _slots[_size];
+    new_slot.header.length = payload.size();
+    new_slot.header.payload_type = payload_type;
+    new_slot.payload = payload;
+    new_slot.result.reset();
+    return _size++;
+}
+
+std::expected<void, error_desc> ipc::send_batch(batch& batch)
+{
+    if (batch.size() == 0)
+    {
+        return {};
+    }
+
+    _reply_arena.reset();
+    _write_iovecs.clear();
+    for (const batch::slot& request : std::ranges::views::take(batch._slots, batch.size()))
+    {
+        // writing not whole structure, but starting from magic
+        _write_iovecs.push_back({const_cast<char*>(request.header.magic), header_size});
+        if (!request.payload.empty())
+        {
+            _write_iovecs.push_back({const_cast<char*>(request.payload.data()), request.payload.size()});
+        }
+    }
+
+    std::expected<void, error_desc> write_result = blocking_writev(_socket.get(), _write_iovecs);
+    if (!write_result.has_value())
+    {
+        return write_result;
+    }
+
+    for (batch::slot& request : std::ranges::views::take(batch._slots, batch.size()))
+    {
+        std::expected<frame, error_desc> response = read_frame(_read_frames, _socket.get());
+        if (!response.has_value())
+        {
+            // sway errors are reported in json, so this is broken connection
+            return std::unexpected(std::move(response.error()));
+        }
+
+        // replies are read together, and frame buffer is reused by the next request, so each
+        // reply is moved into buffer of its own, to keep all documents of the batch valid
+        request.read_buffer.allocate(response->length + simdjson::SIMDJSON_PADDING);
+        std::memcpy(request.read_buffer.ptr(), response->payload, response->length);
+        request.result.emplace(parse_payload(request.parser, request.read_buffer.ptr(), response->length));
+    }
+    return {};
+}
+
+//=================================================================================================================
+template <typename T>
+std::expected<const T*, error_desc> ipc::fetch_cached(cached_reply<T>& reply, cached_request request,
+    payload_type payload_type, uint32_t required_events)
+{
+    // taken before request, so event which arrives meanwhile makes the next call fetch again
+    const uint64_t generation = _reply_generations[size_t(request)].load(std::memory_order_acquire);
+    if (reply.value.has_value() && reply.generation == generation &&
+        (_subscribed_events & required_events) == required_events)
+    {
+        return &reply.value.value();
+    }
+
+    reply.value.reset();
+    reply.decoded.reset();
+    _reply_arena.reset();
+    std::expected<frame, error_desc> response = exchange(_read_frames, _socket.get(), {}, payload_type);
+    if (!response.has_value())
+    {
+        return std::unexpected(std::move(response.error()));
+    }
+
+    // copied out of frame buffer, which is reused by the next request, the same way batch does it
+    reply.raw.allocate(response->length + simdjson::SIMDJSON_PADDING);
+    std::memcpy(reply.raw.ptr(), response->payload, response->length);
+    return parse_payload(reply.parser, reply.raw.ptr(), response->length)
+        .and_then(decode_with<T>(&reply.decoded))
+        .transform([&reply, generation](T value)
+        {
+            reply.generation = generation;
+            return &reply.value.emplace(std::move(value));
+        });
+}
+
+std::expected<std::span<const sway::output>, error_desc> ipc::cached_outputs()
+{
+    // current_workspace of output changes with workspace focus
+    return fetch_cached(_cached_outputs, cached_request::outputs, payload_type::get_outputs,
+        event_bit(event_type::output) | event_bit(event_type::workspace))
+        .transform([](const std::pmr::vector<sway::output>* outputs)
+        {
+            return std::span<const sway::output>(*outputs);
+        });
+}
+
+std::expected<std::span<const sway::cached_workspace>, error_desc> ipc::cached_workspaces()
+{
+    return fetch_cached(_cached_workspaces, cached_request::workspaces, payload_type::get_workspaces,
+        event_bit(event_type::workspace) | event_bit(event_type::output))
+        .transform([](const std::pmr::vector<sway::cached_workspace>* workspaces)
+        {
+            return std::span<const sway::cached_workspace>(*workspaces);
+        });
+}
+
+std::expected<std::span<const std::string_view>, error_desc> ipc::cached_binding_modes()
+{
+    return fetch_cached(_cached_binding_modes, cached_request::binding_modes, payload_type::get_binding_modes,
+        event_bit(event_type::workspace))
+        .transform([](const std::pmr::vector<std::string_view>* modes)
+        {
+            return std::span<const std::string_view>(*modes);
+        });
+}
+
+std::expected<const sway::version*, error_desc> ipc::cached_version()
+{
+    return fetch_cached(_cached_version, cached_request::version, payload_type::get_version, 0);
+}
+
+uint64_t ipc::reply_generation(payload_type payload_type) const
+{
+    switch (payload_type)
+    {
+        case payload_type::get_outputs:
+            return _reply_generations[size_t(cached_request::outputs)].load(std::memory_order_acquire);
+        case payload_type::get_workspaces:
+            return _reply_generations[size_t(cached_request::workspaces)].load(std::memory_order_acquire);
+        case payload_type::get_binding_modes:
+            return _reply_generations[size_t(cached_request::binding_modes)].load(std::memory_order_acquire);
+        case payload_type::get_version:
+            return _reply_generations[size_t(cached_request::version)].load(std::memory_order_acquire);
+        default:
+            return 0;
+    }
+}
+
+void ipc::note_event(const frame& event_frame)
+{
+    auto bump = [this](cached_request request)
+    {
+        _reply_generations[size_t(request)].fetch_add(1, std::memory_order_release);
+    };
+
+    switch (sway::event_type(event_frame.payload_type))
+    {
+        case event_type::workspace:
+            bump(cached_request::outputs);
+            bump(cached_request::workspaces);
+            // binding modes are read from config
+            if (raw_change(event_frame) == "reload")
+            {
+                bump(cached_request::binding_modes);
+            }
+            break;
+        case event_type::output:
+            bump(cached_request::outputs);
+            bump(cached_request::workspaces);
+            break;
+        case event_type::tick:
+            // payload of barrier has nothing json would escape, so it is found as it is
+            if (!_barrier_payload.empty() &&
+                std::string_view(event_frame.payload, event_frame.length).find(_barrier_payload) != std::string_view::npos)
+            {
+                _barrier_reached = true;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void ipc::invalidate_replies(bool keep_version)
+{
+    for (size_t request = 0; request < cached_request_count; ++request)
+    {
+        if (!keep_version || request != size_t(cached_request::version))
+        {
+            _reply_generations[request].fetch_add(1, std::memory_order_release);
+        }
+    }
 }
 } // namespace sway
@@ -1,49 +1,103 @@
 #pragma once
+#include <sway_ipc/arena.hpp>
+#include <sway_ipc/error_desc.hpp>
+#include <sway_ipc/events/event_filter.hpp>
+#include <sway_ipc/events/event_handler.hpp>
 #include <sway_ipc/events/event_type.hpp>
+#include <sway_ipc/frame_buffer.hpp>
+#include <sway_ipc/message.hpp>
+#include <sway_ipc/replies.hpp>
 #include <sway_ipc/sized_buffer.hpp>
 #include <simdjson.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <expected>
 #include <functional>
+#include <memory_resource>
+#include <span>
+#include <vector>
+#include <sys/uio.h>
 
 namespace sway
 {
-struct error_desc
+// sway sends events in storms (moving workspace with many windows sends window
+// event for each one of them). Coalescing lets callback do its work once per storm
+struct coalesce_options
 {
-    enum class error_source : uint8_t
+    enum class mode : uint8_t
     {
-        // error returned by standard C or posix function (like popen, fread, socket, e.t.c)
-        posix,
-        // error returned by sway process
-        sway,
-        // everything worked without error, but sway returned invalid output
-        invalid,
-        // json sent by by sway was invalid, or had unexpected structure
-        parsing_error
+        // every event is delivered as soon as it is read
+        none,
+        // events are held until socket stays quiet for quiet_window, and then
+        // delivered one after another, remaining_in_burst tells where burst ends
+        batch,
+        // like batch, but of events of the same type, change and container (or workspace) only
+        // the last one is delivered, see raw_event_key. Binding and tick events are never collapsed
+        collapse
     };
 
-    enum class invalid_error_code : int
+    enum mode mode = mode::none;
+    // burst is over when nothing arrived for this long. 0 delivers what was already
+    // queued in socket. Ignored by dispatch, which delivers everything it read in one go
+    // (in bursts of at most max_events)
+    std::chrono::milliseconds quiet_window{0};
+    // burst is over when it is that old, or has that many events, even if socket is not quiet yet,
+    // so steady stream of events can not hold it back, and buffers of burst do not grow without end.
+    // Events read beyond max_events are delivered as the next burst. max_events should be at least 1
+    std::chrono::milliseconds max_duration{100};
+    size_t max_events = 256;
+};
+
+// threaded subscription. Reader thread only takes events from socket, and copies them into
+// queues of worker threads, which parse them and call function. Slow function does not stop
+// reading, so sway never waits for its send buffer to be read
+struct fanout_options
+{
+    // what reader does with event, when queue of its worker is full
+    enum class overflow : uint8_t
+    {
+        // waits until worker takes event. Events wait in socket meanwhile, as without threads
+        block,
+        // keeps up to queue_capacity events more, dropping the oldest of them
+        drop_oldest,
+        // like drop_oldest, but held event of the same type, change and container (or workspace) is
+        // replaced by the new one first, see raw_event_key. Binding and tick events are never replaced
+        coalesce
+    };
+
+    // which worker gets event
+    enum class routing : uint8_t
     {
-        // sway --get-socketpath returned path to socket, which was too long to put inside sockaddr_un
-        // which makes it impossible to create socket from it
-        path_to_socket_too_long,
-        // in sway response message, magic string was wrong
-        magic_string_was_wrong,
-        // sway returned message with negative payload length
-        negative_payload_length
+        // events of one type go to the same worker, so their order is kept. Subscription to window
+        // events only keeps one worker busy, however many there are
+        event_type,
+        // events of one container (or workspace, for workspace events) go to the same worker, see
+        // raw_event_key, the rest go by type. Order of events of one container is kept, while events
+        // of different containers could be handled in any order, like focus of one window after focus of another
+        container
     };
 
-    // used with error_source posix, error_code is set to errno
-    error_desc(std::string error_description);
-    // used with error_source sway, error_code is set to sway_return_code
-    error_desc(int sway_return_code, std::string error_description);
-    // sway returned invalid output, error_code made up by me and placed enum error_code
-    error_desc(invalid_error_code error_code, std::string error_description);
-    error_desc(simdjson::error_code error_code, std::string error_description);
-
-    // value of errno at the moment of error
-    std::string error_description;
-    int error_code;
-    enum error_source error_source;
+    // rounded up to power of two. remaining_in_burst counts only events in queue, not the ones reader
+    // holds because queue is full, so with drop_oldest and coalesce 0 does not mean nothing more is coming
+    size_t queue_capacity = 64;
+    size_t workers = 1;
+    enum overflow overflow = overflow::block;
+    enum routing routing = routing::event_type;
+};
+
+// backpressure metrics of threaded subscription, updated while it runs
+struct fanout_stats
+{
+    std::atomic<uint64_t> read{0};
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> coalesced{0};
+    // times reader found queue full
+    std::atomic<uint64_t> overflows{0};
+    // the deepest any queue was, held events not counted
+    std::atomic<size_t> max_queue_depth{0};
 };
 
 class ipc
@@ -56,7 +110,11 @@ public:
     ipc(simdjson::ondemand::parser& parser, bool print_errors_on_destroy = false);
     ~ipc();
 
+    // looks for socket in SWAYSOCK, I3SOCK and $XDG_RUNTIME_DIR/sway-ipc.*.sock, and only
+    // if none found asks sway --get-socketpath. Found path is remembered, so reconnecting
+    // does not search again, unless remembered socket stopped accepting connections
     std::expected<void, error_desc> connect();
+    // path is remembered and used by connect() without arguments afterwards
     std::expected<void, error_desc> connect(std::string_view socket_path);
 
     // if error returned, disconnect should not be called twice.
@@ -71,12 +129,26 @@ public:
 
     // commands is a list of commands sent to execute. 
     // There is overload which sends only one string as it is
-    // Each command can be itself list of comma separated commands
-    std::expected<std::vector<std::expected<void, run_error>>, error_desc>
+    // Each command can be itself list of comma separated commands.
+    // Results are in reply arena, and are valid until next request, as any other reply
+    std::expected<std::pmr::vector<std::expected<void, run_error>>, error_desc>
         run_commands(const std::span<std::string> commands);
-    std::expected<std::vector<std::expected<void, run_error>>, error_desc>
+    std::expected<std::pmr::vector<std::expected<void, run_error>>, error_desc>
         run_commands(const std::string_view commands);
 
+    //=================================================================================================================
+    // memory for objects which live as long as one message, pass it to sway::decode_with.
+    // Reply arena is reset by every request, event arena after every event callback returns,
+    // so steady stream of events and replies does not allocate after the biggest one was seen
+    std::pmr::memory_resource* reply_arena() { return &_reply_arena; }
+    std::pmr::memory_resource* event_arena() { return &_event_arena; }
+
+    // receive buffers and parsers keep the size of the biggest message seen. Call it when connection was idle
+    // for a while, to give back memory above the biggest size needed since the previous call.
+    // Buffers still holding part of a message are left as they are. Documents of earlier replies
+    // and events are invalidated
+    void shrink_buffers();
+
     //=================================================================================================================
     using request_result = std::expected<simdjson::ondemand::document, error_desc>;
 
@@ -88,14 +160,20 @@ public:
     {
         sway::event_type event_type;
         simdjson::ondemand::document json;
+        // with coalescing, number of events of the same burst, delivered after this one.
+        // 0 means that this is the last one, and burst is over. Always 0 without coalescing
+        size_t remaining_in_burst = 0;
     };
 
     using event_result = std::expected<event_payload, error_desc>;
 
     // function should return true if we should unsubscribe
-    // since the only way to unsubscribe is to close connection, by default connection
-    // will be reopened after closing connection. That is, 
-    // unless you pass leave_connection_closed being true
+    // events are read from separate connection, opened for the time of subscription, so
+    // function can call get_tree and other requests without dropping subscription.
+    // Event document lives in parser owned by ipc, and stays valid during these requests.
+    // connect() does not have to be called before subscribe, unless function sends requests.
+    // Events rejected by filters are not parsed and not given to function, see events/event_filter.hpp.
+    // Filters are not copied, and should live until subscription is closed
     struct subscribe_result
     {
         // subscription_successful and existence of error are independent
@@ -104,7 +182,66 @@ public:
     };
 
     subscribe_result subscribe(std::span<sway::event_type> events,
-        std::function<bool(event_result)> function, bool leave_connection_closed = false);
+        std::function<bool(event_result)> function, coalesce_options coalesce = {},
+        std::span<const event_filter> filters = {});
+
+    // event loop mode. Subscribes the same way, but returns right after sway confirmed subscription.
+    // Events are read only by dispatch, which never blocks. Put event_fd() into epoll (or sway::event_loop)
+    // and call dispatch when it is readable. Subscription is closed when function returns true
+    subscribe_result subscribe_nonblocking(std::span<sway::event_type> events,
+        std::function<bool(event_result)> function, coalesce_options coalesce = {},
+        std::span<const event_filter> filters = {});
+
+    // typed subscription, see events/event_handler.hpp. Events are taken from overloads of handler,
+    // filters from its event_filters, if it has them
+    template <typename Handler>
+    subscribe_result subscribe(Handler& handler, coalesce_options coalesce = {})
+    {
+        std::array events = detail::handled_events<Handler, event_payload>();
+        return subscribe_sink(events, event_sink::to_handler(handler), coalesce,
+            detail::handler_filters<Handler>());
+    }
+
+    // handler is not copied, and should live until subscription is closed
+    template <typename Handler>
+    subscribe_result subscribe_nonblocking(Handler& handler, coalesce_options coalesce = {})
+    {
+        std::array events = detail::handled_events<Handler, event_payload>();
+        return subscribe_nonblocking_sink(events, event_sink::to_handler(handler), coalesce,
+            detail::handler_filters<Handler>());
+    }
+
+    // blocks like subscribe, but function is called on worker threads, see fanout_options.
+    // remaining_in_burst is number of events queued for the same worker after this one, see fanout_options.
+    // With more than one worker function is called concurrently, and should not share ipc between
+    // calls. With one worker function can send requests as usual, event_arena() is not to be used.
+    // Filters are applied by reader, so rejected events are not even queued
+    subscribe_result subscribe_threaded(std::span<sway::event_type> events,
+        std::function<bool(event_result)> function, fanout_options options = {},
+        std::span<const event_filter> filters = {});
+
+    template <typename Handler>
+    subscribe_result subscribe_threaded(Handler& handler, fanout_options options = {})
+    {
+        std::array events = detail::handled_events<Handler, event_payload>();
+        return subscribe_threaded_sink(events, event_sink::to_handler(handler), options,
+            detail::handler_filters<Handler>());
+    }
+
+    // of the current or the last threaded subscription
+    const fanout_stats& fanout_statistics() const { return _fanout_stats; }
+
+    // socket of subscription, 0 if there is no subscription
+    int event_fd() const;
+    bool subscribed() const;
+
+    // reads everything event socket has, and calls function for each complete event.
+    // Incomplete event is kept until the rest of it arrives. Returns number of events dispatched.
+    // On error subscription is closed, since stream can not be trusted after it
+    std::expected<size_t, error_desc> dispatch();
+
+    // closes subscription without waiting for function to ask for it. Function itself should return true instead
+    std::expected<void, error_desc> unsubscribe();
 
 
     //=================================================================================================================
@@ -140,6 +277,14 @@ public:
     //=================================================================================================================
     std::expected<bool, sway::error_desc> send_tick(std::string_view payload);
 
+    // read-your-writes barrier of event loop mode. Tick with payload unique to the call is sent by
+    // command connection, and events are dispatched until subscription gets that tick. Sway handles
+    // messages of connection in order, and sends events in order they happen, so when this returns true,
+    // function of subscription got every event caused by commands and requests sent before it.
+    // Subscription should be made by subscribe_nonblocking and include tick events, tick of barrier
+    // is given to function as any other. Returns false on timeout, or if function unsubscribed first
+    std::expected<bool, sway::error_desc> event_barrier(std::chrono::milliseconds timeout);
+
 
     //=================================================================================================================
     std::expected<std::string_view, sway::error_desc> get_binding_state();
@@ -151,6 +296,60 @@ public:
 
     //=================================================================================================================
     request_result get_seats();
+
+
+    //=================================================================================================================
+    // requests sent together in one write. Sway answers in order, so replies are read one after
+    // another afterwards, which costs one round-trip for the whole batch instead of one per request.
+    // Each reply is parsed by its own parser into its own buffer, so all documents stay valid together,
+    // until the batch is sent again. Keep batch between refreshes to reuse parsers and buffers
+    class batch
+    {
+    public:
+        // payload should live until send_batch returns. Returns index of the reply
+        size_t add(payload_type payload_type, std::string_view payload = {});
+        size_t size() const { return _size; }
+        request_result& result(size_t index) { return _slots[index].result.value(); }
+        // forgets requests, but keeps parsers and buffers for the next ones
+        void clear() { _size = 0; }
+
+    private:
+        friend class ipc;
+
+        struct slot
+        {
+            message_header header;
+            std::string_view payload;
+            simdjson::ondemand::parser parser;
+            sized_buffer read_buffer;
+            std::optional<request_result> result;
+        };
+
+        // deque, since documents keep pointer to their parser, and parser should not move
+        std::deque<slot> _slots;
+        size_t _size = 0;
+    };
+
+    // error is returned only if connection failed, sway errors are in results of batch
+    std::expected<void, error_desc> send_batch(batch& batch);
+
+
+    //=================================================================================================================
+    // opt-in cache of replies, which change only together with events. Reply is copied, parsed and decoded
+    // once, and then served from memory, until subscription of this ipc reads event which changes it:
+    // outputs and workspaces are changed by output and workspace events, binding modes by config reload
+    // (workspace event with change reload), version only by reconnect. While ipc is not subscribed to these
+    // events, every call makes request, since nothing would tell that reply is stale.
+    // workspaces are cached without layout, which layout command changes without any event.
+    // Result is valid until the same cached request fetches reply again
+    std::expected<std::span<const sway::output>, error_desc> cached_outputs();
+    std::expected<std::span<const sway::cached_workspace>, error_desc> cached_workspaces();
+    std::expected<std::span<const std::string_view>, error_desc> cached_binding_modes();
+    std::expected<const sway::version*, error_desc> cached_version();
+
+    // grows every time reply of payload_type could have changed. Only request types of cache are
+    // counted, others are always 0
+    uint64_t reply_generation(payload_type payload_type) const;
 private:
     simdjson::ondemand::parser& _parser;
 
@@ -176,10 +375,133 @@ private:
         bool print_errors_on_destroy = false;
     };
 
+    // non-owning reference to whatever receives events, costs one indirect call per event
+    struct event_sink
+    {
+        void* context = nullptr;
+        bool (*function)(void* context, event_result event) = nullptr;
+
+        bool operator()(event_result event) const { return function(context, std::move(event)); }
+
+        template <typename F>
+        static event_sink to_function(F& function)
+        {
+            return {&function, [](void* context, event_result event)
+            {
+                return (*static_cast<F*>(context))(std::move(event));
+            }};
+        }
+
+        template <typename Handler>
+        static event_sink to_handler(Handler& handler)
+        {
+            return {&handler, [](void* context, event_result event)
+            {
+                Handler& handler = *static_cast<Handler*>(context);
+                if (!event.has_value())
+                {
+                    if constexpr (requires { { handler.on_error(event.error()) } -> std::convertible_to<bool>; })
+                    {
+                        return static_cast<bool>(handler.on_error(event.error()));
+                    }
+                    return true;
+                }
+                return detail::dispatch_event(handler, event.value());
+            }};
+        }
+    };
+
+    subscribe_result subscribe_sink(std::span<sway::event_type> events, event_sink sink, coalesce_options coalesce,
+        std::span<const event_filter> filters);
+    subscribe_result subscribe_nonblocking_sink(std::span<sway::event_type> events, event_sink sink,
+        coalesce_options coalesce, std::span<const event_filter> filters);
+    subscribe_result subscribe_threaded_sink(std::span<sway::event_type> events, event_sink sink,
+        fanout_options options, std::span<const event_filter> filters);
+
+    std::expected<void, error_desc> open_event_connection();
+    subscribe_result open_subscription(std::span<sway::event_type> events, std::span<const event_filter> filters);
+    std::optional<error_desc> close_subscription();
+    // reads until event accepted by filters, rejected ones are only noted
+    std::expected<frame, error_desc> read_event_frame();
+    // reads events until socket is quiet for quiet_window, or burst reaches one of its bounds,
+    // and splits them into _burst
+    std::expected<void, error_desc> read_burst(const coalesce_options& coalesce);
+    // splits up to max_events buffered events into _burst, leaving out events rejected by filters
+    std::expected<void, error_desc> split_burst(size_t max_events);
+    // so that burst of max_events does not allocate
+    void reserve_burst(size_t max_events);
+    // returns true if function asked to unsubscribe
+    bool deliver_event(event_sink sink, event_result event);
+    bool deliver_burst(event_sink sink, enum coalesce_options::mode mode);
+
+    enum class cached_request : uint8_t
+    {
+        outputs,
+        workspaces,
+        binding_modes,
+        version
+    };
+    static constexpr size_t cached_request_count = 4;
+
+    // reply of one request type, with its own parser and buffer, so it outlives other requests
+    template <typename T>
+    struct cached_reply
+    {
+        simdjson::ondemand::parser parser;
+        sized_buffer raw;
+        arena decoded{1024};
+        std::optional<T> value;
+        uint64_t generation = 0;
+    };
+
+    template <typename T>
+    std::expected<const T*, error_desc> fetch_cached(cached_reply<T>& reply, cached_request request,
+        payload_type payload_type, uint32_t required_events);
+    // bumps generations of replies changed by event. Called for every event read, collapsed ones included
+    void note_event(const frame& event_frame);
+    // version changes only with connection, not with subscription
+    void invalidate_replies(bool keep_version);
+
+    // connection used for commands and queries
     std::unique_ptr<nullable_fd, posix_close> _socket;
+    // connection in subscribed state, used only for reading events
+    std::unique_ptr<nullable_fd, posix_close> _event_socket;
+    std::string _socket_path;
     // std::unique_ptr<nullable_fd, posix_close> _log_file;
 
-    sized_buffer _read_buffer;
+    // replies are read with as few syscalls as possible, and parsed inside of this buffer
+    frame_buffer _read_frames;
+    // used only to build subscription request
     sized_buffer _write_buffer;
+    // reused between run_commands and send_batch calls, so command path does not allocate after warm-up
+    std::vector<iovec> _write_iovecs;
+    arena _reply_arena;
+
+    simdjson::ondemand::parser _event_parser;
+    arena _event_arena;
+    frame_buffer _event_frames;
+    // used in event loop mode only. Function is kept only if it was given as std::function
+    std::function<bool(event_result)> _event_function;
+    event_sink _event_sink;
+    coalesce_options _coalesce;
+    std::span<const event_filter> _event_filters;
+    // events of current burst, they all point into _event_frames
+    std::vector<frame> _burst;
+    // keys of events kept by collapse
+    std::vector<event_key> _burst_keys;
+    std::vector<bool> _burst_delivered;
+    fanout_stats _fanout_stats;
+
+    // bit per event_index of events current subscription gets
+    uint32_t _subscribed_events = 0;
+    // tick payload of barrier being waited for, empty when there is none
+    std::string _barrier_payload;
+    bool _barrier_reached = false;
+    // bumped by reader of events, which is not the thread of requests with subscribe_threaded
+    std::array<std::atomic<uint64_t>, cached_request_count> _reply_generations{};
+    cached_reply<std::pmr::vector<sway::output>> _cached_outputs;
+    cached_reply<std::pmr::vector<sway::cached_workspace>> _cached_workspaces;
+    cached_reply<std::pmr::vector<std::string_view>> _cached_binding_modes;
+    cached_reply<sway::version> _cached_version;
 };
 } // namespace sway
@@ -0,0 +1,142 @@
+#pragma once
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace sway
+{
+template <typename T>
+class task;
+
+namespace detail
+{
+struct task_promise_base
+{
+    // coroutine, which awaits this task, resumed when task finishes
+    std::coroutine_handle<> continuation;
+    // spawned tasks have no owner, and destroy themselves when finished
+    bool detached = false;
+
+    struct final_awaiter
+    {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            task_promise_base& promise = handle.promise();
+            if (promise.continuation)
+            {
+                return promise.continuation;
+            }
+            if (promise.detached)
+            {
+                handle.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    final_awaiter final_suspend() noexcept { return {}; }
+    // project is built without exceptions
+    void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct task_promise : task_promise_base
+{
+    std::optional<T> value;
+
+    task<T> get_return_object();
+    void return_value(T new_value) { value.emplace(std::move(new_value)); }
+    T result() { return std::move(*value); }
+};
+
+template <>
+struct task_promise<void> : task_promise_base
+{
+    task<void> get_return_object();
+    void return_void() {}
+    void result() {}
+};
+} // namespace detail
+
+// lazy coroutine. Starts when awaited, and resumes awaiting coroutine when it finishes
+template <typename T = void>
+class task
+{
+public:
+    using promise_type = detail::task_promise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    explicit task(handle_type handle) : _handle(handle) {}
+    task(task&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+    task& operator=(task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (_handle)
+            {
+                _handle.destroy();
+            }
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+    ~task()
+    {
+        if (_handle)
+        {
+            _handle.destroy();
+        }
+    }
+
+    auto operator co_await() && noexcept
+    {
+        struct awaiter
+        {
+            handle_type handle;
+
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+            {
+                handle.promise().continuation = continuation;
+                return handle;
+            }
+            T await_resume() { return handle.promise().result(); }
+        };
+        return awaiter{_handle};
+    }
+
+    // starts task without awaiting it. Task frame is destroyed when it finishes
+    friend void spawn(task<void> spawned);
+
+private:
+    handle_type _handle;
+};
+
+inline void spawn(task<void> spawned)
+{
+    task<void>::handle_type handle = std::exchange(spawned._handle, nullptr);
+    handle.promise().detached = true;
+    handle.resume();
+}
+
+namespace detail
+{
+template <typename T>
+task<T> task_promise<T>::get_return_object()
+{
+    return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object()
+{
+    return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+} // namespace detail
+} // namespace sway
@@ -0,0 +1,490 @@
+#include <sway_ipc/tree_cache.hpp>
+#include <sway_ipc/decode.hpp>
+#include <sway_ipc/events/events.hpp>
+#include <sway_ipc/replies.hpp>
+#include <sway_ipc/sway_ipc.hpp>
+
+namespace
+{
+sway::tree_cache::node_type node_type_from_string(std::string_view type)
+{
+    if (type == "root")
+    {
+        return sway::tree_cache::node_type::root;
+    }
+    else if (type == "output")
+    {
+        return sway::tree_cache::node_type::output;
+    }
+    else if (type == "workspace")
+    {
+        return sway::tree_cache::node_type::workspace;
+    }
+    else if (type == "floating_con")
+    {
+        return sway::tree_cache::node_type::floating_con;
+    }
+    else
+    {
+        return sway::tree_cache::node_type::con;
+    }
+}
+
+void set_flag(uint8_t& flags, uint8_t flag, bool value)
+{
+    flags = value ? (flags | flag) : (flags & ~flag);
+}
+} // namespace
+
+namespace sway
+{
+std::expected<void, error_desc> tree_cache::rebuild(ipc& ipc)
+{
+    // decoded tree is needed only until it is copied into table, so it goes into reply arena
+    return ipc.get_tree().and_then(decode_with<sway::node>(ipc.reply_arena())).transform([this](sway::node root)
+    {
+        _nodes.clear();
+        _names.clear();
+        _free.clear();
+        _by_id.clear();
+        _scratchpad_workspace = no_node;
+        _focused = no_node;
+        _scratchpad_size = 0;
+        // interned strings are dropped too, otherwise app_ids of closed windows pile up forever
+        _strings.resize(1);
+        _string_indices = {{std::string_view(), 0}};
+
+        add_subtree(root, no_node, false);
+        _stale = false;
+    });
+}
+
+std::expected<void, error_desc> tree_cache::sync(ipc& ipc)
+{
+    if (!_stale)
+    {
+        return {};
+    }
+    return rebuild(ipc);
+}
+
+bool tree_cache::apply(event_type event_type, simdjson::ondemand::document json)
+{
+    if (event_type == event_type::window)
+    {
+        std::expected<window_event, error_desc> event = decode<window_event>(std::move(json));
+        _stale = _stale || !event.has_value();
+        return event.has_value() && apply(event.value());
+    }
+    else if (event_type == event_type::workspace)
+    {
+        std::expected<workspace_event, error_desc> event = decode<workspace_event>(std::move(json));
+        _stale = _stale || !event.has_value();
+        return event.has_value() && apply(event.value());
+    }
+    return !_stale;
+}
+
+bool tree_cache::apply(const window_event& event)
+{
+    // when stale there is nothing to patch, tree will be fetched anyway
+    _stale = _stale || !apply_window(event);
+    return !_stale;
+}
+
+bool tree_cache::apply(const workspace_event& event)
+{
+    _stale = _stale || !apply_workspace(event);
+    return !_stale;
+}
+
+tree_cache::node_index tree_cache::find(int64_t id) const
+{
+    auto it = _by_id.find(id);
+    return it == _by_id.end() ? no_node : it->second;
+}
+
+tree_cache::node_index tree_cache::add_node(const sway::node& source, node_index parent, bool floating)
+{
+    node_index index;
+    if (_free.empty())
+    {
+        index = static_cast<node_index>(_nodes.size());
+        _nodes.emplace_back();
+        _names.emplace_back();
+    }
+    else
+    {
+        index = _free.back();
+        _free.pop_back();
+        _nodes[index] = node{};
+    }
+
+    node& added = _nodes[index];
+    added.id = source.id;
+    added.type = node_type_from_string(source.type);
+    // class of xwayland window, which has no app_id
+    added.app_id = intern(source.app_id.has_value() || !source.window_properties.has_value() ?
+        source.app_id.value_or(std::string_view()) : source.window_properties->window_class);
+    set_flag(added.flags, focused, source.focused);
+    set_flag(added.flags, urgent, source.urgent);
+    set_flag(added.flags, sticky, source.sticky);
+    set_flag(added.flags, fullscreen, source.fullscreen_mode != 0);
+    set_flag(added.flags, tree_cache::floating, floating);
+    _names[index] = source.name.value_or(std::string_view());
+    _by_id[source.id] = index;
+
+    if (added.type == node_type::workspace && _names[index] == "__i3_scratch")
+    {
+        _scratchpad_workspace = index;
+    }
+    if (source.focused)
+    {
+        _focused = index;
+    }
+    if (parent != no_node)
+    {
+        link(index, parent);
+    }
+    return index;
+}
+
+tree_cache::node_index tree_cache::add_subtree(const sway::node& source, node_index parent, bool floating)
+{
+    const node_index index = add_node(source, parent, floating);
+    for (const sway::node& child : source.nodes)
+    {
+        add_subtree(child, index, false);
+    }
+    for (const sway::node& child : source.floating_nodes)
+    {
+        add_subtree(child, index, true);
+    }
+    return index;
+}
+
+void tree_cache::link(node_index index, node_index parent, node_index after)
+{
+    // appended, so children are in the same order as in get_tree
+    _nodes[index].parent = parent;
+    node_index* next = after != no_node ? &_nodes[after].next_sibling : &_nodes[parent].first_child;
+    while (after == no_node && *next != no_node)
+    {
+        next = &_nodes[*next].next_sibling;
+    }
+    _nodes[index].next_sibling = *next;
+    *next = index;
+
+    if (parent == _scratchpad_workspace)
+    {
+        _nodes[index].flags |= scratchpad;
+        ++_scratchpad_size;
+    }
+}
+
+void tree_cache::unlink(node_index index)
+{
+    const node_index parent = _nodes[index].parent;
+    if (parent == no_node)
+    {
+        return;
+    }
+
+    node_index* next = &_nodes[parent].first_child;
+    while (*next != index)
+    {
+        next = &_nodes[*next].next_sibling;
+    }
+    *next = _nodes[index].next_sibling;
+    _nodes[index].parent = no_node;
+    _nodes[index].next_sibling = no_node;
+
+    if (parent == _scratchpad_workspace)
+    {
+        _nodes[index].flags &= ~scratchpad;
+        --_scratchpad_size;
+    }
+}
+
+void tree_cache::remove_subtree(node_index index)
+{
+    unlink(index);
+
+    // children are freed without unlinking each of them, since whole list goes away
+    std::vector<node_index> pending{index};
+    while (!pending.empty())
+    {
+        const node_index current = pending.back();
+        pending.pop_back();
+        for (node_index child = _nodes[current].first_child; child != no_node; child = _nodes[child].next_sibling)
+        {
+            pending.push_back(child);
+        }
+
+        if (current == _focused)
+        {
+            _focused = no_node;
+        }
+        if (current == _scratchpad_workspace)
+        {
+            _scratchpad_workspace = no_node;
+            _scratchpad_size = 0;
+        }
+        _by_id.erase(_nodes[current].id);
+        _nodes[current] = node{};
+        _names[current].clear();
+        _free.push_back(current);
+    }
+}
+
+void tree_cache::place(node_index index, node_index parent, bool floating)
+{
+    unlink(index);
+    link(index, parent);
+    _nodes[index].type = floating ? node_type::floating_con : node_type::con;
+    set_flag(_nodes[index].flags, tree_cache::floating, floating);
+}
+
+bool tree_cache::place_new(const sway::node& container)
+{
+    const node_index workspace = workspace_of(_focused);
+    if (workspace == no_node || workspace == _scratchpad_workspace)
+    {
+        return false;
+    }
+
+    // tiling window goes next to focused one, and into workspace if focused is workspace itself,
+    // or floating window
+    const bool floating = container.type == "floating_con";
+    const bool next_to_focused = !floating && _focused != workspace &&
+        (_nodes[_focused].flags & tree_cache::floating) == 0;
+    const node_index index = add_subtree(container, no_node, floating);
+    if (next_to_focused)
+    {
+        link(index, _nodes[_focused].parent, _focused);
+    }
+    else
+    {
+        link(index, workspace);
+    }
+    return true;
+}
+
+void tree_cache::set_focused(node_index index)
+{
+    if (_focused != no_node)
+    {
+        _nodes[_focused].flags &= ~focused;
+    }
+    _focused = index;
+    _nodes[index].flags |= focused;
+}
+
+uint32_t tree_cache::intern(std::string_view string)
+{
+    auto it = _string_indices.find(string);
+    if (it != _string_indices.end())
+    {
+        return it->second;
+    }
+
+    const uint32_t index = static_cast<uint32_t>(_strings.size());
+    _strings.emplace_back(string);
+    _string_indices.emplace(_strings.back(), index);
+    return index;
+}
+
+tree_cache::node_index tree_cache::find_output(std::string_view name) const
+{
+    if (_nodes.empty())
+    {
+        return no_node;
+    }
+    for (node_index output = _nodes[0].first_child; output != no_node; output = _nodes[output].next_sibling)
+    {
+        if (_names[output] == name)
+        {
+            return output;
+        }
+    }
+    return no_node;
+}
+
+tree_cache::node_index tree_cache::workspace_of(node_index index) const
+{
+    while (index != no_node && _nodes[index].type != node_type::workspace)
+    {
+        index = _nodes[index].parent;
+    }
+    return index;
+}
+
+bool tree_cache::apply_window(const window_event& event)
+{
+    const std::string_view change = event.change;
+    const sway::node& container = event.container;
+    const node_index index = find(container.id);
+    if (change == "close")
+    {
+        if (index != no_node)
+        {
+            remove_subtree(index);
+        }
+        return true;
+    }
+    else if (change == "new")
+    {
+        // window could be in tree already, if it was fetched after window was mapped
+        return index != no_node || place_new(container);
+    }
+    else if (index == no_node)
+    {
+        // window this cache has never seen, some event was missed
+        return false;
+    }
+
+    if (change == "focus")
+    {
+        // window shown from scratchpad is put on focused workspace before it gets focus, and window
+        // moved away is focused mostly after its workspace is
+        if ((_nodes[index].flags & scratchpad) != 0 || _nodes[index].parent == no_node)
+        {
+            const node_index workspace = workspace_of(_focused);
+            if (workspace == no_node)
+            {
+                return false;
+            }
+            place(index, workspace, container.type == "floating_con");
+        }
+        set_focused(index);
+    }
+    else if (change == "title")
+    {
+        _names[index] = container.name.value_or(std::string_view());
+    }
+    else if (change == "urgent")
+    {
+        set_flag(_nodes[index].flags, urgent, container.urgent);
+    }
+    else if (change == "fullscreen_mode")
+    {
+        set_flag(_nodes[index].flags, fullscreen, container.fullscreen_mode != 0);
+    }
+    else if (change == "floating")
+    {
+        // floating window is put into floating_nodes of its workspace, and back into tiling
+        // layout of workspace when it stops floating
+        const bool now_floating = container.type == "floating_con";
+        const node_index workspace = workspace_of(index);
+        if (workspace != no_node)
+        {
+            place(index, workspace, now_floating);
+        }
+        else
+        {
+            // window out of tree stays there, until it gets focus
+            _nodes[index].type = now_floating ? node_type::floating_con : node_type::con;
+            set_flag(_nodes[index].flags, floating, now_floating);
+        }
+    }
+    else if (change == "move")
+    {
+        // sent by move scratchpad, and when scratchpad show hides window back
+        const bool in_scratchpad = container.scratchpad_state.has_value() && container.scratchpad_state != "none";
+        const bool visible = container.visible.value_or(false);
+        if (in_scratchpad && !visible)
+        {
+            if (_scratchpad_workspace == no_node)
+            {
+                return false;
+            }
+            place(index, _scratchpad_workspace, true);
+        }
+        else if (!container.focused || !visible || workspace_of(index) == no_node ||
+            (_nodes[index].flags & scratchpad) != 0)
+        {
+            // moved to other workspace or output, which event does not name
+            unlink(index);
+        }
+        // focused window which is still visible was moved inside its workspace
+    }
+    else if (change != "mark")
+    {
+        // anything unknown could place window somewhere event does not tell
+        return false;
+    }
+    return true;
+}
+
+bool tree_cache::apply_workspace(const workspace_event& event)
+{
+    const std::string_view change = event.change;
+    if (change == "reload")
+    {
+        // config reload does not change tree
+        return true;
+    }
+    else if (!event.current.has_value())
+    {
+        return false;
+    }
+
+    const workspace& current = event.current.value();
+    const node_index index = find(current.id);
+    if (change == "init")
+    {
+        const node_index output = find_output(current.output);
+        if (index != no_node || output == no_node)
+        {
+            return false;
+        }
+        sway::node source;
+        source.id = current.id;
+        source.name = current.name;
+        source.type = "workspace";
+        add_node(source, output, false);
+        return true;
+    }
+    else if (change == "empty")
+    {
+        if (index != no_node)
+        {
+            remove_subtree(index);
+        }
+        return true;
+    }
+    else if (index == no_node)
+    {
+        return false;
+    }
+
+    if (change == "focus")
+    {
+        // if workspace has windows, window focus event comes too, and moves focus to window
+        set_focused(index);
+    }
+    else if (change == "rename")
+    {
+        _names[index] = current.name;
+    }
+    else if (change == "urgent")
+    {
+        set_flag(_nodes[index].flags, urgent, current.urgent);
+    }
+    else if (change == "move")
+    {
+        const node_index output = find_output(current.output);
+        if (output == no_node)
+        {
+            return false;
+        }
+        unlink(index);
+        link(index, output);
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+} // namespace sway
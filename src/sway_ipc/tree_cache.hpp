@@ -0,0 +1,133 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <sway_ipc/events/event_type.hpp>
+#include <simdjson.h>
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sway
+{
+class ipc;
+struct node;
+struct window_event;
+struct workspace_event;
+
+// copy of sway layout tree, kept up to date by window and workspace events, so questions
+// about the tree do not need get_tree. Nodes live in flat table and refer to each other
+// by index. New window is put where sway puts it without rules: next to focused tiling window,
+// or into floating windows of focused workspace. Moves into scratchpad and out of it are exact.
+// Event of other move does not say where window went: window which stays focused and visible is
+// kept on its workspace, any other is left out of tree (parent is no_node) until it gets focus,
+// and then it is put on focused workspace. Only event which contradicts cache, like change of window
+// it has never seen, makes it stale, and sync fetches whole tree again
+class tree_cache
+{
+public:
+    using node_index = uint32_t;
+    static constexpr node_index no_node = UINT32_MAX;
+
+    enum class node_type : uint8_t
+    {
+        root,
+        output,
+        workspace,
+        con,
+        floating_con,
+        // slot of removed node, waiting for reuse
+        free
+    };
+
+    enum node_flags : uint8_t
+    {
+        focused = 1 << 0,
+        urgent = 1 << 1,
+        sticky = 1 << 2,
+        fullscreen = 1 << 3,
+        // in floating_nodes of its parent
+        floating = 1 << 4,
+        // hidden in scratchpad
+        scratchpad = 1 << 5
+    };
+
+    struct node
+    {
+        int64_t id = 0;
+        node_index parent = no_node;
+        node_index first_child = no_node;
+        node_index next_sibling = no_node;
+        // index of interned app_id, 0 is empty string
+        uint32_t app_id = 0;
+        node_type type = node_type::free;
+        uint8_t flags = 0;
+    };
+
+    // tree is empty and stale until first sync
+    tree_cache() = default;
+
+    // fetches tree with get_tree of ipc, and replaces everything cached
+    std::expected<void, error_desc> rebuild(ipc& ipc);
+    // rebuilds only if cache is stale
+    std::expected<void, error_desc> sync(ipc& ipc);
+    bool stale() const { return _stale; }
+    // for when events could be missed, like after reconnect
+    void invalidate() { _stale = true; }
+
+    // patches tree with event. Returns false if event could not be applied, cache is stale
+    // after that until sync. Events other than window and workspace are ignored
+    bool apply(event_type event_type, simdjson::ondemand::document json);
+    // same, for events already decoded
+    bool apply(const window_event& event);
+    bool apply(const workspace_event& event);
+
+    //=================================================================================================================
+    std::span<const node> nodes() const { return _nodes; }
+    const node& at(node_index index) const { return _nodes[index]; }
+    node_index find(int64_t id) const;
+    node_index root() const { return _nodes.empty() ? no_node : 0; }
+    node_index focused_node() const { return _focused; }
+
+    // window title, or name of output and workspace
+    std::string_view name(node_index index) const { return _names[index]; }
+    std::string_view app_id(node_index index) const { return _strings[_nodes[index].app_id]; }
+
+    size_t scratchpad_size() const { return _scratchpad_size; }
+    bool scratchpad_empty() const { return _scratchpad_size == 0; }
+
+private:
+    node_index add_node(const sway::node& source, node_index parent, bool floating);
+    node_index add_subtree(const sway::node& source, node_index parent, bool floating);
+    // appended to children of parent, or put right after sibling
+    void link(node_index index, node_index parent, node_index after = no_node);
+    // moves node with its subtree under parent
+    void place(node_index index, node_index parent, bool floating);
+    bool place_new(const sway::node& container);
+    void unlink(node_index index);
+    void remove_subtree(node_index index);
+    void set_focused(node_index index);
+    uint32_t intern(std::string_view string);
+    node_index find_output(std::string_view name) const;
+    node_index workspace_of(node_index index) const;
+
+    bool apply_window(const window_event& event);
+    bool apply_workspace(const workspace_event& event);
+
+    // hot data used by tree walks is in _nodes, names are only looked at when asked
+    std::vector<node> _nodes;
+    std::vector<std::string> _names;
+    std::vector<node_index> _free;
+    std::unordered_map<int64_t, node_index> _by_id;
+    // deque, so views in _string_indices stay valid when it grows
+    std::deque<std::string> _strings{std::string()};
+    std::unordered_map<std::string_view, uint32_t> _string_indices{{std::string_view(), 0}};
+    node_index _scratchpad_workspace = no_node;
+    node_index _focused = no_node;
+    size_t _scratchpad_size = 0;
+    bool _stale = true;
+};
+} // namespace sway
@@ -0,0 +1,99 @@
+#include <sway_ipc/window_wait.hpp>
+#include <sway_ipc/sway_ipc.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <poll.h>
+
+namespace
+{
+// changes, after which window could match criteria it did not match before
+constexpr std::string_view matching_changes[] = {"new", "title", "move", "floating", "mark", "focus"};
+constexpr sway::event_filter window_filters[] = {{sway::event_type::window, matching_changes}};
+} // namespace
+
+namespace sway
+{
+std::expected<std::optional<query_match>, error_desc> wait_for_window(ipc& ipc, const query& query,
+    std::chrono::milliseconds timeout)
+{
+    const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+
+    // events only say that tree could have changed, match is looked for in tree
+    bool changed = true;
+    std::optional<error_desc> event_error;
+    event_type events[] = {event_type::window};
+    ipc::subscribe_result subscribe_result = ipc.subscribe_nonblocking(events,
+        [&changed, &event_error](ipc::event_result event)
+        {
+            if (!event.has_value())
+            {
+                event_error = event.error();
+                return true;
+            }
+            changed = true;
+            return false;
+        }, {}, window_filters);
+    if (subscribe_result.error.has_value())
+    {
+        return std::unexpected(std::move(subscribe_result.error.value()));
+    }
+    else if (!subscribe_result.subscription_successful)
+    {
+        return std::unexpected(error_desc(error_desc::invalid_error_code::not_subscribed,
+            error_desc::operation::subscribe_refused));
+    }
+
+    auto finish = [&ipc](std::expected<std::optional<query_match>, error_desc> result)
+        -> std::expected<std::optional<query_match>, error_desc>
+    {
+        std::expected<void, error_desc> unsubscribe_result = ipc.unsubscribe();
+        if (result.has_value() && !unsubscribe_result.has_value())
+        {
+            return std::unexpected(std::move(unsubscribe_result.error()));
+        }
+        return result;
+    };
+
+    while (true)
+    {
+        if (changed)
+        {
+            changed = false;
+            std::expected<std::optional<query_match>, error_desc> match = ipc.get_tree()
+                .and_then([&query](simdjson::ondemand::document tree)
+                {
+                    return query.find_first(tree);
+                });
+            if (!match.has_value() || match->has_value())
+            {
+                return finish(std::move(match));
+            }
+        }
+
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (remaining.count() <= 0)
+        {
+            return finish(std::nullopt);
+        }
+        // timeout of poll is int, longer waits wake up earlier and poll again
+        pollfd poll_fd{ipc.event_fd(), POLLIN, 0};
+        const int poll_timeout = static_cast<int>(std::min<int64_t>(remaining.count(), INT_MAX));
+        if (::poll(&poll_fd, 1, poll_timeout) == -1 && errno != EINTR)
+        {
+            return finish(std::unexpected(error_desc(error_desc::operation::wait_events)));
+        }
+
+        std::expected<size_t, error_desc> dispatch_result = ipc.dispatch();
+        if (!dispatch_result.has_value())
+        {
+            // dispatch closes subscription on error
+            return std::unexpected(std::move(dispatch_result.error()));
+        }
+        else if (event_error.has_value())
+        {
+            return std::unexpected(std::move(event_error.value()));
+        }
+    }
+}
+} // namespace sway
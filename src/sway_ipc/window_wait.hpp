@@ -0,0 +1,20 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <sway_ipc/query.hpp>
+#include <chrono>
+#include <expected>
+#include <optional>
+
+namespace sway
+{
+class ipc;
+
+// blocks until some window matches query, or timeout passes, instead of sleeping for as long as
+// window usually takes to appear. Returns right away if window is there already, nullopt on timeout.
+// Window events are subscribed to before tree is checked, so window mapped in between is not missed,
+// and tree is fetched again only after events, which could make query match. ipc should be connected,
+// and should not have subscription of its own. Strings of match are in parser of ipc, and are valid
+// until the next request
+std::expected<std::optional<query_match>, error_desc> wait_for_window(ipc& ipc, const query& query,
+    std::chrono::milliseconds timeout);
+} // namespace sway
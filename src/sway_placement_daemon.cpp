@@ -0,0 +1,125 @@
+#include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/event_loop.hpp>
+#include <sway_ipc/query.hpp>
+#include "placement/placement_handler.hpp"
+#include "print_error.hpp"
+#include <chrono>
+#include <print>
+#include <string>
+#include <vector>
+
+// places windows by rules as soon as sway tells about them, instead of for_window rules and sleeps
+// before swaymsg. Criteria of rules are compiled once at start, and matched against container of
+// window event, without get_tree. Moves for all windows of events read in one go are sent to sway
+// as one message, from the same turn of event loop.
+// Usage: sway_placement_daemon [--verbose] [--once] <criteria> <command> [[--once] <criteria> <command>...]
+// Command is run as [con_id=<id>] <command>, actions separated by comma apply to the same window.
+// Like for_window, rule is applied to window once, on new event or on title change which makes it match.
+// Windows which are there already at start are placed too, since applications started by exec together
+// with daemon can map before it subscribes. Rule with --once is applied to one window only.
+// With --verbose every placement is printed with time from handling of event until sway answered command
+
+int main(int argc, char** argv)
+{
+    std::vector<placement::rule> rules;
+    bool verbose = false;
+    bool once = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--verbose")
+        {
+            verbose = true;
+            continue;
+        }
+        else if (arg == "--once")
+        {
+            once = true;
+            continue;
+        }
+        else if (i + 1 == argc)
+        {
+            std::println(stderr, "[Placement] [Error] criteria {} has no command", arg);
+            return -1;
+        }
+
+        std::expected<sway::query, sway::error_desc> criteria = sway::query::compile(arg);
+        if (!criteria.has_value())
+        {
+            print_error(criteria.error());
+            return criteria.error().error_code;
+        }
+        rules.push_back(placement::rule{std::move(criteria.value()), argv[++i], once});
+        once = false;
+    }
+    if (rules.empty())
+    {
+        std::println(stderr,
+            "Usage: sway_placement_daemon [--verbose] [--once] <criteria> <command> [[--once] <criteria> <command>...]");
+        return -1;
+    }
+
+    simdjson::ondemand::parser parser;
+    sway::ipc ipc(parser, false);
+    std::expected<void, sway::error_desc> connect_result = ipc.connect();
+    if (!connect_result.has_value())
+    {
+        print_error(connect_result.error());
+        return connect_result.error().error_code;
+    }
+
+    placement::placement_handler handler{ipc, rules, verbose};
+    // events read together are one burst, without waiting for more
+    sway::ipc::subscribe_result subscribe_result = ipc.subscribe_nonblocking(handler,
+        sway::coalesce_options{sway::coalesce_options::mode::batch, std::chrono::milliseconds(0)});
+    if (subscribe_result.error.has_value())
+    {
+        print_error(subscribe_result.error.value());
+        return subscribe_result.error->error_code;
+    }
+    else if (!subscribe_result.subscription_successful)
+    {
+        std::println(stderr, "[Placement] [Error] sway returned success false in subscription response");
+        // arbitrary error code
+        return -10;
+    }
+
+    // tree is checked after subscription, so window mapped in between is seen by one of them.
+    // Window seen by both is placed once, since placement is recorded in applied
+    std::expected<void, sway::error_desc> existing_result = placement::place_existing(handler);
+    if (!existing_result.has_value())
+    {
+        print_error(existing_result.error());
+        return existing_result.error().error_code;
+    }
+
+    sway::event_loop loop;
+    std::expected<void, sway::error_desc> add_result = loop.add_ipc(ipc, [&handler, &loop](sway::error_desc error)
+    {
+        handler.error = std::move(error);
+        loop.stop();
+    });
+    if (!add_result.has_value())
+    {
+        print_error(add_result.error());
+        return add_result.error().error_code;
+    }
+
+    // loop ends when handler unsubscribes, which happens on shutdown and on errors
+    while (ipc.subscribed() && !handler.error.has_value())
+    {
+        std::expected<void, sway::error_desc> run_result = loop.run_once();
+        if (!run_result.has_value())
+        {
+            print_error(run_result.error());
+            return run_result.error().error_code;
+        }
+    }
+
+    if (handler.error.has_value() && !handler.shutdown)
+    {
+        print_error(handler.error.value());
+        return handler.error->error_code;
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <sway_ipc/sway_ipc.hpp>
+#include <sway_ipc/query.hpp>
+#include <sway_ipc/window_wait.hpp>
+#include "print_error.hpp"
+#include <charconv>
+#include <chrono>
+#include <format>
+#include <optional>
+#include <print>
+#include <string>
+
+// waits for window matching criteria, and runs command on it. Replaces sleep before swaymsg
+// in startup config: command runs as soon as window appears, and not after time it usually takes.
+// Usage: sway_wait_window [--timeout <ms>] <criteria> [command]
+// Command is run with criteria of found container only, [con_id=<id>] <command>.
+// Exit code is 1 if no window matched before timeout
+
+namespace
+{
+constexpr std::string_view usage = "Usage: sway_wait_window [--timeout <ms>] <criteria> [command]";
+
+// whole argument should be a number, so typo does not turn into timeout of zero
+std::optional<std::chrono::milliseconds> parse_timeout(std::string_view arg)
+{
+    int64_t count = 0;
+    const std::from_chars_result result = std::from_chars(arg.data(), arg.data() + arg.size(), count);
+    if (result.ec != std::errc() || result.ptr != arg.data() + arg.size() || count < 0)
+    {
+        return std::nullopt;
+    }
+    return std::chrono::milliseconds(count);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::chrono::milliseconds timeout{30000};
+    std::string_view criteria;
+    std::string_view command;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--timeout")
+        {
+            // trailing --timeout is an error, and not criteria
+            const std::optional<std::chrono::milliseconds> parsed =
+                i + 1 < argc ? parse_timeout(argv[++i]) : std::nullopt;
+            if (!parsed.has_value())
+            {
+                std::println(stderr, "[WaitWindow] [Error] --timeout needs number of milliseconds\n{}", usage);
+                return -1;
+            }
+            timeout = parsed.value();
+        }
+        else if (criteria.empty())
+        {
+            criteria = arg;
+        }
+        else if (command.empty())
+        {
+            command = arg;
+        }
+        else
+        {
+            std::println(stderr, "[WaitWindow] [Error] unexpected argument {}\n{}", arg, usage);
+            return -1;
+        }
+    }
+    if (criteria.empty())
+    {
+        std::println(stderr, "{}", usage);
+        return -1;
+    }
+
+    std::expected<sway::query, sway::error_desc> query = sway::query::compile(criteria);
+    if (!query.has_value())
+    {
+        print_error(query.error());
+        return query.error().error_code;
+    }
+
+    simdjson::ondemand::parser parser;
+    sway::ipc ipc(parser, false);
+    std::expected<void, sway::error_desc> connect_result = ipc.connect();
+    if (!connect_result.has_value())
+    {
+        print_error(connect_result.error());
+        return connect_result.error().error_code;
+    }
+
+    std::expected<std::optional<sway::query_match>, sway::error_desc> match =
+        sway::wait_for_window(ipc, query.value(), timeout);
+    if (!match.has_value())
+    {
+        print_error(match.error());
+        return match.error().error_code;
+    }
+    else if (!match->has_value())
+    {
+        std::println(stderr, "[WaitWindow] [Error] no window matched {} in {}", criteria, timeout);
+        return 1;
+    }
+    else if (command.empty())
+    {
+        return 0;
+    }
+
+    const std::string targeted = std::format("[con_id={}] {}", match->value().id, command);
+    std::expected<std::pmr::vector<std::expected<void, sway::ipc::run_error>>, sway::error_desc> run_result =
+        ipc.run_commands(std::string_view(targeted));
+    if (!run_result.has_value())
+    {
+        print_error(run_result.error());
+        return run_result.error().error_code;
+    }
+    for (const std::expected<void, sway::ipc::run_error>& result : run_result.value())
+    {
+        if (!result.has_value())
+        {
+            std::println(stderr, "[WaitWindow] [Error] {}: {}", targeted, result.error().error);
+            return 2;
+        }
+    }
+    return 0;
+}
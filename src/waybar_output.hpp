@@ -0,0 +1,151 @@
+#pragma once
+#include <sway_ipc/error_desc.hpp>
+#include <cerrno>
+#include <cstring>
+#include <expected>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+// output of custom waybar module with "return-type": "json"
+namespace waybar
+{
+// views should live until block is written
+struct block
+{
+    std::string_view text;
+    std::string_view tooltip;
+    // css class of module, empty means none
+    std::string_view css_class;
+    std::optional<int> percentage;
+};
+
+inline void append_json_string(std::string& out, std::string_view string)
+{
+    out += '"';
+    for (char c : string)
+    {
+        switch (c)
+        {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    std::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<int>(c));
+                }
+                else
+                {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+// one line of json, waybar reads module state line by line
+inline void serialize(const block& block, std::string& out)
+{
+    out += "{\"text\":";
+    append_json_string(out, block.text);
+    if (!block.tooltip.empty())
+    {
+        out += ",\"tooltip\":";
+        append_json_string(out, block.tooltip);
+    }
+    if (!block.css_class.empty())
+    {
+        out += ",\"class\":";
+        append_json_string(out, block.css_class);
+    }
+    if (block.percentage.has_value())
+    {
+        std::format_to(std::back_inserter(out), ",\"percentage\":{}", block.percentage.value());
+    }
+    out += "}\n";
+}
+
+// writes blocks to fd, skipping ones which are the same as the last written one.
+// Line is serialised into buffer reused between writes, and written with one write(2),
+// so nothing sits in stdio buffers, and there is no fflush after every event
+class output
+{
+public:
+    output() = default;
+    explicit output(int fd) : _fd(fd) {}
+
+    // fd is not owned
+    int fd() const { return _fd; }
+
+    void set_fd(int fd) { _fd = fd; }
+
+    // on error nothing is remembered, so the same block can be written again
+    std::expected<void, sway::error_desc> write(const block& block)
+    {
+        _line.clear();
+        serialize(block, _line);
+        if (_written && _line == _last)
+        {
+            return {};
+        }
+
+        std::expected<void, sway::error_desc> write_result = write_line(_line);
+        if (write_result.has_value())
+        {
+            _last.swap(_line);
+            _written = true;
+        }
+        return write_result;
+    }
+
+    // remembers block as the last line without writing it, for output which can not be written now.
+    // Returns false if it is the same as the last one
+    bool keep(const block& block)
+    {
+        _line.clear();
+        serialize(block, _line);
+        if (_written && _line == _last)
+        {
+            return false;
+        }
+        _last.swap(_line);
+        _written = true;
+        return true;
+    }
+
+    // writes the last line again, like for reader which was not there when it was written
+    std::expected<void, sway::error_desc> rewrite()
+    {
+        return _written ? write_line(_last) : std::expected<void, sway::error_desc>();
+    }
+
+private:
+    std::expected<void, sway::error_desc> write_line(std::string_view line)
+    {
+        // lines shorter than PIPE_BUF go to pipe whole. Only long tooltips could be split
+        for (size_t offset = 0; offset < line.size();)
+        {
+            const ssize_t written = ::write(_fd, line.data() + offset, line.size() - offset);
+            if (written == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return std::unexpected(sway::error_desc("Writing of waybar output failed"));
+            }
+            offset += written;
+        }
+        return {};
+    }
+
+    int _fd = STDOUT_FILENO;
+    bool _written = false;
+    std::string _line;
+    std::string _last;
+};
+} // namespace waybar